@@ -200,6 +200,9 @@ SOURCES += \
     streaming/input/reltouch.cpp \
     streaming/session.cpp \
     streaming/audio/audio.cpp \
+    streaming/audio/audioring.cpp \
+    streaming/audio/audiojitterbuffer.cpp \
+    streaming/audio/audiopacketring.cpp \
     streaming/audio/renderers/sdlaud.cpp \
     gui/computermodel.cpp \
     gui/appmodel.cpp \
@@ -210,6 +213,11 @@ SOURCES += \
     settings/mappingmanager.cpp \
     gui/sdlgamepadkeynavigation.cpp \
     streaming/video/overlaymanager.cpp \
+    streaming/video/glyphatlas.cpp \
+    streaming/video/decodercapabilitycache.cpp \
+    streaming/video/decodeunitcapture.cpp \
+    streaming/video/frametimingtrace.cpp \
+    streaming/video/latencyhistogram.cpp \
     backend/systemproperties.cpp \
     wm.cpp
 
@@ -237,6 +245,9 @@ HEADERS += \
     settings/streamingpreferences.h \
     streaming/input/input.h \
     streaming/session.h \
+    streaming/audio/audioring.h \
+    streaming/audio/audiojitterbuffer.h \
+    streaming/audio/audiopacketring.h \
     streaming/audio/renderers/renderer.h \
     streaming/audio/renderers/sdl.h \
     gui/computermodel.h \
@@ -249,6 +260,11 @@ HEADERS += \
     settings/mappingmanager.h \
     gui/sdlgamepadkeynavigation.h \
     streaming/video/overlaymanager.h \
+    streaming/video/glyphatlas.h \
+    streaming/video/decodercapabilitycache.h \
+    streaming/video/decodeunitcapture.h \
+    streaming/video/frametimingtrace.h \
+    streaming/video/latencyhistogram.h \
     backend/systemproperties.h
 
 # Platform-specific renderers and decoders
@@ -258,18 +274,39 @@ ffmpeg {
     DEFINES += HAVE_FFMPEG
     SOURCES += \
         streaming/video/ffmpeg.cpp \
+        streaming/video/framepool.cpp \
+        streaming/video/decodeunitreplaysource.cpp \
+        streaming/video/elementarystreamsource.cpp \
+        streaming/video/offlinedecodeunitsource.cpp \
         streaming/video/ffmpeg-renderers/genhwaccel.cpp \
+        streaming/video/ffmpeg-renderers/nullrenderer.cpp \
         streaming/video/ffmpeg-renderers/sdlvid.cpp \
         streaming/video/ffmpeg-renderers/swframemapper.cpp \
-        streaming/video/ffmpeg-renderers/pacer/pacer.cpp
+        streaming/video/ffmpeg-renderers/pacer/pacer.cpp \
+        streaming/video/ffmpeg-renderers/pacer/framering.cpp \
+        streaming/video/ffmpeg-renderers/pacer/pacingpolicy.cpp \
+        streaming/video/ffmpeg-renderers/pacer/softwarevsyncsource.cpp \
+        streaming/video/ffmpeg-renderers/yuvconverter.cpp \
+        cli/benchmark.cpp
 
     HEADERS += \
         streaming/video/ffmpeg.h \
+        streaming/video/framepool.h \
+        streaming/video/decodeunitsource.h \
+        streaming/video/decodeunitreplaysource.h \
+        streaming/video/elementarystreamsource.h \
+        streaming/video/offlinedecodeunitsource.h \
         streaming/video/ffmpeg-renderers/renderer.h \
         streaming/video/ffmpeg-renderers/genhwaccel.h \
+        streaming/video/ffmpeg-renderers/nullrenderer.h \
         streaming/video/ffmpeg-renderers/sdlvid.h \
         streaming/video/ffmpeg-renderers/swframemapper.h \
-        streaming/video/ffmpeg-renderers/pacer/pacer.h
+        streaming/video/ffmpeg-renderers/pacer/pacer.h \
+        streaming/video/ffmpeg-renderers/pacer/framering.h \
+        streaming/video/ffmpeg-renderers/pacer/pacingpolicy.h \
+        streaming/video/ffmpeg-renderers/pacer/softwarevsyncsource.h \
+        streaming/video/ffmpeg-renderers/yuvconverter.h \
+        cli/benchmark.h
 }
 libva {
     message(VAAPI renderer selected)
@@ -56,12 +56,30 @@ private:
             }
         }
 
-        Session::getDecoderInfo(testWindow, hasHardwareAcceleration, rendererAlwaysFullScreen, supportsHdr, maximumResolution);
+        // Answer from the decoder capability cache first, since that's much faster
+        // than running the probes if nothing has changed since the last launch.
+        DecoderCapabilityCache::get().validate();
+        bool hadCachedProbes = !DecoderCapabilityCache::get().getCachedProbes().isEmpty();
+
+        Session::getDecoderInfo(testWindow, hasHardwareAcceleration, rendererAlwaysFullScreen, supportsHdr, maximumResolution, true);
+        updateDecoderProperties(hasHardwareAcceleration, rendererAlwaysFullScreen, supportsHdr, maximumResolution);
+
+        // Now rerun the cached probes in the background to catch changes
+        // (like driver updates) that the cache can't detect by itself.
+        if (hadCachedProbes) {
+            Session::refreshDecoderCapabilityCache(testWindow);
+
+            Session::getDecoderInfo(testWindow, hasHardwareAcceleration, rendererAlwaysFullScreen, supportsHdr, maximumResolution, true);
+            updateDecoderProperties(hasHardwareAcceleration, rendererAlwaysFullScreen, supportsHdr, maximumResolution);
+        }
 
         SDL_DestroyWindow(testWindow);
 
         SDL_QuitSubSystem(SDL_INIT_VIDEO);
+    }
 
+    void updateDecoderProperties(bool hasHardwareAcceleration, bool rendererAlwaysFullScreen, bool supportsHdr, QSize maximumResolution)
+    {
         // Propagate the decoder properties to the SystemProperties singleton and emit any change signals on the main thread
         QMetaObject::invokeMethod(m_Properties, "updateDecoderProperties",
                                   Qt::QueuedConnection,
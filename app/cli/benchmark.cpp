@@ -0,0 +1,612 @@
+#include "benchmark.h"
+
+#include "streaming/video/decodeunitreplaysource.h"
+#include "streaming/video/elementarystreamsource.h"
+#include "streaming/video/ffmpeg.h"
+#include "streaming/video/ffmpeg-renderers/nullrenderer.h"
+#include "streaming/video/ffmpeg-renderers/yuvconverter.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QTimer>
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+namespace CliBenchmark
+{
+
+static const struct {
+    int width;
+    int height;
+} k_Resolutions[] = {
+    { 1920, 1080 },
+    { 2560, 1440 },
+    { 3840, 2160 },
+};
+
+static const enum AVPixelFormat k_ColorConversionFormats[] = {
+    AV_PIX_FMT_NV12,
+    AV_PIX_FMT_P010,
+    AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_YUV444P10,
+};
+
+// Rec. 709 limited range constants in the same form that
+// IFFmpegRenderer::getFramePremultipliedCscConstants() produces
+static void getRec709LimitedCscConstants(int bitsPerChannel, std::array<float, 9> &cscMatrix, std::array<float, 3> &offsets)
+{
+    int channelRange = (1 << bitsPerChannel);
+    double yMin = 16 << (bitsPerChannel - 8);
+    double yScale = (channelRange - 1) / (double)((235 - 16) << (bitsPerChannel - 8));
+    double uvScale = (channelRange - 1) / (double)((240 - 16) << (bitsPerChannel - 8));
+
+    cscMatrix = {{
+        1.0f, 1.0f, 1.0f,
+        0.0f, -0.1873f, 1.8556f,
+        1.5748f, -0.4681f, 0.0f,
+    }};
+    for (int i = 0; i < 3; i++) {
+        cscMatrix[i] *= yScale;
+    }
+    for (int i = 3; i < 9; i++) {
+        cscMatrix[i] *= uvScale;
+    }
+
+    offsets[0] = yMin / (double)(channelRange - 1);
+    offsets[1] = (channelRange / 2) / (double)(channelRange - 1);
+    offsets[2] = (channelRange / 2) / (double)(channelRange - 1);
+}
+
+static AVFrame* allocateFrame(enum AVPixelFormat format, int width, int height)
+{
+    AVFrame* frame = av_frame_alloc();
+    if (frame == nullptr) {
+        return nullptr;
+    }
+
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+
+    return frame;
+}
+
+static AVFrame* allocateTestFrame(enum AVPixelFormat format, int width, int height)
+{
+    AVFrame* frame = allocateFrame(format, width, height);
+    if (frame == nullptr) {
+        return nullptr;
+    }
+
+    // Fill the planes with noise that's valid for the sample layout, so
+    // no implementation gets an advantage from uniform content.
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    uint32_t seed = 1;
+    for (int plane = 0; plane < 4 && frame->data[plane] != nullptr; plane++) {
+        int rows = plane == 0 ? height : AV_CEIL_RSHIFT(height, desc->log2_chroma_h);
+        for (int y = 0; y < rows; y++) {
+            uint8_t* row = frame->data[plane] + y * frame->linesize[plane];
+            for (int x = 0; x < frame->linesize[plane]; x += 2) {
+                seed = seed * 1664525 + 1013904223;
+                uint16_t sample = seed >> 16;
+                if (desc->comp[0].depth > 8) {
+                    // Samples are either MSB-aligned (P010) or LSB-aligned (YUV444P10)
+                    sample = desc->comp[0].shift ? (sample & 0xFFC0) : (sample & 0x03FF);
+                }
+                memcpy(&row[x], &sample, sizeof(sample));
+            }
+        }
+    }
+
+    return frame;
+}
+
+// Fills the frame with smooth ramps across the full sample range. Unlike noise,
+// these look the same whether chroma is interpolated (like swscale does) or
+// replicated (like YuvToRgbConverter does), so we can compare against swscale.
+static AVFrame* allocateGradientFrame(enum AVPixelFormat format, int width, int height)
+{
+    AVFrame* frame = allocateFrame(format, width, height);
+    if (frame == nullptr) {
+        return nullptr;
+    }
+
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    for (int c = 0; c < 3; c++) {
+        const AVComponentDescriptor& comp = desc->comp[c];
+        int cols = c == 0 ? width : AV_CEIL_RSHIFT(width, desc->log2_chroma_w);
+        int rows = c == 0 ? height : AV_CEIL_RSHIFT(height, desc->log2_chroma_h);
+        int maxValue = (1 << comp.depth) - 1;
+
+        for (int y = 0; y < rows; y++) {
+            uint8_t* row = frame->data[comp.plane] + y * frame->linesize[comp.plane];
+            for (int x = 0; x < cols; x++) {
+                // Y ramps diagonally, U horizontally, and V vertically
+                int value;
+                switch (c) {
+                case 0:
+                    value = maxValue * (x + y) / (cols + rows - 2);
+                    break;
+                case 1:
+                    value = maxValue * x / (cols - 1);
+                    break;
+                default:
+                    value = maxValue * y / (rows - 1);
+                    break;
+                }
+
+                uint8_t* sample = &row[x * comp.step + comp.offset];
+                if (comp.depth > 8) {
+                    uint16_t shiftedValue = value << comp.shift;
+                    memcpy(sample, &shiftedValue, sizeof(shiftedValue));
+                }
+                else {
+                    *sample = value;
+                }
+            }
+        }
+    }
+
+    return frame;
+}
+
+// Returns the largest difference in any R, G, or B component of two XRGB8888 frames
+static int getMaxComponentError(const AVFrame* expected, const AVFrame* actual)
+{
+    int maxError = 0;
+    for (int y = 0; y < expected->height; y++) {
+        const uint8_t* expectedRow = expected->data[0] + y * expected->linesize[0];
+        const uint8_t* actualRow = actual->data[0] + y * actual->linesize[0];
+        for (int x = 0; x < expected->width * 4; x++) {
+            // Skip the X byte
+            if (x % 4 != 3) {
+                maxError = std::max(maxError, std::abs(expectedRow[x] - actualRow[x]));
+            }
+        }
+    }
+
+    return maxError;
+}
+
+static SwsContext* createSwsContext(const AVFrame* src, const AVFrame* dst)
+{
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100)
+    // Configure this the same way SdlRenderer does
+    SwsContext* context = sws_alloc_context();
+    if (context == nullptr) {
+        return nullptr;
+    }
+
+    AVDictionary *options { nullptr };
+    av_dict_set_int(&options, "srcw", src->width, 0);
+    av_dict_set_int(&options, "srch", src->height, 0);
+    av_dict_set_int(&options, "src_format", src->format, 0);
+    av_dict_set_int(&options, "dstw", dst->width, 0);
+    av_dict_set_int(&options, "dsth", dst->height, 0);
+    av_dict_set_int(&options, "dst_format", dst->format, 0);
+    av_dict_set_int(&options, "threads", std::min(SDL_GetCPUCount(), 4), 0);
+
+    int err = av_opt_set_dict(context, &options);
+    av_dict_free(&options);
+    if (err < 0 || sws_init_context(context, nullptr, nullptr) < 0) {
+        sws_freeContext(context);
+        return nullptr;
+    }
+
+    return context;
+#else
+    return sws_getContext(src->width, src->height, (AVPixelFormat)src->format,
+                          dst->width, dst->height, (AVPixelFormat)dst->format,
+                          0, nullptr, nullptr, nullptr);
+#endif
+}
+
+// Returns the average time per iteration in milliseconds
+static double measure(int iterations, const std::function<void()>& function)
+{
+    // Warm up caches and any lazily initialized state
+    function();
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < iterations; i++) {
+        function();
+    }
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    return (end - start) * 1000.0 / SDL_GetPerformanceFrequency() / iterations;
+}
+
+static void printResult(enum AVPixelFormat format, int width, int height, const char* implementation, double frameTimeMs)
+{
+    fprintf(stdout, "%-10s %5dx%-5d %-10s %8.3f ms %8.1f fps\n",
+            av_get_pix_fmt_name(format), width, height, implementation,
+            frameTimeMs, 1000.0 / frameTimeMs);
+}
+
+// The SIMD kernels use the same fixed-point math as the scalar one, but
+// swscale has its own rounding and coefficient precision.
+#define SCALAR_TOLERANCE 1
+#define SWSCALE_TOLERANCE 3
+
+static bool printValidation(enum AVPixelFormat format, int width, int height, const char* implementation,
+                            int scalarError, int swscaleError)
+{
+    bool passed = scalarError <= SCALAR_TOLERANCE && (swscaleError < 0 || swscaleError <= SWSCALE_TOLERANCE);
+
+    if (swscaleError >= 0) {
+        fprintf(stdout, "%-10s %5dx%-5d %-10s max error %d vs Scalar, %d vs swscale: %s\n",
+                av_get_pix_fmt_name(format), width, height, implementation,
+                scalarError, swscaleError, passed ? "PASS" : "FAIL");
+    }
+    else {
+        fprintf(stdout, "%-10s %5dx%-5d %-10s max error %d vs Scalar: %s\n",
+                av_get_pix_fmt_name(format), width, height, implementation,
+                scalarError, passed ? "PASS" : "FAIL");
+    }
+
+    return passed;
+}
+
+// Stop waiting for frames after the decoder has been idle this long,
+// since reordered or dropped frames may never be rendered.
+#define DECODE_IDLE_TIMEOUT_US 1000000
+
+static enum AVCodecID getCodecId(StreamingPreferences::VideoCodecConfig videoCodec, const QString& fileName)
+{
+    switch (videoCodec) {
+    case StreamingPreferences::VCC_FORCE_H264:
+        return AV_CODEC_ID_H264;
+    case StreamingPreferences::VCC_FORCE_HEVC:
+    case StreamingPreferences::VCC_FORCE_HEVC_HDR_DEPRECATED:
+        return AV_CODEC_ID_HEVC;
+    case StreamingPreferences::VCC_FORCE_AV1:
+        return AV_CODEC_ID_AV1;
+    default:
+        break;
+    }
+
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "h264" || suffix == "264" || suffix == "avc") {
+        return AV_CODEC_ID_H264;
+    }
+    else if (suffix == "h265" || suffix == "265" || suffix == "hevc") {
+        return AV_CODEC_ID_HEVC;
+    }
+    else if (suffix == "av1" || suffix == "obu") {
+        return AV_CODEC_ID_AV1;
+    }
+
+    return AV_CODEC_ID_NONE;
+}
+
+static void printLatency(const char* name, const LatencyHistogram& histogram)
+{
+    fprintf(stdout, "%-24s p50 %7.2f ms  p90 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n",
+            name,
+            histogram.getPercentileUs(50) / 1000.0,
+            histogram.getPercentileUs(90) / 1000.0,
+            histogram.getPercentileUs(99) / 1000.0,
+            histogram.getMaxUs() / 1000.0);
+}
+
+Launcher::Launcher(BenchmarkCommandLineParser arguments, QObject *parent)
+    : QObject(parent),
+      m_Arguments(arguments)
+{
+}
+
+void Launcher::execute()
+{
+    // Run once the event loop has started, so we can exit it with our result
+    QTimer::singleShot(0, this, &Launcher::onExecute);
+}
+
+void Launcher::onExecute()
+{
+    int result = -1;
+
+    switch (m_Arguments.getBenchmark()) {
+    case BenchmarkCommandLineParser::ColorConversion:
+        result = runColorConversionBenchmark();
+        break;
+    case BenchmarkCommandLineParser::Decode:
+        result = runDecodeBenchmark();
+        break;
+    case BenchmarkCommandLineParser::Replay:
+        result = runReplayBenchmark();
+        break;
+    }
+
+    fflush(stdout);
+    QCoreApplication::exit(result);
+}
+
+int Launcher::runColorConversionBenchmark()
+{
+    int iterations = m_Arguments.getIterations();
+    bool allPassed = true;
+
+    fprintf(stdout, "Converting to XRGB8888 (%d iterations per test)\n", iterations);
+
+    for (auto format : k_ColorConversionFormats) {
+        for (auto resolution : k_Resolutions) {
+            // The noise frame is used for timing and to compare against our scalar
+            // implementation. The gradient frame is used to compare against swscale.
+            AVFrame* src = allocateTestFrame(format, resolution.width, resolution.height);
+            AVFrame* gradient = allocateGradientFrame(format, resolution.width, resolution.height);
+            AVFrame* dst = allocateFrame(AV_PIX_FMT_BGR0, resolution.width, resolution.height);
+            AVFrame* scalarReference = allocateFrame(AV_PIX_FMT_BGR0, resolution.width, resolution.height);
+            AVFrame* swscaleReference = allocateFrame(AV_PIX_FMT_BGR0, resolution.width, resolution.height);
+            if (src == nullptr || gradient == nullptr || dst == nullptr ||
+                    scalarReference == nullptr || swscaleReference == nullptr) {
+                fprintf(stderr, "Failed to allocate frames\n");
+                av_frame_free(&src);
+                av_frame_free(&gradient);
+                av_frame_free(&dst);
+                av_frame_free(&scalarReference);
+                av_frame_free(&swscaleReference);
+                return -1;
+            }
+
+            bool haveSwscaleReference = false;
+            SwsContext* swsContext = createSwsContext(src, dst);
+            if (swsContext != nullptr) {
+                printResult(format, resolution.width, resolution.height, "swscale",
+                            measure(iterations, [&]() {
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100)
+                    sws_scale_frame(swsContext, dst, src);
+#else
+                    sws_scale(swsContext, src->data, src->linesize, 0, src->height,
+                              dst->data, dst->linesize);
+#endif
+                }));
+
+                // Timing uses swscale's default colorspace like SdlRenderer,
+                // but the reference must use the same one as our converter.
+                if (sws_setColorspaceDetails(swsContext,
+                                             sws_getCoefficients(SWS_CS_ITU709), 0,
+                                             sws_getCoefficients(SWS_CS_DEFAULT), 1,
+                                             0, 1 << 16, 1 << 16) >= 0) {
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100)
+                    haveSwscaleReference = sws_scale_frame(swsContext, swscaleReference, gradient) >= 0;
+#else
+                    haveSwscaleReference = sws_scale(swsContext, gradient->data, gradient->linesize, 0, gradient->height,
+                                                     swscaleReference->data, swscaleReference->linesize) > 0;
+#endif
+                }
+
+                sws_freeContext(swsContext);
+            }
+            else {
+                fprintf(stderr, "Failed to create swscale context for %s\n", av_get_pix_fmt_name(format));
+            }
+
+            int bitsPerChannel = av_pix_fmt_desc_get(format)->comp[0].depth;
+            std::array<float, 9> cscMatrix;
+            std::array<float, 3> offsets;
+            getRec709LimitedCscConstants(bitsPerChannel, cscMatrix, offsets);
+
+            YuvToRgbConverter converter;
+            converter.initialize(format, cscMatrix, offsets, bitsPerChannel);
+            int threadCount = converter.getThreadCount();
+
+            converter.setImplementation(YuvToRgbConverter::Scalar);
+            converter.setThreadCount(1);
+            converter.convertFrame(src, scalarReference->data[0], scalarReference->linesize[0]);
+
+            for (int i = 0; i < YuvToRgbConverter::ImplementationMax; i++) {
+                auto implementation = (YuvToRgbConverter::Implementation)i;
+                if (!converter.setImplementation(implementation)) {
+                    continue;
+                }
+
+                const char* name = YuvToRgbConverter::getImplementationName(implementation);
+
+                converter.setThreadCount(1);
+                printResult(format, resolution.width, resolution.height, name,
+                            measure(iterations, [&]() {
+                    converter.convertFrame(src, dst->data[0], dst->linesize[0]);
+                }));
+
+                if (threadCount > 1) {
+                    char threadedName[32];
+                    snprintf(threadedName, sizeof(threadedName), "%s x%d", name, threadCount);
+
+                    converter.setThreadCount(threadCount);
+                    printResult(format, resolution.width, resolution.height, threadedName,
+                                measure(iterations, [&]() {
+                        converter.convertFrame(src, dst->data[0], dst->linesize[0]);
+                    }));
+                }
+
+                // Validate with all threads to cover the band splitting too
+                converter.convertFrame(src, dst->data[0], dst->linesize[0]);
+                int scalarError = getMaxComponentError(scalarReference, dst);
+
+                int swscaleError = -1;
+                if (haveSwscaleReference) {
+                    converter.convertFrame(gradient, dst->data[0], dst->linesize[0]);
+                    swscaleError = getMaxComponentError(swscaleReference, dst);
+                }
+
+                allPassed &= printValidation(format, resolution.width, resolution.height, name,
+                                             scalarError, swscaleError);
+            }
+
+            av_frame_free(&src);
+            av_frame_free(&gradient);
+            av_frame_free(&dst);
+            av_frame_free(&scalarReference);
+            av_frame_free(&swscaleReference);
+        }
+    }
+
+    if (!allPassed) {
+        fprintf(stderr, "Color conversion output exceeded the error tolerance\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int Launcher::runDecodeBenchmark()
+{
+    QString fileName = m_Arguments.getFileName();
+    int fps = m_Arguments.getFps();
+
+    enum AVCodecID codecId = getCodecId(m_Arguments.getVideoCodec(), fileName);
+    if (codecId == AV_CODEC_ID_NONE) {
+        fprintf(stderr, "Unable to detect the codec of %s. Use --video-codec to specify it.\n", qPrintable(fileName));
+        return -1;
+    }
+
+    ElementaryStreamSource source;
+    if (!source.open(fileName, codecId)) {
+        fprintf(stderr, "Failed to load %s\n", qPrintable(fileName));
+        return -1;
+    }
+    source.setFrameRate(fps);
+
+    return runOfflineDecode(source, fps != 0 ? fps : 60, fps != 0,
+                            fps != 0 ? QString("%1 FPS").arg(fps) : "unlimited FPS");
+}
+
+int Launcher::runReplayBenchmark()
+{
+    QString fileName = m_Arguments.getFileName();
+    bool originalTiming = m_Arguments.getOriginalTiming();
+
+    DecodeUnitReplaySource source;
+    if (!source.open(fileName)) {
+        fprintf(stderr, "Failed to load %s\n", qPrintable(fileName));
+        return -1;
+    }
+
+    return runOfflineDecode(source, source.getFrameRate(), originalTiming,
+                            originalTiming ? "original timing" : "unlimited FPS");
+}
+
+int Launcher::runOfflineDecode(OfflineDecodeUnitSource& source, int frameRate, bool paced, const QString& pacingDescription)
+{
+    DECODER_PARAMETERS params = {};
+    params.window = nullptr;
+    params.vds = m_Arguments.getVideoDecoder();
+    params.videoFormat = source.getVideoFormat();
+    params.width = source.getWidth();
+    params.height = source.getHeight();
+    params.frameRate = frameRate;
+    params.pacingPolicy = StreamingPreferences::PP_LATEST_FRAME;
+
+    // Written on the render thread as frames are consumed
+    struct {
+        std::mutex lock;
+        uint32_t renderedFrames = 0;
+        uint64_t lastRenderedTimeUs = 0;
+        LatencyHistogram submitToRender;
+        LatencyHistogram decodeToRender;
+    } results;
+    SDL_zero(results.submitToRender);
+    SDL_zero(results.decodeToRender);
+
+    uint64_t startTimeUs, endTimeUs;
+    uint32_t renderedFrames;
+    bool hardwareAccelerated;
+    {
+        FFmpegVideoDecoder decoder(false);
+        decoder.setDecodeUnitSource(&source);
+        if (!decoder.initialize(&params)) {
+            fprintf(stderr, "No decoder could be initialized for %s\n", qPrintable(m_Arguments.getFileName()));
+            return -1;
+        }
+
+        auto renderer = dynamic_cast<NullRenderer*>(decoder.getFrontendRenderer());
+        SDL_assert(renderer != nullptr);
+
+        switch (m_Arguments.getFrameAccess()) {
+        case BenchmarkCommandLineParser::FA_NONE:
+            renderer->setFrameAccess(NullRenderer::FrameAccess::None);
+            break;
+        case BenchmarkCommandLineParser::FA_TOUCH:
+            renderer->setFrameAccess(NullRenderer::FrameAccess::Touch);
+            break;
+        case BenchmarkCommandLineParser::FA_READBACK:
+            renderer->setFrameAccess(NullRenderer::FrameAccess::Readback);
+            break;
+        }
+
+        renderer->setFrameCallback([&results, &source](const AVFrame* frame, uint64_t renderedTimeUs) {
+            uint64_t submitTimeUs = source.getSubmitTimeUs((int)(uintptr_t)frame->opaque);
+
+            std::lock_guard lg { results.lock };
+            results.renderedFrames++;
+            results.lastRenderedTimeUs = renderedTimeUs;
+            if (submitTimeUs != 0) {
+                results.submitToRender.addSample(renderedTimeUs - submitTimeUs);
+            }
+            results.decodeToRender.addSample(renderedTimeUs - (uint64_t)frame->pkt_dts);
+        });
+
+        hardwareAccelerated = decoder.isHardwareAccelerated();
+
+        fprintf(stdout, "Decoding %d frames (%dx%d) with %s decoder at %s\n",
+                source.getFrameCount(), source.getWidth(), source.getHeight(),
+                hardwareAccelerated ? "hardware" : "software",
+                qPrintable(pacingDescription));
+        fflush(stdout);
+
+        startTimeUs = LiGetMicroseconds();
+        source.start(paced);
+
+        for (;;) {
+            SDL_Delay(10);
+
+            std::lock_guard lg { results.lock };
+            if (results.renderedFrames >= (uint32_t)source.getFrameCount()) {
+                break;
+            }
+            else if (source.isFinished() &&
+                     LiGetMicroseconds() - SDL_max(results.lastRenderedTimeUs, startTimeUs) > DECODE_IDLE_TIMEOUT_US) {
+                break;
+            }
+        }
+    }
+
+    // The decoder has been destroyed, so there are no more writers
+    renderedFrames = results.renderedFrames;
+    endTimeUs = results.lastRenderedTimeUs;
+
+    if (renderedFrames == 0) {
+        fprintf(stderr, "No frames were rendered\n");
+        return -1;
+    }
+
+    double elapsedSecs = (endTimeUs - startTimeUs) / 1000000.0;
+    fprintf(stdout, "Rendered %u of %d frames in %.3f seconds (%.1f FPS)\n",
+            renderedFrames, source.getFrameCount(), elapsedSecs,
+            renderedFrames / elapsedSecs);
+    if (source.getIdrFrameRequests() != 0) {
+        fprintf(stdout, "Decoder requested %u IDR frames\n", source.getIdrFrameRequests());
+    }
+    printLatency("Submit to render:", results.submitToRender);
+    printLatency("Decode to render:", results.decodeToRender);
+
+    return 0;
+}
+
+}
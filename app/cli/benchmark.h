@@ -0,0 +1,33 @@
+#pragma once
+
+#include "commandlineparser.h"
+
+#include <QObject>
+
+class OfflineDecodeUnitSource;
+
+namespace CliBenchmark
+{
+
+class Launcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Launcher(BenchmarkCommandLineParser arguments, QObject *parent = nullptr);
+
+    Q_INVOKABLE void execute();
+
+private slots:
+    void onExecute();
+
+private:
+    int runColorConversionBenchmark();
+    int runDecodeBenchmark();
+    int runReplayBenchmark();
+    int runOfflineDecode(OfflineDecodeUnitSource& source, int frameRate, bool paced, const QString& pacingDescription);
+
+    BenchmarkCommandLineParser m_Arguments;
+};
+
+}
@@ -161,6 +161,7 @@ GlobalCommandLineParser::ParseResult GlobalCommandLineParser::parse(const QStrin
         "  quit            Quit the currently running app\n"
         "  stream          Start streaming an app\n"
         "  pair            Pair a new host\n"
+        "  benchmark       Run a local performance benchmark\n"
         "\n"
         "See 'moonlight <action> --help' for help of specific action."
     );
@@ -192,6 +193,8 @@ GlobalCommandLineParser::ParseResult GlobalCommandLineParser::parse(const QStrin
                 return PairRequested;
             } else if (action == "list") {
                 return ListRequested;
+            } else if (action == "benchmark") {
+                return BenchmarkRequested;
             }
         }
 
@@ -321,6 +324,11 @@ StreamCommandLineParser::StreamCommandLineParser()
         {"fullscreen", StreamingPreferences::CSK_FULLSCREEN},
         {"always",     StreamingPreferences::CSK_ALWAYS},
     };
+    m_PacingPolicyMap = {
+        {"smooth",       StreamingPreferences::PP_SMOOTH},
+        {"latest-frame", StreamingPreferences::PP_LATEST_FRAME},
+        {"adaptive",     StreamingPreferences::PP_ADAPTIVE},
+    };
 }
 
 StreamCommandLineParser::~StreamCommandLineParser()
@@ -360,6 +368,7 @@ void StreamCommandLineParser::parse(const QStringList &args, StreamingPreference
     parser.addToggleOption("game-optimization", "game optimizations");
     parser.addToggleOption("audio-on-host", "audio on host PC");
     parser.addToggleOption("frame-pacing", "frame pacing");
+    parser.addChoiceOption("pacing-policy", "frame pacing policy", m_PacingPolicyMap.keys());
     parser.addToggleOption("mute-on-focus-loss", "mute audio when Moonlight window loses focus");
     parser.addToggleOption("background-gamepad", "background gamepad input");
     parser.addToggleOption("reverse-scroll-direction", "inverted scroll direction");
@@ -496,6 +505,11 @@ void StreamCommandLineParser::parse(const QStringList &args, StreamingPreference
         preferences->captureSysKeysMode = mapValue(m_CaptureSysKeysModeMap, parser.getChoiceOptionValue("capture-system-keys"));
     }
 
+    // Resolve --pacing-policy option
+    if (parser.isSet("pacing-policy")) {
+        preferences->pacingPolicy = mapValue(m_PacingPolicyMap, parser.getChoiceOptionValue("pacing-policy"));
+    }
+
     // Resolve --video-codec option
     if (parser.isSet("video-codec")) {
         preferences->videoCodecConfig = mapValue(m_VideoCodecMap, parser.getChoiceOptionValue("video-codec"));
@@ -591,3 +605,167 @@ bool ListCommandLineParser::isVerbose() const
 {
     return m_Verbose;
 }
+
+BenchmarkCommandLineParser::BenchmarkCommandLineParser()
+    : m_Benchmark(ColorConversion),
+      m_Iterations(100),
+      m_VideoCodec(StreamingPreferences::VCC_AUTO),
+      m_VideoDecoder(StreamingPreferences::VDS_AUTO),
+      m_Fps(0),
+      m_FrameAccess(FA_NONE),
+      m_OriginalTiming(true)
+{
+    m_VideoCodecMap = {
+        {"auto",  StreamingPreferences::VCC_AUTO},
+        {"H.264", StreamingPreferences::VCC_FORCE_H264},
+        {"HEVC",  StreamingPreferences::VCC_FORCE_HEVC},
+        {"AV1", StreamingPreferences::VCC_FORCE_AV1},
+    };
+    m_VideoDecoderMap = {
+        {"auto",     StreamingPreferences::VDS_AUTO},
+        {"software", StreamingPreferences::VDS_FORCE_SOFTWARE},
+        {"hardware", StreamingPreferences::VDS_FORCE_HARDWARE},
+    };
+    m_FrameAccessMap = {
+        {"none",     FA_NONE},
+        {"touch",    FA_TOUCH},
+        {"readback", FA_READBACK},
+    };
+}
+
+BenchmarkCommandLineParser::~BenchmarkCommandLineParser()
+{
+}
+
+void BenchmarkCommandLineParser::parse(const QStringList &args)
+{
+    CommandLineParser parser;
+    parser.setupCommonOptions();
+    parser.setApplicationDescription(
+        "\n"
+        "Run a local performance benchmark. No host or display is required.\n"
+        "\n"
+        "Available benchmarks:\n"
+        "  csc             Compare CPU YUV to RGB conversion against swscale\n"
+        "  decode <file>   Decode an H.264/HEVC Annex B or AV1 OBU elementary stream\n"
+        "  replay <file>   Decode a capture recorded with DECODE_UNIT_CAPTURE=1"
+    );
+    parser.addPositionalArgument("benchmark", "run benchmark");
+    parser.addPositionalArgument("name", "Benchmark to run", "<name>");
+    parser.addPositionalArgument("file", "Elementary stream or capture to decode (decode and replay only)", "[<file>]");
+
+    parser.addValueOption("iterations", "number of iterations for each test (csc only)");
+    parser.addValueOption("fps", "frame rate to submit frames at or 0 for unlimited (decode only)");
+    parser.addChoiceOption("video-codec", "video codec, detected from the file extension if auto (decode only)", m_VideoCodecMap.keys());
+    parser.addChoiceOption("video-decoder", "video decoder (decode and replay only)", m_VideoDecoderMap.keys());
+    parser.addChoiceOption("frame-access", "how decoded frames are read (decode and replay only)", m_FrameAccessMap.keys());
+    parser.addToggleOption("original-timing", "the original frame arrival times (replay only)");
+
+    if (!parser.parse(args)) {
+        parser.showError(parser.errorText());
+    }
+
+    parser.handleUnknownOptions();
+
+    // This method will not return and terminates the process if --version or
+    // --help is specified
+    parser.handleHelpAndVersionOptions();
+
+    // Verify that a benchmark has been provided
+    auto posArgs = parser.positionalArguments();
+    if (posArgs.length() < 2) {
+        parser.showError("Benchmark not provided");
+    }
+
+    QString benchmark = posArgs.at(1).toLower();
+    if (benchmark == "csc") {
+        m_Benchmark = ColorConversion;
+    }
+    else if (benchmark == "decode") {
+        m_Benchmark = Decode;
+
+        if (posArgs.length() < 3) {
+            parser.showError("Elementary stream file not provided");
+        }
+        m_FileName = posArgs.at(2);
+    }
+    else if (benchmark == "replay") {
+        m_Benchmark = Replay;
+
+        if (posArgs.length() < 3) {
+            parser.showError("Capture file not provided");
+        }
+        m_FileName = posArgs.at(2);
+    }
+    else {
+        parser.showError(QString("Invalid benchmark: %1").arg(benchmark));
+    }
+
+    if (parser.isSet("iterations")) {
+        m_Iterations = parser.getIntOption("iterations");
+        if (!inRange(m_Iterations, 1, 100000)) {
+            parser.showError("Iterations must be between 1 and 100000");
+        }
+    }
+
+    if (parser.isSet("fps")) {
+        m_Fps = parser.getIntOption("fps");
+        if (!inRange(m_Fps, 0, 1000)) {
+            parser.showError("FPS must be between 0 and 1000");
+        }
+    }
+
+    if (parser.isSet("video-codec")) {
+        m_VideoCodec = mapValue(m_VideoCodecMap, parser.getChoiceOptionValue("video-codec"));
+    }
+
+    if (parser.isSet("video-decoder")) {
+        m_VideoDecoder = mapValue(m_VideoDecoderMap, parser.getChoiceOptionValue("video-decoder"));
+    }
+
+    if (parser.isSet("frame-access")) {
+        m_FrameAccess = mapValue(m_FrameAccessMap, parser.getChoiceOptionValue("frame-access"));
+    }
+
+    m_OriginalTiming = parser.getToggleOptionValue("original-timing", m_OriginalTiming);
+}
+
+BenchmarkCommandLineParser::Benchmark BenchmarkCommandLineParser::getBenchmark() const
+{
+    return m_Benchmark;
+}
+
+int BenchmarkCommandLineParser::getIterations() const
+{
+    return m_Iterations;
+}
+
+QString BenchmarkCommandLineParser::getFileName() const
+{
+    return m_FileName;
+}
+
+StreamingPreferences::VideoCodecConfig BenchmarkCommandLineParser::getVideoCodec() const
+{
+    return m_VideoCodec;
+}
+
+StreamingPreferences::VideoDecoderSelection BenchmarkCommandLineParser::getVideoDecoder() const
+{
+    return m_VideoDecoder;
+}
+
+int BenchmarkCommandLineParser::getFps() const
+{
+    return m_Fps;
+}
+
+BenchmarkCommandLineParser::FrameAccess BenchmarkCommandLineParser::getFrameAccess() const
+{
+    return m_FrameAccess;
+}
+
+bool BenchmarkCommandLineParser::getOriginalTiming() const
+{
+    return m_OriginalTiming;
+}
@@ -14,6 +14,7 @@ public:
         QuitRequested,
         PairRequested,
         ListRequested,
+        BenchmarkRequested,
     };
 
     GlobalCommandLineParser();
@@ -72,6 +73,7 @@ private:
     QMap<QString, StreamingPreferences::VideoCodecConfig> m_VideoCodecMap;
     QMap<QString, StreamingPreferences::VideoDecoderSelection> m_VideoDecoderMap;
     QMap<QString, StreamingPreferences::CaptureSysKeysMode> m_CaptureSysKeysModeMap;
+    QMap<QString, StreamingPreferences::PacingPolicy> m_PacingPolicyMap;
 };
 
 class ListCommandLineParser
@@ -91,3 +93,47 @@ private:
     bool m_PrintCSV;
     bool m_Verbose;
 };
+
+class BenchmarkCommandLineParser
+{
+public:
+    enum Benchmark {
+        ColorConversion,
+        Decode,
+        Replay,
+    };
+
+    enum FrameAccess {
+        FA_NONE,
+        FA_TOUCH,
+        FA_READBACK,
+    };
+
+    BenchmarkCommandLineParser();
+    virtual ~BenchmarkCommandLineParser();
+
+    void parse(const QStringList &args);
+
+    Benchmark getBenchmark() const;
+    int getIterations() const;
+    QString getFileName() const;
+    StreamingPreferences::VideoCodecConfig getVideoCodec() const;
+    StreamingPreferences::VideoDecoderSelection getVideoDecoder() const;
+    int getFps() const;
+    FrameAccess getFrameAccess() const;
+    bool getOriginalTiming() const;
+
+private:
+    QMap<QString, StreamingPreferences::VideoCodecConfig> m_VideoCodecMap;
+    QMap<QString, StreamingPreferences::VideoDecoderSelection> m_VideoDecoderMap;
+    QMap<QString, FrameAccess> m_FrameAccessMap;
+
+    Benchmark m_Benchmark;
+    int m_Iterations;
+    QString m_FileName;
+    StreamingPreferences::VideoCodecConfig m_VideoCodec;
+    StreamingPreferences::VideoDecoderSelection m_VideoDecoder;
+    int m_Fps;
+    FrameAccess m_FrameAccess;
+    bool m_OriginalTiming;
+};
@@ -845,6 +845,53 @@ Flickable {
                     ToolTip.visible: hovered
                     ToolTip.text: qsTr("Frame pacing reduces micro-stutter by delaying frames that come in too early")
                 }
+
+                AutoResizingComboBox {
+                    // ignore setting the index at first, and actually set it when the component is loaded
+                    Component.onCompleted: {
+                        var saved_pacingpolicy = StreamingPreferences.pacingPolicy
+                        currentIndex = 0
+                        for (var i = 0; i < pacingPolicyListModel.count; i++) {
+                            var el_pacingpolicy = pacingPolicyListModel.get(i).val;
+                            if (saved_pacingpolicy === el_pacingpolicy) {
+                                currentIndex = i
+                                break
+                            }
+                        }
+
+                        activated(currentIndex)
+                    }
+
+                    id: pacingPolicyComboBox
+                    enabled: framePacingCheck.checked
+                    hoverEnabled: true
+                    textRole: "text"
+                    model: ListModel {
+                        id: pacingPolicyListModel
+                        ListElement {
+                            text: qsTr("Smooth")
+                            val: StreamingPreferences.PP_SMOOTH
+                        }
+                        ListElement {
+                            text: qsTr("Lowest latency")
+                            val: StreamingPreferences.PP_LATEST_FRAME
+                        }
+                        ListElement {
+                            text: qsTr("Adaptive")
+                            val: StreamingPreferences.PP_ADAPTIVE
+                        }
+                    }
+
+                    // ::onActivated must be used, as it only listens for when the index is changed by a human
+                    onActivated: {
+                        StreamingPreferences.pacingPolicy = pacingPolicyListModel.get(currentIndex).val
+                    }
+
+                    ToolTip.delay: 1000
+                    ToolTip.timeout: 5000
+                    ToolTip.visible: hovered
+                    ToolTip.text: qsTr("Smooth buffers extra frames to avoid stutter. Lowest latency always shows the newest frame, even if that causes stutter. Adaptive buffers only as many frames as network jitter requires.")
+                }
             }
         }
 
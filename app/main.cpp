@@ -42,6 +42,9 @@
 #include "cli/startstream.h"
 #include "cli/pair.h"
 #include "cli/commandlineparser.h"
+#ifdef HAVE_FFMPEG
+#include "cli/benchmark.h"
+#endif
 #include "path.h"
 #include "utils.h"
 #include "gui/computermodel.h"
@@ -395,6 +398,25 @@ void configureSignalHandlers()
 
 #endif
 
+// This runs before the QGuiApplication exists, so it mirrors the action
+// search in GlobalCommandLineParser::parse() rather than using it.
+static bool isBenchmarkRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strcasecmp(argv[i], "benchmark") == 0) {
+            return true;
+        }
+        else if (SDL_strcasecmp(argv[i], "quit") == 0 ||
+                 SDL_strcasecmp(argv[i], "stream") == 0 ||
+                 SDL_strcasecmp(argv[i], "pair") == 0 ||
+                 SDL_strcasecmp(argv[i], "list") == 0) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
 int main(int argc, char *argv[])
 {
     SDL_SetMainReady();
@@ -497,6 +519,13 @@ int main(int argc, char *argv[])
     // created when open() is called, this doesn't do any harm for other platforms.
     QTemporaryFile eglfsConfigFile;
 
+    // Benchmarks don't need a display, so don't let Qt try to take one over
+    // (or fail to start without one). This also keeps us from defaulting to
+    // EGLFS and forcing SDL onto KMSDRM below.
+    if (isBenchmarkRequested(argc, argv) && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     // Avoid using High DPI on EGLFS. It breaks font rendering.
     // https://bugreports.qt.io/browse/QTBUG-64377
     //
@@ -744,6 +773,7 @@ int main(int argc, char *argv[])
     GlobalCommandLineParser::ParseResult commandLineParserResult = parser.parse(app.arguments());
     switch (commandLineParserResult) {
     case GlobalCommandLineParser::ListRequested:
+    case GlobalCommandLineParser::BenchmarkRequested:
         // Don't log to the console since it will jumble the command output
         s_SuppressVerboseOutput = true;
         break;
@@ -928,6 +958,20 @@ int main(int argc, char *argv[])
             hasGUI = false;
             break;
         }
+    case GlobalCommandLineParser::BenchmarkRequested:
+        {
+#ifdef HAVE_FFMPEG
+            BenchmarkCommandLineParser benchmarkParser;
+            benchmarkParser.parse(app.arguments());
+            auto launcher = new CliBenchmark::Launcher(benchmarkParser, &app);
+            launcher->execute();
+            hasGUI = false;
+#else
+            fprintf(stderr, "Benchmarks require Moonlight to be built with FFmpeg\n");
+            return -1;
+#endif
+            break;
+        }
     }
 
     if (hasGUI) {
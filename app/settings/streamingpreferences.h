@@ -108,6 +108,14 @@ public:
     };
     Q_ENUM(CaptureSysKeysMode);
 
+    enum PacingPolicy
+    {
+        PP_SMOOTH,
+        PP_LATEST_FRAME,
+        PP_ADAPTIVE,
+    };
+    Q_ENUM(PacingPolicy);
+
     Q_PROPERTY(int width MEMBER width NOTIFY displayModeChanged)
     Q_PROPERTY(int height MEMBER height NOTIFY displayModeChanged)
     Q_PROPERTY(int fps MEMBER fps NOTIFY displayModeChanged)
@@ -123,6 +131,7 @@ public:
     Q_PROPERTY(bool absoluteMouseMode MEMBER absoluteMouseMode NOTIFY absoluteMouseModeChanged)
     Q_PROPERTY(bool absoluteTouchMode MEMBER absoluteTouchMode NOTIFY absoluteTouchModeChanged)
     Q_PROPERTY(bool framePacing MEMBER framePacing NOTIFY framePacingChanged)
+    Q_PROPERTY(PacingPolicy pacingPolicy MEMBER pacingPolicy NOTIFY pacingPolicyChanged)
     Q_PROPERTY(bool connectionWarnings MEMBER connectionWarnings NOTIFY connectionWarningsChanged)
     Q_PROPERTY(bool configurationWarnings MEMBER configurationWarnings NOTIFY configurationWarningsChanged)
     Q_PROPERTY(bool richPresence MEMBER richPresence NOTIFY richPresenceChanged)
@@ -187,6 +196,7 @@ public:
     UIDisplayMode uiDisplayMode;
     Language language;
     CaptureSysKeysMode captureSysKeysMode;
+    PacingPolicy pacingPolicy;
 
 signals:
     void displayModeChanged();
@@ -210,6 +220,7 @@ signals:
     void uiDisplayModeChanged();
     void windowModeChanged();
     void framePacingChanged();
+    void pacingPolicyChanged();
     void connectionWarningsChanged();
     void configurationWarningsChanged();
     void richPresenceChanged();
@@ -9,6 +9,12 @@
 
 #include <Limelight.h>
 
+// Stop synthesizing audio for lost packets after this long
+#define MAX_CONCEALED_AUDIO_MS 100
+
+// Packets waiting for the decode thread (over 300 ms at 5 ms per packet)
+#define AUDIO_PACKET_RING_SIZE 64
+
 #define TRY_INIT_RENDERER(renderer, opusConfig)        \
 {                                                      \
     IAudioRenderer* __renderer = new renderer();       \
@@ -17,6 +23,74 @@
     delete __renderer;                                 \
 }
 
+// Returns true if the first Opus stream in the packet carries LBRR (in-band FEC)
+// data for the previous packet. This does what opus_packet_has_lbrr() in Opus 1.5
+// does, but it also handles the self-delimited framing used for all but the last
+// stream of a multistream packet (RFC 6716 Appendix B).
+static bool opusPacketHasLbrr(const unsigned char* data, int length, bool selfDelimited)
+{
+    if (length < 1) {
+        return false;
+    }
+
+    // Only SILK and hybrid packets (TOC config < 16) can carry LBRR data
+    if ((data[0] >> 3) >= 16) {
+        return false;
+    }
+
+    // Skip the frame length fields to find the start of the first frame
+    int offset = 1;
+    int lengthFields = selfDelimited ? 1 : 0;
+    switch (data[0] & 0x3) {
+    case 2:
+        lengthFields++;
+        break;
+    case 3:
+    {
+        if (length < 2) {
+            return false;
+        }
+
+        int frameCount = data[1] & 0x3F;
+        bool vbr = !!(data[1] & 0x80);
+        bool padding = !!(data[1] & 0x40);
+        offset = 2;
+
+        if (padding) {
+            while (offset < length && data[offset++] == 255);
+        }
+        if (vbr) {
+            lengthFields += frameCount - 1;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    for (int i = 0; i < lengthFields; i++) {
+        if (offset >= length) {
+            return false;
+        }
+        offset += data[offset] >= 252 ? 2 : 1;
+    }
+
+    if (offset >= length) {
+        return false;
+    }
+
+    // The LBRR flags follow the VAD flag of each 20 ms SILK frame in this
+    // Opus frame, and they're coded with equal probability, so they're just
+    // the leading bits of the range coder's first byte.
+    int silkFrames = SDL_max(opus_packet_get_samples_per_frame(data, 48000) / 960, 1);
+    bool lbrr = (data[offset] >> (7 - silkFrames)) & 0x1;
+    if (opus_packet_get_nb_channels(data) == 2) {
+        lbrr = lbrr || ((data[offset] >> (6 - 2 * silkFrames)) & 0x1);
+    }
+
+    return lbrr;
+}
+
 IAudioRenderer* Session::createAudioRenderer(const POPUS_MULTISTREAM_CONFIGURATION opusConfig)
 {
     // Handle explicit ML_AUDIO setting and fail if the requested backend fails
@@ -87,6 +161,10 @@ bool Session::initializeAudioRenderer()
         return false;
     }
 
+    m_AudioFrameLost = false;
+    m_AudioFecPossible = false;
+    m_ConsecutiveLostAudioFrames = 0;
+
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                 "Audio stream has %d channels",
                 m_ActiveAudioConfig.channelCount);
@@ -102,6 +180,10 @@ int Session::getAudioRendererCapabilities(int audioConfiguration)
     // All audio renderers support arbitrary audio duration
     caps |= CAPABILITY_SUPPORTS_ARBITRARY_AUDIO_DURATION;
 
+    // We queue packets for our own decode thread rather than
+    // having the connection library queue them for us.
+    caps |= CAPABILITY_DIRECT_SUBMIT;
+
 #ifdef STEAM_LINK
     // Steam Link devices have slow Opus decoders
     caps |= CAPABILITY_SLOW_OPUS_DECODER;
@@ -129,17 +211,249 @@ bool Session::testAudio(int audioConfiguration)
     return true;
 }
 
+void Session::addAudioStats(AUDIO_STATS& src, AUDIO_STATS& dst)
+{
+    dst.underruns += src.underruns;
+    dst.overruns += src.overruns;
+    dst.concealedFrames += src.concealedFrames;
+    dst.fecRecoveredFrames += src.fecRecoveredFrames;
+    dst.droppedFrames += src.droppedFrames;
+    dst.decodedFrames += src.decodedFrames;
+    dst.totalDecodeTimeUs += src.totalDecodeTimeUs;
+    dst.totalLatencyDeltaUs += src.totalLatencyDeltaUs;
+    dst.latencyDeltaMeasurements += src.latencyDeltaMeasurements;
+    dst.samplesInserted += src.samplesInserted;
+    dst.samplesRemoved += src.samplesRemoved;
+    dst.bufferMeasurements += src.bufferMeasurements;
+    dst.totalBufferedSamples += src.totalBufferedSamples;
+
+    // These are snapshots, so take the newest one we have
+    if (src.sampleRate != 0) {
+        dst.jitterUs = src.jitterUs;
+        dst.targetBufferedSamples = src.targetBufferedSamples;
+        dst.deviceLatencySamples = src.deviceLatencySamples;
+        dst.sampleRate = src.sampleRate;
+    }
+
+    if (!dst.measurementStartUs) {
+        dst.measurementStartUs = src.measurementStartUs;
+    }
+}
+
+void Session::stringifyAudioStats(AUDIO_STATS& stats, char* output, int length)
+{
+    int offset = 0;
+    int ret;
+
+    // Start with an empty string
+    output[offset] = 0;
+
+    // Only renderers that buffer audio themselves report these
+    if (stats.sampleRate != 0 && stats.bufferMeasurements != 0) {
+        double msPerSample = 1000.0 / stats.sampleRate;
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Audio buffer: %.1f ms (target %.1f ms, network jitter %.1f ms)\n"
+                       "Audio device latency: %.1f ms\n"
+                       "Audio time-stretching: +%.1f/-%.1f ms, underruns: %u, overruns: %u\n",
+                       (double)stats.totalBufferedSamples / stats.bufferMeasurements * msPerSample,
+                       stats.targetBufferedSamples * msPerSample,
+                       stats.jitterUs / 1000.0,
+                       stats.deviceLatencySamples * msPerSample,
+                       stats.samplesInserted * msPerSample,
+                       stats.samplesRemoved * msPerSample,
+                       stats.underruns,
+                       stats.overruns);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    if (stats.decodedFrames != 0) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Average audio decoding time: %.2f ms\n",
+                       (double)(stats.totalDecodeTimeUs / 1000.0) / stats.decodedFrames);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    if (stats.latencyDeltaMeasurements != 0) {
+        double latencyDeltaMs = (double)(stats.totalLatencyDeltaUs / 1000.0) / stats.latencyDeltaMeasurements;
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Pipeline latency delta (video - audio): %+.1f ms\n",
+                       latencyDeltaMs);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    if (stats.concealedFrames != 0 || stats.fecRecoveredFrames != 0 || stats.droppedFrames != 0) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Lost audio frames: %u concealed, %u recovered with FEC, %u dropped\n",
+                       stats.concealedFrames,
+                       stats.fecRecoveredFrames,
+                       stats.droppedFrames);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+}
+
+void Session::updateAudioStats()
+{
+    // Collect any counters kept by the renderer for this window
+    if (m_AudioRenderer != nullptr) {
+        m_AudioRenderer->addRendererStats(&m_ActiveWndAudioStats);
+    }
+
+    // Packets that arrived while the decode thread was too far behind
+    m_ActiveWndAudioStats.droppedFrames += SDL_AtomicSet(&m_AudioPacketsOverflowed, 0);
+
+    // Compare the average time video takes from arriving here to being presented
+    // with the audio we have queued for playback. This is only the difference in
+    // our own pipeline latency, not a measurement of A/V sync, since it doesn't
+    // account for when the host captured each frame or how long it took to send.
+    //
+    // TODO: Measure the real presentation offset by pairing the RTP timestamps of
+    // presented audio and video. Video frames have DECODE_UNIT::rtpTimestamp, but
+    // moonlight-common-c doesn't pass the audio RTP timestamp to
+    // decodeAndPlaySample(), so that needs a new audio callback there first.
+    uint32_t videoLatencyUs = m_VideoPresentationLatencyUs;
+    if (videoLatencyUs != 0 && m_ActiveWndAudioStats.sampleRate != 0 && m_ActiveWndAudioStats.bufferMeasurements != 0) {
+        uint64_t audioLatencySamples = m_ActiveWndAudioStats.totalBufferedSamples / m_ActiveWndAudioStats.bufferMeasurements +
+                                       m_ActiveWndAudioStats.deviceLatencySamples;
+        uint64_t audioLatencyUs = audioLatencySamples * 1000000 / m_ActiveWndAudioStats.sampleRate;
+
+        m_ActiveWndAudioStats.totalLatencyDeltaUs += (int64_t)videoLatencyUs - (int64_t)audioLatencyUs;
+        m_ActiveWndAudioStats.latencyDeltaMeasurements++;
+    }
+
+    // Update overlay stats if it's enabled
+    if (m_OverlayManager.isOverlayEnabled(Overlay::OverlayDebug)) {
+        AUDIO_STATS lastTwoWndStats = {};
+        char text[sizeof(m_AudioOverlayText)];
+
+        addAudioStats(m_LastWndAudioStats, lastTwoWndStats);
+        addAudioStats(m_ActiveWndAudioStats, lastTwoWndStats);
+        stringifyAudioStats(lastTwoWndStats, text, sizeof(text));
+
+        std::lock_guard lg { m_AudioOverlayTextLock };
+        SDL_strlcpy(m_AudioOverlayText, text, sizeof(m_AudioOverlayText));
+    }
+
+    // Accumulate these values into the global stats
+    addAudioStats(m_ActiveWndAudioStats, m_GlobalAudioStats);
+
+    // Move this window into the last window slot and clear it for next window
+    SDL_memcpy(&m_LastWndAudioStats, &m_ActiveWndAudioStats, sizeof(m_ActiveWndAudioStats));
+    SDL_zero(m_ActiveWndAudioStats);
+    m_ActiveWndAudioStats.measurementStartUs = LiGetMicroseconds();
+}
+
+void Session::logAudioStats(AUDIO_STATS& stats, const char* title)
+{
+    char audioStatsStr[1024];
+    stringifyAudioStats(stats, audioStatsStr, sizeof(audioStatsStr));
+
+    if (audioStatsStr[0] != 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "\n%s\n------------------\n%s",
+                    title, audioStatsStr);
+    }
+}
+
+int Session::getPendingAudioFrames()
+{
+    if (m_AudioPacketRing == nullptr) {
+        return 0;
+    }
+
+    // The packet being decoded stays in the ring until playback returns, but
+    // like LiGetPendingAudioFrames(), we only count the ones behind it.
+    return SDL_max(m_AudioPacketRing->getQueuedPackets() - 1, 0);
+}
+
+int Session::getPendingAudioDuration()
+{
+    if (m_ActiveAudioConfig.sampleRate == 0) {
+        return 0;
+    }
+
+    return getPendingAudioFrames() * m_ActiveAudioConfig.samplesPerFrame * 1000 / m_ActiveAudioConfig.sampleRate;
+}
+
+void Session::setVideoPresentationLatency(uint32_t latencyUs)
+{
+    m_VideoPresentationLatencyUs = latencyUs;
+}
+
+void Session::getAudioOverlayText(char* output, int length)
+{
+    std::lock_guard lg { m_AudioOverlayTextLock };
+    SDL_strlcpy(output, m_AudioOverlayText, length);
+}
+
 int Session::arInit(int /* audioConfiguration */,
                     const POPUS_MULTISTREAM_CONFIGURATION opusConfig,
                     void* /* arContext */, int /* arFlags */)
 {
     SDL_memcpy(&s_ActiveSession->m_OriginalAudioConfig, opusConfig, sizeof(*opusConfig));
     s_ActiveSession->initializeAudioRenderer();
+
+    SDL_zero(s_ActiveSession->m_ActiveWndAudioStats);
+    SDL_zero(s_ActiveSession->m_LastWndAudioStats);
+    SDL_zero(s_ActiveSession->m_GlobalAudioStats);
+    s_ActiveSession->m_ActiveWndAudioStats.measurementStartUs = LiGetMicroseconds();
+
+    // Decoding and playback happen on a thread of our own, so a slow decoder
+    // or a renderer that blocks never delays the network receive thread.
+    s_ActiveSession->m_AudioPacketRing = new AudioPacketRing(AUDIO_PACKET_RING_SIZE);
+    s_ActiveSession->m_AudioPacketsQueued = SDL_CreateSemaphore(0);
+    SDL_AtomicSet(&s_ActiveSession->m_AudioDecodeThreadStopping, 0);
+    SDL_AtomicSet(&s_ActiveSession->m_AudioPacketsOverflowed, 0);
+    s_ActiveSession->m_AudioDecodeThread = SDL_CreateThread(Session::audioDecodeThread, "AudioDecoder", s_ActiveSession);
+    if (s_ActiveSession->m_AudioDecodeThread == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to create audio decode thread: %s",
+                     SDL_GetError());
+    }
     return 0;
 }
 
 void Session::arCleanup()
 {
+    if (s_ActiveSession->m_AudioDecodeThread != nullptr) {
+        SDL_AtomicSet(&s_ActiveSession->m_AudioDecodeThreadStopping, 1);
+        SDL_SemPost(s_ActiveSession->m_AudioPacketsQueued);
+        SDL_WaitThread(s_ActiveSession->m_AudioDecodeThread, nullptr);
+        s_ActiveSession->m_AudioDecodeThread = nullptr;
+    }
+
+    SDL_DestroySemaphore(s_ActiveSession->m_AudioPacketsQueued);
+    s_ActiveSession->m_AudioPacketsQueued = nullptr;
+    delete s_ActiveSession->m_AudioPacketRing;
+    s_ActiveSession->m_AudioPacketRing = nullptr;
+
+    // Include the final partial window in the session summary
+    s_ActiveSession->updateAudioStats();
+    logAudioStats(s_ActiveSession->m_GlobalAudioStats, "Global audio stats");
+
     delete s_ActiveSession->m_AudioRenderer;
     s_ActiveSession->m_AudioRenderer = nullptr;
 
@@ -147,109 +461,229 @@ void Session::arCleanup()
     s_ActiveSession->m_OpusDecoder = nullptr;
 }
 
-void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
+bool Session::decodeAudioFrame(const unsigned char* data, int length, bool decodeFec)
 {
     int samplesDecoded;
 
-#ifndef STEAM_LINK
-    // Set this thread to high priority to reduce the chance of missing
-    // our sample delivery time. On Steam Link, this causes starvation
-    // of other threads due to severely restricted CPU time available,
-    // so we will skip it on that platform.
-    if (s_ActiveSession->m_AudioSampleCount == 0) {
-        if (SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH) < 0) {
-            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                        "Unable to set audio thread to high priority: %s",
-                        SDL_GetError());
+    int sampleSize = m_AudioRenderer->getAudioBufferSampleSize();
+    int frameSize = sampleSize * m_ActiveAudioConfig.channelCount;
+    int desiredBufferSize = frameSize * m_ActiveAudioConfig.samplesPerFrame;
+    void* buffer = m_AudioRenderer->getAudioBuffer(&desiredBufferSize);
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    // Concealment and FEC must be asked for exactly the duration that was lost
+    int maxSamples = desiredBufferSize / frameSize;
+    if (data == nullptr || decodeFec) {
+        maxSamples = SDL_min(maxSamples, m_ActiveAudioConfig.samplesPerFrame);
+    }
+
+    uint64_t decodeStartTimeUs = LiGetMicroseconds();
+    if (m_AudioRenderer->getAudioBufferFormat() == IAudioRenderer::AudioFormat::Float32NE) {
+        samplesDecoded = opus_multistream_decode_float(m_OpusDecoder,
+                                                       data,
+                                                       length,
+                                                       (float*)buffer,
+                                                       maxSamples,
+                                                       decodeFec ? 1 : 0);
+    }
+    else {
+        samplesDecoded = opus_multistream_decode(m_OpusDecoder,
+                                                 data,
+                                                 length,
+                                                 (short*)buffer,
+                                                 maxSamples,
+                                                 decodeFec ? 1 : 0);
+    }
+    m_ActiveWndAudioStats.totalDecodeTimeUs += LiGetMicroseconds() - decodeStartTimeUs;
+    m_ActiveWndAudioStats.decodedFrames++;
+
+    // Update desiredSize with the number of bytes actually populated by the decoding operation
+    if (samplesDecoded > 0) {
+        SDL_assert(desiredBufferSize >= frameSize * samplesDecoded);
+        desiredBufferSize = frameSize * samplesDecoded;
+    }
+    else {
+        desiredBufferSize = 0;
+    }
+
+    if (!m_AudioRenderer->submitAudio(desiredBufferSize)) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Reinitializing audio renderer after failure");
+
+        opus_multistream_decoder_destroy(m_OpusDecoder);
+        m_OpusDecoder = nullptr;
+
+        delete m_AudioRenderer;
+        m_AudioRenderer = nullptr;
+        return false;
+    }
+
+    return samplesDecoded > 0;
+}
+
+void Session::concealLostAudioFrame(const unsigned char* nextPacket, int nextPacketLength)
+{
+    SDL_assert(m_AudioFrameLost);
+    m_AudioFrameLost = false;
+
+    if (m_AudioRenderer == nullptr) {
+        m_ActiveWndAudioStats.droppedFrames++;
+        return;
+    }
+
+    // After this long, concealment has faded to silence anyway,
+    // so let the renderer's buffer run dry and start over instead.
+    if (++m_ConsecutiveLostAudioFrames * m_ActiveAudioConfig.samplesPerFrame >
+            m_ActiveAudioConfig.sampleRate * MAX_CONCEALED_AUDIO_MS / 1000) {
+        m_ActiveWndAudioStats.droppedFrames++;
+        return;
+    }
+
+    // Opus quietly falls back to concealment when asked to decode FEC data
+    // from a packet that has none, so only count what was really recovered.
+    if (nextPacket != nullptr &&
+            opusPacketHasLbrr(nextPacket, nextPacketLength, m_ActiveAudioConfig.streams > 1)) {
+        // Recover the lost frame from the redundant copy in the next packet
+        if (decodeAudioFrame(nextPacket, nextPacketLength, true)) {
+            m_ActiveWndAudioStats.fecRecoveredFrames++;
+            return;
         }
     }
-#endif
+    else if (decodeAudioFrame(nullptr, 0, false)) {
+        m_ActiveWndAudioStats.concealedFrames++;
+        return;
+    }
+
+    m_ActiveWndAudioStats.droppedFrames++;
+}
 
+void Session::decodeAndPlayAudioPacket(const unsigned char* data, int length)
+{
     // See if we need to drop this sample
-    if (s_ActiveSession->m_DropAudioEndTime != 0) {
-        if (SDL_TICKS_PASSED(SDL_GetTicks(), s_ActiveSession->m_DropAudioEndTime)) {
+    if (m_DropAudioEndTime != 0) {
+        if (SDL_TICKS_PASSED(SDL_GetTicks(), m_DropAudioEndTime)) {
             // Avoid calling SDL_GetTicks() now
-            s_ActiveSession->m_DropAudioEndTime = 0;
+            m_DropAudioEndTime = 0;
 
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                         "Audio drop window has ended");
         }
         else {
             // We're still in the drop window
+            if (data == nullptr) {
+                m_ActiveWndAudioStats.droppedFrames++;
+            }
             return;
         }
     }
 
-    s_ActiveSession->m_AudioSampleCount++;
+    m_AudioSampleCount++;
+
+    // Flip stats windows roughly every second
+    if (LiGetMicroseconds() > m_ActiveWndAudioStats.measurementStartUs + 1000000) {
+        updateAudioStats();
+    }
 
     // If audio is muted, don't decode or play the audio
-    if (s_ActiveSession->m_AudioMuted) {
+    if (m_AudioMuted) {
+        m_AudioFrameLost = false;
         return;
     }
 
-    if (s_ActiveSession->m_AudioRenderer != nullptr) {
-        int sampleSize = s_ActiveSession->m_AudioRenderer->getAudioBufferSampleSize();
-        int frameSize = sampleSize * s_ActiveSession->m_ActiveAudioConfig.channelCount;
-        int desiredBufferSize = frameSize * s_ActiveSession->m_ActiveAudioConfig.samplesPerFrame;
-        void* buffer = s_ActiveSession->m_AudioRenderer->getAudioBuffer(&desiredBufferSize);
-        if (buffer == nullptr) {
-            return;
-        }
-
-        if (s_ActiveSession->m_AudioRenderer->getAudioBufferFormat() == IAudioRenderer::AudioFormat::Float32NE) {
-            samplesDecoded = opus_multistream_decode_float(s_ActiveSession->m_OpusDecoder,
-                                                           (unsigned char*)sampleData,
-                                                           sampleLength,
-                                                           (float*)buffer,
-                                                           desiredBufferSize / frameSize,
-                                                           0);
-        }
-        else {
-            samplesDecoded = opus_multistream_decode(s_ActiveSession->m_OpusDecoder,
-                                                     (unsigned char*)sampleData,
-                                                     sampleLength,
-                                                     (short*)buffer,
-                                                     desiredBufferSize / frameSize,
-                                                     0);
-        }
-
-        // Update desiredSize with the number of bytes actually populated by the decoding operation
-        if (samplesDecoded > 0) {
-            SDL_assert(desiredBufferSize >= frameSize * samplesDecoded);
-            desiredBufferSize = frameSize * samplesDecoded;
+    if (m_AudioRenderer != nullptr) {
+        if (data == nullptr) {
+            // A packet with no data stands for one that was lost on the
+            // network. If the next packet may carry FEC data for it,
+            // wait for that packet rather than concealing it now.
+            if (m_AudioFrameLost) {
+                concealLostAudioFrame(nullptr, 0);
+            }
+            m_AudioFrameLost = true;
+            if (!m_AudioFecPossible) {
+                concealLostAudioFrame(nullptr, 0);
+            }
         }
         else {
-            desiredBufferSize = 0;
-        }
-
-        if (!s_ActiveSession->m_AudioRenderer->submitAudio(desiredBufferSize)) {
-            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                        "Reinitializing audio renderer after failure");
-
-            opus_multistream_decoder_destroy(s_ActiveSession->m_OpusDecoder);
-            s_ActiveSession->m_OpusDecoder = nullptr;
-
-            delete s_ActiveSession->m_AudioRenderer;
-            s_ActiveSession->m_AudioRenderer = nullptr;
+            // Only SILK and hybrid packets (TOC config < 16) can carry
+            // in-band FEC. Hosts normally send CELT-only packets.
+            m_AudioFecPossible = length > 0 && (data[0] >> 3) < 16;
+
+            if (m_AudioFrameLost) {
+                concealLostAudioFrame(data, length);
+            }
+
+            if (m_AudioRenderer != nullptr) {
+                m_ConsecutiveLostAudioFrames = 0;
+                decodeAudioFrame(data, length, false);
+            }
         }
     }
+    else if (data == nullptr) {
+        m_ActiveWndAudioStats.droppedFrames++;
+    }
 
     // Only try to recreate the audio renderer every 200 samples (1 second)
     // to avoid thrashing if the audio device is unavailable. It is
     // safe to reinitialize here because we can't be torn down while
     // the audio decoder/playback thread is still alive.
-    if (s_ActiveSession->m_AudioRenderer == nullptr && (s_ActiveSession->m_AudioSampleCount % 200) == 0) {
+    if (m_AudioRenderer == nullptr && (m_AudioSampleCount % 200) == 0) {
         // Since we're doing this inline and audio initialization takes time, we need
         // to drop samples to account for the time we've spent blocking audio rendering
         // so we return to real-time playback and don't accumulate latency.
         Uint32 audioReinitStartTime = SDL_GetTicks();
-        if (s_ActiveSession->initializeAudioRenderer()) {
+        if (initializeAudioRenderer()) {
             Uint32 audioReinitStopTime = SDL_GetTicks();
 
-            s_ActiveSession->m_DropAudioEndTime = audioReinitStopTime + (audioReinitStopTime - audioReinitStartTime);
+            m_DropAudioEndTime = audioReinitStopTime + (audioReinitStopTime - audioReinitStartTime);
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                         "Audio reinitialization took %d ms - starting drop window",
                         audioReinitStopTime - audioReinitStartTime);
         }
     }
 }
+
+int Session::audioDecodeThread(void* context)
+{
+    auto me = (Session*)context;
+
+#ifndef STEAM_LINK
+    // Set this thread to real-time priority to reduce the chance of missing
+    // our sample delivery time. On Steam Link, this causes starvation
+    // of other threads due to severely restricted CPU time available,
+    // so we will skip it on that platform.
+    if (SDL_SetThreadPriority(SDL_THREAD_PRIORITY_TIME_CRITICAL) < 0 &&
+            SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH) < 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Unable to set audio thread to high priority: %s",
+                    SDL_GetError());
+    }
+#endif
+
+    while (SDL_SemWait(me->m_AudioPacketsQueued) == 0 && !SDL_AtomicGet(&me->m_AudioDecodeThreadStopping)) {
+        int length;
+        const uint8_t* packet = me->m_AudioPacketRing->peek(&length);
+        SDL_assert(packet != nullptr);
+
+        me->decodeAndPlayAudioPacket(length > 0 ? packet : nullptr, length);
+        me->m_AudioPacketRing->pop();
+    }
+
+    return 0;
+}
+
+void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
+{
+    // We're called on the network receive thread, so just queue the packet
+    // for our decode thread. Lost packets are queued with no data.
+    if (s_ActiveSession->m_AudioDecodeThread == nullptr) {
+        s_ActiveSession->decodeAndPlayAudioPacket((unsigned char*)sampleData, sampleLength);
+    }
+    else if (s_ActiveSession->m_AudioPacketRing->write(sampleData, sampleData != nullptr ? sampleLength : 0)) {
+        SDL_SemPost(s_ActiveSession->m_AudioPacketsQueued);
+    }
+    else {
+        SDL_AtomicIncRef(&s_ActiveSession->m_AudioPacketsOverflowed);
+    }
+}
@@ -0,0 +1,217 @@
+#include "audiojitterbuffer.h"
+
+#include <Limelight.h>
+#include "SDL_compat.h"
+
+#include <cmath>
+
+// Arrival gaps longer than this are treated as a discontinuity in the
+// stream (like a renderer reset) rather than as network jitter.
+#define MAX_JITTER_US 500000
+
+// How quickly the buffer depth is steered towards the target. Correcting
+// 1/8th of the error per frame converges within a few hundred ms at
+// 5 ms frames without reacting to every packet.
+#define CORRECTION_DIVISOR 8
+
+AudioJitterBuffer::AudioJitterBuffer(int sampleRate, int channelCount, int samplesPerFrame, int devicePeriodSamples)
+    : m_SampleRate(sampleRate),
+      m_ChannelCount(channelCount),
+      m_SamplesPerFrame(samplesPerFrame),
+      m_DevicePeriodSamples(devicePeriodSamples),
+      m_FixedTarget(false),
+      m_LastArrivalUs(0),
+      m_JitterUs(0),
+      m_PeakLatenessUs(0),
+      m_AverageBufferedSamples(-1),
+      m_SamplesInserted(0),
+      m_SamplesRemoved(0),
+      m_BufferMeasurements(0),
+      m_TotalBufferedSamples(0)
+{
+    // Never buffer less than a frame or more than 100 ms
+    m_MinTargetSamples = samplesPerFrame;
+    m_MaxTargetSamples = SDL_max(sampleRate / 10, m_MinTargetSamples);
+    m_TargetSamples = samplesPerFrame * 2;
+
+    // Stretching a frame by more than about 5% becomes audible
+    m_MaxShiftSamples = SDL_max(samplesPerFrame / 20, 1);
+
+    m_OutputBuffer.resize((samplesPerFrame + m_MaxShiftSamples) * channelCount);
+}
+
+void AudioJitterBuffer::setFixedTargetSamples(int targetSamples)
+{
+    m_FixedTarget = true;
+    m_TargetSamples = SDL_max(targetSamples, 0);
+    m_MaxTargetSamples = SDL_max(m_MaxTargetSamples, m_TargetSamples);
+}
+
+int AudioJitterBuffer::getTargetSamples()
+{
+    return m_TargetSamples;
+}
+
+int AudioJitterBuffer::getMaxOutputSamples()
+{
+    return m_SamplesPerFrame + m_MaxShiftSamples;
+}
+
+int AudioJitterBuffer::getMaxTargetSamples()
+{
+    return m_MaxTargetSamples;
+}
+
+void AudioJitterBuffer::updateTarget(int sampleCount)
+{
+    uint64_t now = LiGetMicroseconds();
+
+    if (m_LastArrivalUs != 0 && now - m_LastArrivalUs < MAX_JITTER_US) {
+        double expectedIntervalUs = sampleCount * 1000000.0 / m_SampleRate;
+        double deviationUs = (double)(now - m_LastArrivalUs) - expectedIntervalUs;
+
+        // This is the interarrival jitter estimate from RFC 3550
+        m_JitterUs += (std::fabs(deviationUs) - m_JitterUs) / 16;
+
+        // Size the buffer for the latest packets we've seen recently, letting
+        // old peaks decay with a time constant of about 3 seconds.
+        double packetsPerSecond = (double)m_SampleRate / sampleCount;
+        m_PeakLatenessUs -= m_PeakLatenessUs / (3 * packetsPerSecond);
+        m_PeakLatenessUs = SDL_max(m_PeakLatenessUs, deviationUs);
+    }
+
+    m_LastArrivalUs = now;
+
+    if (!m_FixedTarget) {
+        int targetSamples = (int)(m_PeakLatenessUs * m_SampleRate / 1000000) + m_SamplesPerFrame;
+        m_TargetSamples = SDL_clamp(targetSamples, m_MinTargetSamples, m_MaxTargetSamples);
+    }
+}
+
+int AudioJitterBuffer::findBestShift(const float* frame, int sampleCount, int minShift, int maxShift)
+{
+    int bestShift = minShift;
+    double bestSimilarity = -2;
+
+    for (int shift = minShift; shift <= maxShift; shift++) {
+        double correlation = 0, energyA = 0, energyB = 0;
+
+        for (int i = 0; i < (sampleCount - shift) * m_ChannelCount; i++) {
+            float a = frame[i];
+            float b = frame[i + shift * m_ChannelCount];
+
+            correlation += a * b;
+            energyA += a * a;
+            energyB += b * b;
+        }
+
+        // Silence matches anything, so there's no need to keep looking
+        if (energyA == 0 || energyB == 0) {
+            return shift;
+        }
+
+        double similarity = correlation / std::sqrt(energyA * energyB);
+        if (similarity > bestSimilarity) {
+            bestSimilarity = similarity;
+            bestShift = shift;
+        }
+    }
+
+    return bestShift;
+}
+
+const float* AudioJitterBuffer::process(const float* frame, int sampleCount, int bufferedSamples, int* outputSampleCount)
+{
+    updateTarget(sampleCount);
+
+    m_TotalBufferedSamples += bufferedSamples;
+    m_BufferMeasurements++;
+
+    // The device drains a whole period at a time, so the buffer depth that
+    // a packet sees is spread evenly over a period above the target.
+    double desiredBufferedSamples = m_TargetSamples + m_DevicePeriodSamples / 2.0;
+
+    if (m_AverageBufferedSamples < 0) {
+        m_AverageBufferedSamples = bufferedSamples;
+    }
+    else {
+        m_AverageBufferedSamples += (bufferedSamples - m_AverageBufferedSamples) / 32;
+    }
+
+    *outputSampleCount = sampleCount;
+
+    // Leave it alone if we're within half a frame of our target
+    double error = m_AverageBufferedSamples - desiredBufferedSamples;
+    if (std::fabs(error) <= m_SamplesPerFrame / 2.0 || sampleCount > m_SamplesPerFrame) {
+        return frame;
+    }
+
+    int adjustment = SDL_clamp((int)(std::fabs(error) / CORRECTION_DIVISOR), 1, m_MaxShiftSamples);
+    int shift = findBestShift(frame, sampleCount,
+                              SDL_max(adjustment / 2, 1),
+                              SDL_min(adjustment + adjustment / 2, m_MaxShiftSamples));
+    if (shift * 2 >= sampleCount) {
+        return frame;
+    }
+
+    float* output = m_OutputBuffer.data();
+
+    if (error > 0) {
+        // We're buffering too much, so cross-fade from the frame to a copy of
+        // itself shifted earlier, which shortens it by the shift.
+        int overlap = sampleCount - shift;
+        for (int i = 0; i < overlap; i++) {
+            float weight = (i + 0.5f) / overlap;
+            for (int ch = 0; ch < m_ChannelCount; ch++) {
+                output[i * m_ChannelCount + ch] =
+                        frame[i * m_ChannelCount + ch] * (1 - weight) +
+                        frame[(i + shift) * m_ChannelCount + ch] * weight;
+            }
+        }
+
+        *outputSampleCount = overlap;
+        m_AverageBufferedSamples -= shift;
+        m_SamplesRemoved += shift;
+    }
+    else {
+        // We're buffering too little, so cross-fade from the frame to a copy of
+        // itself shifted later, which lengthens it by the shift.
+        int overlap = sampleCount - shift;
+        memcpy(output, frame, shift * m_ChannelCount * sizeof(float));
+        for (int i = 0; i < overlap; i++) {
+            float weight = (i + 0.5f) / overlap;
+            for (int ch = 0; ch < m_ChannelCount; ch++) {
+                output[(i + shift) * m_ChannelCount + ch] =
+                        frame[(i + shift) * m_ChannelCount + ch] * (1 - weight) +
+                        frame[i * m_ChannelCount + ch] * weight;
+            }
+        }
+        memcpy(&output[sampleCount * m_ChannelCount],
+               &frame[overlap * m_ChannelCount],
+               shift * m_ChannelCount * sizeof(float));
+
+        *outputSampleCount = sampleCount + shift;
+        m_AverageBufferedSamples += shift;
+        m_SamplesInserted += shift;
+    }
+
+    return output;
+}
+
+void AudioJitterBuffer::addStats(PAUDIO_STATS stats)
+{
+    stats->samplesInserted += m_SamplesInserted;
+    stats->samplesRemoved += m_SamplesRemoved;
+    stats->bufferMeasurements += m_BufferMeasurements;
+    stats->totalBufferedSamples += m_TotalBufferedSamples;
+
+    // These are the latest values rather than counters
+    stats->jitterUs = (uint32_t)m_JitterUs;
+    stats->targetBufferedSamples = m_TargetSamples + m_DevicePeriodSamples / 2;
+    stats->sampleRate = m_SampleRate;
+
+    m_SamplesInserted = 0;
+    m_SamplesRemoved = 0;
+    m_BufferMeasurements = 0;
+    m_TotalBufferedSamples = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "renderers/renderer.h"
+
+#include <vector>
+
+// Picks how much audio to keep buffered from the jitter in packet arrival
+// times, then holds the buffer at that depth by slightly time-stretching
+// frames as they arrive. This absorbs clock drift between the host and the
+// audio device without dropping packets (which is audible) or letting
+// latency grow without bound.
+//
+// Frames are stretched by cross-fading between the original frame and a
+// copy shifted by a few samples, with the shift chosen where the two are
+// most similar (as in WSOLA). The first and last samples of each frame are
+// unchanged, so stretched frames still join up with their neighbours.
+//
+// Only 32-bit float samples are supported. All methods must be called on
+// the thread that submits audio.
+class AudioJitterBuffer
+{
+public:
+    AudioJitterBuffer(int sampleRate, int channelCount, int samplesPerFrame, int devicePeriodSamples);
+
+    // Uses a fixed target depth instead of adapting it to the measured jitter
+    void setFixedTargetSamples(int targetSamples);
+
+    // Returns how many samples should be buffered on top of one device period
+    int getTargetSamples();
+
+    // The most samples that process() will return for a single frame
+    int getMaxOutputSamples();
+
+    // The deepest target that the jitter buffer will ever pick
+    int getMaxTargetSamples();
+
+    // Called as each frame arrives with the number of samples still waiting
+    // to be played. Returns the frame to play, which may have been stretched,
+    // and its length in samples.
+    const float* process(const float* frame, int sampleCount, int bufferedSamples, int* outputSampleCount);
+
+    // Adds (and resets) the counters for the current stats window
+    void addStats(PAUDIO_STATS stats);
+
+private:
+    void updateTarget(int sampleCount);
+
+    int findBestShift(const float* frame, int sampleCount, int minShift, int maxShift);
+
+    int m_SampleRate;
+    int m_ChannelCount;
+    int m_SamplesPerFrame;
+    int m_DevicePeriodSamples;
+    int m_MinTargetSamples;
+    int m_MaxTargetSamples;
+    int m_MaxShiftSamples;
+    bool m_FixedTarget;
+    int m_TargetSamples;
+
+    uint64_t m_LastArrivalUs;
+    double m_JitterUs;
+    double m_PeakLatenessUs;
+    double m_AverageBufferedSamples;
+
+    std::vector<float> m_OutputBuffer;
+
+    uint32_t m_SamplesInserted;
+    uint32_t m_SamplesRemoved;
+    uint32_t m_BufferMeasurements;
+    uint64_t m_TotalBufferedSamples;
+};
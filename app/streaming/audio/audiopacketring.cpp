@@ -0,0 +1,65 @@
+#include "audiopacketring.h"
+
+#include <SDL.h>
+
+AudioPacketRing::AudioPacketRing(int capacity)
+    : m_Capacity(capacity),
+      m_ReadIndex(0),
+      m_WriteIndex(0)
+{
+    SDL_assert(capacity > 0);
+
+    m_Packets = new Packet[capacity];
+}
+
+AudioPacketRing::~AudioPacketRing()
+{
+    delete[] m_Packets;
+}
+
+bool AudioPacketRing::write(const void* data, int length)
+{
+    uint64_t writeIndex = m_WriteIndex.load(std::memory_order_relaxed);
+    uint64_t readIndex = m_ReadIndex.load(std::memory_order_acquire);
+
+    SDL_assert(length >= 0);
+    if (writeIndex - readIndex >= (uint64_t)m_Capacity || length > k_MaxPacketSize) {
+        return false;
+    }
+
+    Packet& packet = m_Packets[writeIndex % m_Capacity];
+    packet.length = length;
+    if (length > 0) {
+        memcpy(packet.data, data, length);
+    }
+
+    m_WriteIndex.store(writeIndex + 1, std::memory_order_release);
+    return true;
+}
+
+const uint8_t* AudioPacketRing::peek(int* length)
+{
+    uint64_t readIndex = m_ReadIndex.load(std::memory_order_relaxed);
+    if (readIndex == m_WriteIndex.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+
+    Packet& packet = m_Packets[readIndex % m_Capacity];
+    *length = packet.length;
+    return packet.data;
+}
+
+void AudioPacketRing::pop()
+{
+    uint64_t readIndex = m_ReadIndex.load(std::memory_order_relaxed);
+
+    SDL_assert(readIndex != m_WriteIndex.load(std::memory_order_acquire));
+    m_ReadIndex.store(readIndex + 1, std::memory_order_release);
+}
+
+int AudioPacketRing::getQueuedPackets()
+{
+    // Read index first, so we never see it ahead of the write index
+    uint64_t readIndex = m_ReadIndex.load(std::memory_order_acquire);
+    return (int)(m_WriteIndex.load(std::memory_order_acquire) - readIndex);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// A bounded lock-free ring of compressed audio packets passed from the
+// network receive thread to the audio decode thread. All packet storage
+// is allocated up front, so nothing is allocated per packet.
+//
+// A packet with no data records a packet that was lost on the network.
+class AudioPacketRing
+{
+public:
+    // Audio packets are never fragmented, so they always fit in one
+    // network MTU. Anything larger than this is dropped.
+    static const int k_MaxPacketSize = 2048;
+
+    explicit AudioPacketRing(int capacity);
+
+    ~AudioPacketRing();
+
+    // Producer only. Returns false if the ring is full or the packet is too large.
+    bool write(const void* data, int length);
+
+    // Consumer only. Returns the packet at the head of the ring, or nullptr if the
+    // ring is empty. The data stays valid until the packet is released by pop().
+    const uint8_t* peek(int* length);
+
+    // Consumer only
+    void pop();
+
+    int getQueuedPackets();
+
+private:
+    struct Packet {
+        int length;
+        uint8_t data[k_MaxPacketSize];
+    };
+
+    Packet* m_Packets;
+    int m_Capacity;
+    std::atomic<uint64_t> m_ReadIndex;
+    std::atomic<uint64_t> m_WriteIndex;
+};
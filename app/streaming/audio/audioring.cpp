@@ -0,0 +1,66 @@
+#include "audioring.h"
+
+#include <SDL.h>
+
+AudioRing::AudioRing(int capacity)
+    : m_Capacity(capacity),
+      m_ReadOffset(0),
+      m_WriteOffset(0)
+{
+    SDL_assert(capacity > 0);
+
+    m_Buffer = new uint8_t[capacity];
+}
+
+AudioRing::~AudioRing()
+{
+    delete[] m_Buffer;
+}
+
+int AudioRing::getCapacity()
+{
+    return m_Capacity;
+}
+
+bool AudioRing::write(const void* data, int length)
+{
+    uint64_t writeOffset = m_WriteOffset.load(std::memory_order_relaxed);
+    uint64_t readOffset = m_ReadOffset.load(std::memory_order_acquire);
+
+    SDL_assert(length >= 0);
+    if (writeOffset - readOffset + length > (uint64_t)m_Capacity) {
+        return false;
+    }
+
+    // Copy in up to two pieces if the data wraps around the end of the buffer
+    int start = (int)(writeOffset % m_Capacity);
+    int firstLength = SDL_min(length, m_Capacity - start);
+    memcpy(m_Buffer + start, data, firstLength);
+    memcpy(m_Buffer, (const uint8_t*)data + firstLength, length - firstLength);
+
+    m_WriteOffset.store(writeOffset + length, std::memory_order_release);
+    return true;
+}
+
+int AudioRing::read(void* data, int length)
+{
+    uint64_t readOffset = m_ReadOffset.load(std::memory_order_relaxed);
+    uint64_t writeOffset = m_WriteOffset.load(std::memory_order_acquire);
+
+    length = (int)SDL_min((uint64_t)length, writeOffset - readOffset);
+
+    int start = (int)(readOffset % m_Capacity);
+    int firstLength = SDL_min(length, m_Capacity - start);
+    memcpy(data, m_Buffer + start, firstLength);
+    memcpy((uint8_t*)data + firstLength, m_Buffer, length - firstLength);
+
+    m_ReadOffset.store(readOffset + length, std::memory_order_release);
+    return length;
+}
+
+int AudioRing::getQueuedBytes()
+{
+    // Read offset first, so we never see it ahead of the write offset
+    uint64_t readOffset = m_ReadOffset.load(std::memory_order_acquire);
+    return (int)(m_WriteOffset.load(std::memory_order_acquire) - readOffset);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// A bounded lock-free ring of PCM audio passed from one producer thread
+// to one consumer thread (typically an audio device callback). Neither
+// side ever blocks, so the consumer may safely run on a real-time thread.
+//
+// Sizes and counts are in bytes, so the ring doesn't care about the
+// sample format or channel count.
+class AudioRing
+{
+public:
+    explicit AudioRing(int capacity);
+
+    ~AudioRing();
+
+    int getCapacity();
+
+    // Producer only. Writes all of the data or none of it.
+    bool write(const void* data, int length);
+
+    // Consumer only. Returns the number of bytes read, which may be
+    // less than requested if the ring doesn't have enough data.
+    int read(void* data, int length);
+
+    int getQueuedBytes();
+
+private:
+    uint8_t* m_Buffer;
+    int m_Capacity;
+    std::atomic<uint64_t> m_ReadOffset;
+    std::atomic<uint64_t> m_WriteOffset;
+};
@@ -3,6 +3,27 @@
 #include <Limelight.h>
 #include <QtGlobal>
 
+typedef struct _AUDIO_STATS {
+    uint32_t underruns;                 // renderer buffer ran dry
+    uint32_t overruns;                  // renderer buffer too full to take a frame
+    uint32_t concealedFrames;           // lost packets replaced by Opus PLC
+    uint32_t fecRecoveredFrames;        // lost packets decoded from the next packet's FEC
+    uint32_t droppedFrames;             // lost packets that weren't replaced
+    uint32_t decodedFrames;             // including concealed and FEC frames
+    uint64_t totalDecodeTimeUs;         // high-res (1us)
+    uint32_t samplesInserted;           // by time-stretching
+    uint32_t samplesRemoved;            // by time-stretching
+    uint32_t bufferMeasurements;
+    uint64_t totalBufferedSamples;      // waiting to play as each frame arrived
+    uint32_t jitterUs;                  // latest value (not accumulated)
+    uint32_t targetBufferedSamples;     // latest value (not accumulated)
+    uint32_t deviceLatencySamples;      // latest value (not accumulated)
+    int64_t totalLatencyDeltaUs;        // video minus audio pipeline latency
+    uint32_t latencyDeltaMeasurements;
+    int sampleRate;
+    uint64_t measurementStartUs;        // timestamp reference for this window
+} AUDIO_STATS, *PAUDIO_STATS;
+
 class IAudioRenderer
 {
 public:
@@ -25,6 +46,11 @@ public:
         // 5 - Surround Right
     }
 
+    virtual void addRendererStats(PAUDIO_STATS) {
+        // Called on the audio thread at the end of each stats window
+        // for renderers to add (and reset) any counters they keep.
+    }
+
     enum class AudioFormat {
         Sint16NE,  // 16-bit signed integer (native endian)
         Float32NE, // 32-bit floating point (native endian)
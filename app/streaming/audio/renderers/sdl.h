@@ -1,8 +1,12 @@
 #pragma once
 
 #include "renderer.h"
+#include "../audiojitterbuffer.h"
+#include "../audioring.h"
 #include "SDL_compat.h"
 
+#include <atomic>
+
 class SdlAudioRenderer : public IAudioRenderer
 {
 public:
@@ -18,8 +22,27 @@ public:
 
     virtual AudioFormat getAudioBufferFormat();
 
+    virtual void addRendererStats(PAUDIO_STATS stats);
+
 private:
+    static void audioCallback(void* userdata, Uint8* stream, int len);
+
     SDL_AudioDeviceID m_AudioDevice;
     void* m_AudioBuffer;
     int m_FrameSize;
+    int m_SampleFrameSize;
+    int m_DevicePeriodSamples;
+    AudioRing* m_AudioRing;
+    AudioJitterBuffer* m_JitterBuffer;
+
+    // Playback starts (and restarts after an underrun) once this much is queued
+    std::atomic<int> m_TargetQueuedBytes;
+
+    // Only touched by the audio callback
+    bool m_Buffering;
+
+    std::atomic<uint32_t> m_Underruns;
+    uint32_t m_Overruns;
+    uint32_t m_ReportedUnderruns;
+    uint32_t m_ReportedOverruns;
 };
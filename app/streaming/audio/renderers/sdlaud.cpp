@@ -1,10 +1,19 @@
 #include "sdl.h"
+#include "utils.h"
 
 #include <Limelight.h>
 
 SdlAudioRenderer::SdlAudioRenderer()
     : m_AudioDevice(0),
-      m_AudioBuffer(nullptr)
+      m_AudioBuffer(nullptr),
+      m_AudioRing(nullptr),
+      m_JitterBuffer(nullptr),
+      m_TargetQueuedBytes(0),
+      m_Buffering(true),
+      m_Underruns(0),
+      m_Overruns(0),
+      m_ReportedUnderruns(0),
+      m_ReportedOverruns(0)
 {
     SDL_assert(!SDL_WasInit(SDL_INIT_AUDIO));
 
@@ -24,17 +33,17 @@ bool SdlAudioRenderer::prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION*
     want.freq = opusConfig->sampleRate;
     want.format = AUDIO_F32SYS;
     want.channels = opusConfig->channelCount;
+    want.callback = SdlAudioRenderer::audioCallback;
+    want.userdata = this;
 
     // On PulseAudio systems, setting a value too small can cause underruns for other
     // applications sharing this output device. We impose a floor of 480 samples (10 ms)
-    // to mitigate this issue. Otherwise, we will buffer up to 3 frames of audio which
-    // is 15 ms at regular 5 ms frames and 30 ms at 10 ms frames for slow connections.
-    // The buffering helps avoid audio underruns due to network jitter.
-    want.samples = SDL_max(480, opusConfig->samplesPerFrame * 3);
+    // to mitigate this issue. Buffering for network jitter is done in our own ring
+    // rather than by SDL, so the device only needs to pull a frame at a time.
+    want.samples = SDL_max(480, opusConfig->samplesPerFrame);
 
-    m_FrameSize = opusConfig->samplesPerFrame *
-                  opusConfig->channelCount *
-                  getAudioBufferSampleSize();
+    m_SampleFrameSize = opusConfig->channelCount * getAudioBufferSampleSize();
+    m_FrameSize = opusConfig->samplesPerFrame * m_SampleFrameSize;
 
     m_AudioDevice = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
     if (m_AudioDevice == 0) {
@@ -51,6 +60,37 @@ bool SdlAudioRenderer::prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION*
         return false;
     }
 
+    m_DevicePeriodSamples = have.samples;
+    m_JitterBuffer = new AudioJitterBuffer(opusConfig->sampleRate,
+                                           opusConfig->channelCount,
+                                           opusConfig->samplesPerFrame,
+                                           m_DevicePeriodSamples);
+
+    // By default, the amount we buffer on top of what the device pulls
+    // in each callback adapts to the network jitter.
+    int targetSamples;
+    if (Utils::getEnvironmentVariableOverride("AUDIO_TARGET_SAMPLES", &targetSamples)) {
+        m_JitterBuffer->setFixedTargetSamples(targetSamples);
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Audio buffer target: %d samples (%d ms)",
+                    m_JitterBuffer->getTargetSamples(),
+                    m_JitterBuffer->getTargetSamples() * 1000 / opusConfig->sampleRate);
+    }
+    else {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Audio buffer target: adaptive (initially %d samples)",
+                    m_JitterBuffer->getTargetSamples());
+    }
+
+    m_TargetQueuedBytes = (m_DevicePeriodSamples + m_JitterBuffer->getTargetSamples()) * m_SampleFrameSize;
+
+    // Leave room for the deepest target, another device period for bursty
+    // arrivals, and the longest frame that time-stretching can produce.
+    m_AudioRing = new AudioRing((m_DevicePeriodSamples * 2 +
+                                 m_JitterBuffer->getMaxTargetSamples() +
+                                 m_JitterBuffer->getMaxOutputSamples()) * m_SampleFrameSize);
+
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                 "Desired audio buffer: %u samples (%u bytes)",
                 want.samples,
@@ -74,11 +114,19 @@ bool SdlAudioRenderer::prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION*
 SdlAudioRenderer::~SdlAudioRenderer()
 {
     if (m_AudioDevice != 0) {
-        // Stop playback
+        // Stop playback. The callback won't be invoked again after this.
         SDL_PauseAudioDevice(m_AudioDevice, 1);
         SDL_CloseAudioDevice(m_AudioDevice);
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Audio underruns: %u, overruns: %u",
+                    m_Underruns.load(),
+                    m_Overruns);
     }
 
+    delete m_JitterBuffer;
+    delete m_AudioRing;
+
     if (m_AudioBuffer != nullptr) {
         SDL_free(m_AudioBuffer);
     }
@@ -99,37 +147,71 @@ bool SdlAudioRenderer::submitAudio(int bytesWritten)
         return true;
     }
 
-    // Don't queue if there's already more than 30 ms of audio data waiting
-    // in Moonlight's audio queue.
-    if (LiGetPendingAudioDuration() > 30) {
-        return true;
+    // Our device may enter a permanent error status upon removal, so we need
+    // to recreate the audio device to pick up the new default audio device.
+    if (SDL_GetAudioDeviceStatus(m_AudioDevice) == SDL_AUDIO_STOPPED) {
+        return false;
     }
 
-    // Provide backpressure on the queue to ensure too many frames don't build up
-    // in SDL's audio queue, but don't wait forever to avoid a deadlock if the
-    // audio device fails.
-    for (int i = 0; i < 100; i++) {
-        // Our device may enter a permanent error status upon removal, so we need
-        // to recreate the audio device to pick up the new default audio device.
-        if (SDL_GetAudioDeviceStatus(m_AudioDevice) == SDL_AUDIO_STOPPED) {
-            return false;
-        }
+    int queuedBytes = m_AudioRing->getQueuedBytes();
+    int outputSamples;
+    const float* output = m_JitterBuffer->process((const float*)m_AudioBuffer,
+                                                  bytesWritten / m_SampleFrameSize,
+                                                  queuedBytes / m_SampleFrameSize,
+                                                  &outputSamples);
+
+    int targetQueuedBytes = (m_DevicePeriodSamples + m_JitterBuffer->getTargetSamples()) * m_SampleFrameSize;
+    m_TargetQueuedBytes = targetQueuedBytes;
+
+    // Time-stretching takes care of gradual drift, but if we're more than a
+    // device period past our target (like after a stall), drop the frame
+    // rather than wait for the device to catch up.
+    int outputBytes = outputSamples * m_SampleFrameSize;
+    if (queuedBytes + outputBytes > targetQueuedBytes + m_DevicePeriodSamples * m_SampleFrameSize ||
+            !m_AudioRing->write(output, outputBytes)) {
+        m_Overruns++;
+    }
 
-        // Only queue more samples where there are 10 frames or less in SDL's queue
-        if (SDL_GetQueuedAudioSize(m_AudioDevice) / m_FrameSize <= 10) {
-            break;
+    return true;
+}
+
+void SdlAudioRenderer::audioCallback(void* userdata, Uint8* stream, int len)
+{
+    auto me = (SdlAudioRenderer*)userdata;
+
+    // Play silence until we've built up our target buffer again, otherwise
+    // we'd underrun on every callback while the network catches up.
+    if (me->m_Buffering) {
+        if (me->m_AudioRing->getQueuedBytes() < me->m_TargetQueuedBytes) {
+            SDL_memset(stream, 0, len);
+            return;
         }
 
-        SDL_Delay(1);
+        me->m_Buffering = false;
     }
 
-    if (SDL_QueueAudio(m_AudioDevice, m_AudioBuffer, bytesWritten) < 0) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "Failed to queue audio sample: %s",
-                     SDL_GetError());
+    int bytesRead = me->m_AudioRing->read(stream, len);
+    if (bytesRead < len) {
+        SDL_memset(stream + bytesRead, 0, len - bytesRead);
+        me->m_Underruns++;
+        me->m_Buffering = true;
     }
+}
 
-    return true;
+void SdlAudioRenderer::addRendererStats(PAUDIO_STATS stats)
+{
+    uint32_t underruns = m_Underruns;
+
+    stats->underruns += underruns - m_ReportedUnderruns;
+    stats->overruns += m_Overruns - m_ReportedOverruns;
+    m_ReportedUnderruns = underruns;
+    m_ReportedOverruns = m_Overruns;
+
+    // SDL doesn't tell us how much the OS buffers after our callback,
+    // so this is a lower bound on the real output latency.
+    stats->deviceLatencySamples = m_DevicePeriodSamples;
+
+    m_JitterBuffer->addStats(stats);
 }
 
 IAudioRenderer::AudioFormat SdlAudioRenderer::getAudioBufferFormat()
@@ -1,4 +1,5 @@
 #include "slaud.h"
+#include "streaming/session.h"
 
 #include "SDL_compat.h"
 
@@ -101,14 +102,16 @@ bool SLAudioRenderer::submitAudio(int bytesWritten)
         return true;
     }
 
-    if (LiGetPendingAudioDuration() < m_MaxQueuedAudioMs) {
+    // Packets are queued by our audio decode thread rather than the
+    // connection library, so ask the session how far behind we are.
+    if (Session::get()->getPendingAudioDuration() < m_MaxQueuedAudioMs) {
         SLAudio_SubmitFrame(m_AudioStream);
         m_AudioBuffer = nullptr;
     }
     else {
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                     "Too many queued audio frames: %d",
-                    LiGetPendingAudioFrames());
+                    Session::get()->getPendingAudioFrames());
     }
 
     return true;
@@ -116,6 +116,11 @@ SdlInputHandler::SdlInputHandler(StreamingPreferences& prefs, int streamWidth, i
     m_SpecialKeyCombos[KeyComboQuitAndExit].scanCode = SDL_SCANCODE_E;
     m_SpecialKeyCombos[KeyComboQuitAndExit].enabled = true;
 
+    m_SpecialKeyCombos[KeyComboDumpFrameTimingTrace].keyCombo = KeyComboDumpFrameTimingTrace;
+    m_SpecialKeyCombos[KeyComboDumpFrameTimingTrace].keyCode = SDLK_t;
+    m_SpecialKeyCombos[KeyComboDumpFrameTimingTrace].scanCode = SDL_SCANCODE_T;
+    m_SpecialKeyCombos[KeyComboDumpFrameTimingTrace].enabled = true;
+
     m_OldIgnoreDevices = SDL_GetHint(SDL_HINT_GAMECONTROLLER_IGNORE_DEVICES);
     m_OldIgnoreDevicesExcept = SDL_GetHint(SDL_HINT_GAMECONTROLLER_IGNORE_DEVICES_EXCEPT);
 
@@ -153,6 +153,12 @@ void SdlInputHandler::performSpecialKeyCombo(KeyCombo combo)
         SDL_PushEvent(&quitExitEvent);
         break;
 
+    case KeyComboDumpFrameTimingTrace:
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Detected frame timing trace dump combo");
+        Session::get()->dumpFrameTimingTrace(true);
+        break;
+
     default:
         Q_UNREACHABLE();
     }
@@ -42,10 +42,15 @@
 #define SDL_CODE_GAMECONTROLLER_SET_CONTROLLER_LED 104
 #define SDL_CODE_GAMECONTROLLER_SET_ADAPTIVE_TRIGGERS 105
 
+// Most of a probe's time is spent in the GPU driver, so more
+// threads than this just contend for the same hardware.
+#define MAX_DECODER_PROBE_THREADS 4
+
 #include <openssl/rand.h>
 
 #include <QtEndian>
 #include <QCoreApplication>
+#include <QThread>
 #include <QThreadPool>
 #include <QSvgRenderer>
 #include <QPainter>
@@ -292,7 +297,8 @@ void Session::clSetAdaptiveTriggers(uint16_t controllerNumber, uint8_t eventFlag
 
 bool Session::chooseDecoder(StreamingPreferences::VideoDecoderSelection vds,
                             SDL_Window* window, int videoFormat, int width, int height,
-                            int frameRate, bool enableVsync, bool enableFramePacing, bool testOnly, IVideoDecoder*& chosenDecoder)
+                            int frameRate, bool enableVsync, bool enableFramePacing, bool testOnly, IVideoDecoder*& chosenDecoder,
+                            StreamingPreferences::PacingPolicy pacingPolicy)
 {
     DECODER_PARAMETERS params;
 
@@ -308,6 +314,7 @@ bool Session::chooseDecoder(StreamingPreferences::VideoDecoderSelection vds,
     params.window = window;
     params.enableVsync = enableVsync;
     params.enableFramePacing = enableFramePacing;
+    params.pacingPolicy = pacingPolicy;
     params.testOnly = testOnly;
     params.vds = vds;
 
@@ -367,6 +374,12 @@ int Session::drSetup(int videoFormat, int width, int height, int frameRate, void
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Video stream is %dx%dx%d (format 0x%x)",
                 width, height, frameRate, videoFormat);
 
+    // Record the stream for offline replay if requested
+    int captureEnabled;
+    if (Utils::getEnvironmentVariableOverride("DECODE_UNIT_CAPTURE", &captureEnabled) && captureEnabled != 0) {
+        s_ActiveSession->m_DecodeUnitCapture.start(videoFormat, width, height, frameRate);
+    }
+
     return 0;
 }
 
@@ -383,6 +396,9 @@ int Session::drSubmitDecodeUnit(PDECODE_UNIT du)
     if (SDL_TryLockMutex(s_ActiveSession->m_DecoderLock) == 0) {
         IVideoDecoder* decoder = s_ActiveSession->m_VideoDecoder;
         if (decoder != nullptr) {
+            // Pull decoders record decode units themselves as they dequeue them
+            s_ActiveSession->m_DecodeUnitCapture.record(du);
+
             int ret = decoder->submitDecodeUnit(du);
             SDL_UnlockMutex(s_ActiveSession->m_DecoderLock);
             return ret;
@@ -399,50 +415,226 @@ int Session::drSubmitDecodeUnit(PDECODE_UNIT du)
     }
 }
 
+bool Session::probeDecoder(StreamingPreferences::VideoDecoderSelection vds,
+                           SDL_Window* window, int videoFormat, int width, int height,
+                           int frameRate, bool useCache, bool cacheUnavailable,
+                           DecoderCapabilityCache::ProbeResult& result)
+{
+    DecoderCapabilityCache::Probe probe = { vds, videoFormat, width, height, frameRate };
+    IVideoDecoder* decoder;
+
+    if (useCache && DecoderCapabilityCache::get().lookup(probe, &result)) {
+        return result.available;
+    }
+
+    Uint32 startTime = SDL_GetTicks();
+
+    result = {};
+    if (chooseDecoder(vds, window, videoFormat, width, height, frameRate, false, false, true, decoder)) {
+        result.available = true;
+        result.hardwareAccelerated = decoder->isHardwareAccelerated();
+        result.alwaysFullScreen = decoder->isAlwaysFullScreen();
+        result.hdrSupported = decoder->isHdrSupported();
+        result.capabilities = decoder->getDecoderCapabilities();
+        result.colorspace = decoder->getDecoderColorspace();
+        result.colorRange = decoder->getDecoderColorRange();
+        result.maxResolution = decoder->getDecoderMaxResolution();
+        delete decoder;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Decoder probe for format 0x%x (%dx%dx%d, VDS %d) took %u ms: %s",
+                videoFormat, width, height, frameRate, (int)vds,
+                SDL_GetTicks() - startTime,
+                !result.available ? "unavailable" :
+                    (result.hardwareAccelerated ? "hardware" : "software"));
+
+    if (result.available || cacheUnavailable) {
+        DecoderCapabilityCache::get().store(probe, result);
+    }
+    return result.available;
+}
+
+class DecoderProbeTask : public QRunnable
+{
+public:
+    DecoderProbeTask(const DecoderCapabilityCache::Probe& probe,
+                     std::mutex& failedProbesLock,
+                     QList<DecoderCapabilityCache::Probe>& failedProbes) :
+        m_Probe(probe),
+        m_FailedProbesLock(failedProbesLock),
+        m_FailedProbes(failedProbes) {}
+
+private:
+    void run() override
+    {
+        DecoderCapabilityCache::ProbeResult result;
+        SDL_Window* window;
+
+        // Each probe needs its own window, because most renderers
+        // can't share a window with another renderer.
+        {
+            std::lock_guard lg { StreamUtils::getVideoInitLock() };
+
+            window = SDL_CreateWindow("", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                      m_Probe.width, m_Probe.height,
+                                      SDL_WINDOW_HIDDEN | StreamUtils::getPlatformWindowFlags());
+            if (!window) {
+                window = SDL_CreateWindow("", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                          m_Probe.width, m_Probe.height, SDL_WINDOW_HIDDEN);
+            }
+        }
+
+        if (!window) {
+            // The probe will be run serially later instead
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Failed to create window for decoder probe: %s",
+                        SDL_GetError());
+            addFailedProbe();
+            return;
+        }
+
+        // Other probes running at the same time may cause this one to fail
+        // (such as by exhausting decoder instances), so leave failures
+        // uncached and let the caller retry them on their own.
+        if (!Session::probeDecoder(m_Probe.vds, window, m_Probe.videoFormat,
+                                   m_Probe.width, m_Probe.height, m_Probe.frameRate,
+                                   false, false, result)) {
+            addFailedProbe();
+        }
+
+        {
+            std::lock_guard lg { StreamUtils::getVideoInitLock() };
+            SDL_DestroyWindow(window);
+        }
+    }
+
+    void addFailedProbe()
+    {
+        std::lock_guard lg { m_FailedProbesLock };
+        m_FailedProbes.append(m_Probe);
+    }
+
+    DecoderCapabilityCache::Probe m_Probe;
+    std::mutex& m_FailedProbesLock;
+    QList<DecoderCapabilityCache::Probe>& m_FailedProbes;
+};
+
+bool Session::runDecoderProbesConcurrently(const QList<DecoderCapabilityCache::Probe>& probes,
+                                           QList<DecoderCapabilityCache::Probe>& failedProbes)
+{
+#ifdef Q_OS_DARWIN
+    // AppKit requires windows to be created on the main thread
+    Q_UNUSED(probes);
+    Q_UNUSED(failedProbes);
+    return false;
+#else
+    int threadCount;
+
+    if (!Utils::getEnvironmentVariableOverride("DECODER_PROBE_THREADS", &threadCount)) {
+        threadCount = qMin(QThread::idealThreadCount(), MAX_DECODER_PROBE_THREADS);
+    }
+
+    threadCount = qMin(threadCount, (int)probes.size());
+    if (threadCount < 2) {
+        // Nothing to gain over probing serially
+        return false;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Running %d decoder probes on %d threads",
+                (int)probes.size(),
+                threadCount);
+
+    Uint32 startTime = SDL_GetTicks();
+
+    std::mutex failedProbesLock;
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    for (const DecoderCapabilityCache::Probe& probe : probes) {
+        pool.start(new DecoderProbeTask(probe, failedProbesLock, failedProbes));
+    }
+    pool.waitForDone();
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Concurrent decoder probes took %u ms (%d failed)",
+                SDL_GetTicks() - startTime,
+                (int)failedProbes.size());
+    return true;
+#endif
+}
+
+void Session::prefetchDecoderProbes(const QList<DecoderCapabilityCache::Probe>& probes)
+{
+    QList<DecoderCapabilityCache::Probe> uncachedProbes;
+    DecoderCapabilityCache::ProbeResult result;
+
+    for (const DecoderCapabilityCache::Probe& probe : probes) {
+        if (!DecoderCapabilityCache::get().lookup(probe, &result)) {
+            uncachedProbes.append(probe);
+        }
+    }
+
+    // Failed probes aren't cached, so the caller will run those
+    // serially along with everything else if this fails.
+    QList<DecoderCapabilityCache::Probe> failedProbes;
+    runDecoderProbesConcurrently(uncachedProbes, failedProbes);
+}
+
 void Session::getDecoderInfo(SDL_Window* window,
                              bool& isHardwareAccelerated, bool& isFullScreenOnly,
-                             bool& isHdrSupported, QSize& maxResolution)
+                             bool& isHdrSupported, QSize& maxResolution,
+                             bool useCache)
 {
-    IVideoDecoder* decoder;
+    DecoderCapabilityCache::ProbeResult result;
+
+    // Run every probe below at once, since we usually need several of them
+    if (useCache) {
+        prefetchDecoderProbes({
+            { StreamingPreferences::VDS_FORCE_HARDWARE, VIDEO_FORMAT_H265_MAIN10, 1920, 1080, 60 },
+            { StreamingPreferences::VDS_FORCE_HARDWARE, VIDEO_FORMAT_AV1_MAIN10, 1920, 1080, 60 },
+            { StreamingPreferences::VDS_FORCE_SOFTWARE, VIDEO_FORMAT_H265_MAIN10, 1920, 1080, 60 },
+            { StreamingPreferences::VDS_FORCE_SOFTWARE, VIDEO_FORMAT_AV1_MAIN10, 1920, 1080, 60 },
+            { StreamingPreferences::VDS_FORCE_HARDWARE, VIDEO_FORMAT_H265, 1920, 1080, 60 },
+            { StreamingPreferences::VDS_AUTO, VIDEO_FORMAT_H264, 1920, 1080, 60 },
+        });
+    }
 
     // Since AV1 support on the host side is in its infancy, let's not consider
     // _only_ a working AV1 decoder to be acceptable and still show the warning
     // dialog indicating lack of hardware decoding support.
 
     // Try an HEVC Main10 decoder first to see if we have HDR support
-    if (chooseDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
-                      window, VIDEO_FORMAT_H265_MAIN10, 1920, 1080, 60,
-                      false, false, true, decoder)) {
-        isHardwareAccelerated = decoder->isHardwareAccelerated();
-        isFullScreenOnly = decoder->isAlwaysFullScreen();
-        isHdrSupported = decoder->isHdrSupported();
-        maxResolution = decoder->getDecoderMaxResolution();
-        delete decoder;
+    if (probeDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
+                     window, VIDEO_FORMAT_H265_MAIN10, 1920, 1080, 60,
+                     useCache, true, result)) {
+        isHardwareAccelerated = result.hardwareAccelerated;
+        isFullScreenOnly = result.alwaysFullScreen;
+        isHdrSupported = result.hdrSupported;
+        maxResolution = result.maxResolution;
 
         return;
     }
 
     // Try an AV1 Main10 decoder next to see if we have HDR support
-    if (chooseDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
-                      window, VIDEO_FORMAT_AV1_MAIN10, 1920, 1080, 60,
-                      false, false, true, decoder)) {
+    if (probeDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
+                     window, VIDEO_FORMAT_AV1_MAIN10, 1920, 1080, 60,
+                     useCache, true, result)) {
         // If we've got a working AV1 Main 10-bit decoder, we'll enable the HDR checkbox
         // but we will still continue probing to get other attributes for HEVC or H.264
         // decoders. See the AV1 comment at the top of the function for more info.
-        isHdrSupported = decoder->isHdrSupported();
-        delete decoder;
+        isHdrSupported = result.hdrSupported;
     }
     else {
         // If we found no hardware decoders with HDR, check for a renderer
         // that supports HDR rendering with software decoded frames.
-        if (chooseDecoder(StreamingPreferences::VDS_FORCE_SOFTWARE,
-                          window, VIDEO_FORMAT_H265_MAIN10, 1920, 1080, 60,
-                          false, false, true, decoder) ||
-            chooseDecoder(StreamingPreferences::VDS_FORCE_SOFTWARE,
-                          window, VIDEO_FORMAT_AV1_MAIN10, 1920, 1080, 60,
-                          false, false, true, decoder)) {
-            isHdrSupported = decoder->isHdrSupported();
-            delete decoder;
+        if (probeDecoder(StreamingPreferences::VDS_FORCE_SOFTWARE,
+                         window, VIDEO_FORMAT_H265_MAIN10, 1920, 1080, 60,
+                         useCache, true, result) ||
+            probeDecoder(StreamingPreferences::VDS_FORCE_SOFTWARE,
+                         window, VIDEO_FORMAT_AV1_MAIN10, 1920, 1080, 60,
+                         useCache, true, result)) {
+            isHdrSupported = result.hdrSupported;
         }
         else {
             // We weren't compiled with an HDR-capable renderer or we don't
@@ -452,26 +644,24 @@ void Session::getDecoderInfo(SDL_Window* window,
     }
 
     // Try a regular hardware accelerated HEVC decoder now
-    if (chooseDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
-                      window, VIDEO_FORMAT_H265, 1920, 1080, 60,
-                      false, false, true, decoder)) {
-        isHardwareAccelerated = decoder->isHardwareAccelerated();
-        isFullScreenOnly = decoder->isAlwaysFullScreen();
-        maxResolution = decoder->getDecoderMaxResolution();
-        delete decoder;
+    if (probeDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
+                     window, VIDEO_FORMAT_H265, 1920, 1080, 60,
+                     useCache, true, result)) {
+        isHardwareAccelerated = result.hardwareAccelerated;
+        isFullScreenOnly = result.alwaysFullScreen;
+        maxResolution = result.maxResolution;
 
         return;
     }
 
 
 #if 0 // See AV1 comment at the top of this function
-    if (chooseDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
-                      window, VIDEO_FORMAT_AV1_MAIN8, 1920, 1080, 60,
-                      false, false, true, decoder)) {
-        isHardwareAccelerated = decoder->isHardwareAccelerated();
-        isFullScreenOnly = decoder->isAlwaysFullScreen();
-        maxResolution = decoder->getDecoderMaxResolution();
-        delete decoder;
+    if (probeDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
+                     window, VIDEO_FORMAT_AV1_MAIN8, 1920, 1080, 60,
+                     useCache, true, result)) {
+        isHardwareAccelerated = result.hardwareAccelerated;
+        isFullScreenOnly = result.alwaysFullScreen;
+        maxResolution = result.maxResolution;
 
         return;
     }
@@ -479,13 +669,12 @@ void Session::getDecoderInfo(SDL_Window* window,
 
     // If we still didn't find a hardware decoder, try H.264 now.
     // This will fall back to software decoding, so it should always work.
-    if (chooseDecoder(StreamingPreferences::VDS_AUTO,
-                      window, VIDEO_FORMAT_H264, 1920, 1080, 60,
-                      false, false, true, decoder)) {
-        isHardwareAccelerated = decoder->isHardwareAccelerated();
-        isFullScreenOnly = decoder->isAlwaysFullScreen();
-        maxResolution = decoder->getDecoderMaxResolution();
-        delete decoder;
+    if (probeDecoder(StreamingPreferences::VDS_AUTO,
+                     window, VIDEO_FORMAT_H264, 1920, 1080, 60,
+                     useCache, true, result)) {
+        isHardwareAccelerated = result.hardwareAccelerated;
+        isFullScreenOnly = result.alwaysFullScreen;
+        maxResolution = result.maxResolution;
 
         return;
     }
@@ -494,39 +683,54 @@ void Session::getDecoderInfo(SDL_Window* window,
                  "Failed to find ANY working H.264 or HEVC decoder!");
 }
 
+void Session::refreshDecoderCapabilityCache(SDL_Window* window)
+{
+    DecoderCapabilityCache::ProbeResult result;
+    QList<DecoderCapabilityCache::Probe> probes = DecoderCapabilityCache::get().getCachedProbes();
+    QList<DecoderCapabilityCache::Probe> serialProbes;
+
+    // Anything that failed alongside other probes gets retried by itself
+    // before we cache it as unavailable.
+    if (!runDecoderProbesConcurrently(probes, serialProbes)) {
+        serialProbes = probes;
+    }
+
+    for (const DecoderCapabilityCache::Probe& probe : serialProbes) {
+        probeDecoder(probe.vds, window, probe.videoFormat,
+                     probe.width, probe.height, probe.frameRate,
+                     false, true, result);
+    }
+}
+
 Session::DecoderAvailability
 Session::getDecoderAvailability(SDL_Window* window,
                                 StreamingPreferences::VideoDecoderSelection vds,
                                 int videoFormat, int width, int height, int frameRate)
 {
-    IVideoDecoder* decoder;
+    DecoderCapabilityCache::ProbeResult result;
 
-    if (!chooseDecoder(vds, window, videoFormat, width, height, frameRate, false, false, true, decoder)) {
+    if (!probeDecoder(vds, window, videoFormat, width, height, frameRate, true, true, result)) {
         return DecoderAvailability::None;
     }
 
-    bool hw = decoder->isHardwareAccelerated();
-
-    delete decoder;
-
-    return hw ? DecoderAvailability::Hardware : DecoderAvailability::Software;
+    return result.hardwareAccelerated ? DecoderAvailability::Hardware : DecoderAvailability::Software;
 }
 
 bool Session::populateDecoderProperties(SDL_Window* window)
 {
-    IVideoDecoder* decoder;
-
-    if (!chooseDecoder(m_Preferences->videoDecoderSelection,
-                       window,
-                       m_SupportedVideoFormats.first(),
-                       m_StreamConfig.width,
-                       m_StreamConfig.height,
-                       m_StreamConfig.fps,
-                       false, false, true, decoder)) {
+    DecoderCapabilityCache::ProbeResult result;
+
+    if (!probeDecoder(m_Preferences->videoDecoderSelection,
+                      window,
+                      m_SupportedVideoFormats.first(),
+                      m_StreamConfig.width,
+                      m_StreamConfig.height,
+                      m_StreamConfig.fps,
+                      true, true, result)) {
         return false;
     }
 
-    m_VideoCallbacks.capabilities = decoder->getDecoderCapabilities();
+    m_VideoCallbacks.capabilities = result.capabilities;
     if (m_VideoCallbacks.capabilities & CAPABILITY_PULL_RENDERER) {
         // It is an error to pass a push callback when in pull mode
         m_VideoCallbacks.submitDecodeUnit = nullptr;
@@ -541,7 +745,7 @@ bool Session::populateDecoderProperties(SDL_Window* window)
                     m_StreamConfig.colorSpace);
     }
     else {
-        m_StreamConfig.colorSpace = decoder->getDecoderColorspace();
+        m_StreamConfig.colorSpace = result.colorspace;
     }
 
     if (Utils::getEnvironmentVariableOverride("COLOR_RANGE_OVERRIDE", &m_StreamConfig.colorRange)) {
@@ -550,15 +754,13 @@ bool Session::populateDecoderProperties(SDL_Window* window)
                     m_StreamConfig.colorRange);
     }
     else {
-        m_StreamConfig.colorRange = decoder->getDecoderColorRange();
+        m_StreamConfig.colorRange = result.colorRange;
     }
 
-    if (decoder->isAlwaysFullScreen()) {
+    if (result.alwaysFullScreen) {
         m_IsFullScreen = true;
     }
 
-    delete decoder;
-
     return true;
 }
 
@@ -583,6 +785,13 @@ Session::Session(NvComputer* computer, NvApp& app, StreamingPreferences *prefere
       m_AudioRenderer(nullptr),
       m_AudioSampleCount(0),
       m_DropAudioEndTime(0),
+      m_AudioFrameLost(false),
+      m_AudioFecPossible(false),
+      m_ConsecutiveLostAudioFrames(0),
+      m_AudioPacketRing(nullptr),
+      m_AudioDecodeThread(nullptr),
+      m_AudioPacketsQueued(nullptr),
+      m_VideoPresentationLatencyUs(0),
       m_CloudDeckSessionStartMs(0),
       m_CloudDeckSessionDurationMs(0),
       m_CloudDeckSessionDisplayMode(CloudDeckTimerDisplayBeforeEnd),
@@ -593,6 +802,12 @@ Session::Session(NvComputer* computer, NvApp& app, StreamingPreferences *prefere
       m_CloudDeckSessionLastHourReminderIndex(0),
       m_LastCloudDeckOverlayUpdateTicks(0)
 {
+    SDL_zero(m_ActiveWndAudioStats);
+    SDL_zero(m_LastWndAudioStats);
+    SDL_zero(m_GlobalAudioStats);
+    SDL_AtomicSet(&m_AudioDecodeThreadStopping, 0);
+    SDL_AtomicSet(&m_AudioPacketsOverflowed, 0);
+    m_AudioOverlayText[0] = 0;
 }
 
 Session::~Session()
@@ -681,6 +896,9 @@ bool Session::initialize(QQuickWindow* qtWindow)
         }
     }
 
+    // Reuse decoder probes from previous launches if nothing has changed
+    DecoderCapabilityCache::get().validate();
+
     qInfo() << "Server GPU:" << m_Computer->gpuModel;
     qInfo() << "Server GFE version:" << m_Computer->gfeVersion;
 
@@ -956,6 +1174,57 @@ bool Session::initialize(QQuickWindow* qtWindow)
     }
 #endif
 
+    {
+        // Launch validation and populateDecoderProperties() may need several
+        // test decoders, so run any uncached ones concurrently now. Each extra
+        // test decoder delays the stream starting, so only include the ones
+        // that can actually be requested with the codecs we have left.
+        int serverFormats = m_SupportedVideoFormats.maskByServerCodecModes(m_Computer->serverCodecModeSupport);
+        int probeFormats = 0;
+
+        // populateDecoderProperties() probes the format we'll negotiate
+        for (int videoFormat : m_SupportedVideoFormats) {
+            if (videoFormat & serverFormats) {
+                probeFormats |= videoFormat;
+                break;
+            }
+        }
+
+        if (m_Preferences->videoCodecConfig != StreamingPreferences::VCC_AUTO) {
+            if (!m_Preferences->enableHdr && m_Preferences->videoDecoderSelection == StreamingPreferences::VDS_AUTO) {
+                // Checks for forced codecs without hardware decoding support
+                if (m_SupportedVideoFormats & serverFormats & VIDEO_FORMAT_MASK_AV1) {
+                    probeFormats |= VIDEO_FORMAT_AV1_MAIN8;
+                }
+                if ((m_SupportedVideoFormats & VIDEO_FORMAT_MASK_H265) && m_Computer->maxLumaPixelsHEVC != 0) {
+                    probeFormats |= VIDEO_FORMAT_H265;
+                }
+            }
+            else if (m_Preferences->enableHdr && m_Preferences->videoCodecConfig != StreamingPreferences::VCC_FORCE_H264) {
+                // Checks for HDR decoding support
+                probeFormats |= m_SupportedVideoFormats & serverFormats & (VIDEO_FORMAT_AV1_MAIN10 | VIDEO_FORMAT_H265_MAIN10);
+            }
+        }
+
+        // Check for H.264 hardware decoding support when it's all we have left
+        if (!(m_SupportedVideoFormats & ~VIDEO_FORMAT_MASK_H264) &&
+                m_Preferences->videoDecoderSelection == StreamingPreferences::VDS_AUTO) {
+            probeFormats |= VIDEO_FORMAT_H264;
+        }
+
+        QList<DecoderCapabilityCache::Probe> probes;
+        for (int videoFormat : m_SupportedVideoFormats) {
+            if (videoFormat & probeFormats) {
+                probes.append(DecoderCapabilityCache::Probe {
+                                  m_Preferences->videoDecoderSelection, videoFormat,
+                                  m_StreamConfig.width, m_StreamConfig.height, m_StreamConfig.fps
+                              });
+                probeFormats &= ~videoFormat;
+            }
+        }
+        prefetchDecoderProbes(probes);
+    }
+
     // Check for validation errors/warnings and emit
     // signals for them, if appropriate
     bool ret = validateLaunch(testWindow);
@@ -1750,6 +2019,27 @@ void Session::flushWindowEvents()
     SDL_PushEvent(&flushEvent);
 }
 
+void Session::dumpFrameTimingTrace(bool inBackground)
+{
+    int traceFormat;
+    FrameTimingTrace::DumpFormat format;
+
+    // FRAME_TIMING_TRACE=2 selects the compact binary format
+    if (Utils::getEnvironmentVariableOverride("FRAME_TIMING_TRACE", &traceFormat) && traceFormat == 2) {
+        format = FrameTimingTrace::DumpFormat::Binary;
+    }
+    else {
+        format = FrameTimingTrace::DumpFormat::ChromeTrace;
+    }
+
+    if (inBackground) {
+        m_FrameTimingTrace.dumpAsync(format);
+    }
+    else {
+        m_FrameTimingTrace.dump(format);
+    }
+}
+
 void Session::setShouldExit(bool quitHostApp)
 {
     // If the caller has explicitly asked us to quit the host app,
@@ -2441,7 +2731,8 @@ void Session::exec()
                                    enableVsync,
                                    enableVsync && m_Preferences->framePacing,
                                    false,
-                                   s_ActiveSession->m_VideoDecoder)) {
+                                   s_ActiveSession->m_VideoDecoder,
+                                   m_Preferences->pacingPolicy)) {
                     SDL_UnlockMutex(m_DecoderLock);
                     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                                  "Failed to recreate decoder after reset");
@@ -2565,6 +2856,15 @@ DispatchDeferredCleanup:
     m_VideoDecoder = nullptr;
     SDL_UnlockMutex(m_DecoderLock);
 
+    // Write out the frame timing trace if requested
+    int traceFormat;
+    if (Utils::getEnvironmentVariableOverride("FRAME_TIMING_TRACE", &traceFormat) && traceFormat != 0) {
+        dumpFrameTimingTrace(false);
+    }
+
+    // Finish the decode unit capture now that nothing can submit more frames
+    m_DecodeUnitCapture.stop();
+
     // Propagate state changes from the SDL window back to the Qt window
     //
     // NB: We're making a conscious decision not to propagate the maximized
@@ -9,7 +9,14 @@
 #include "input/input.h"
 #include "video/decoder.h"
 #include "audio/renderers/renderer.h"
+#include "audio/audiopacketring.h"
 #include "video/overlaymanager.h"
+#include "video/decodercapabilitycache.h"
+#include "video/decodeunitcapture.h"
+#include "video/frametimingtrace.h"
+
+#include <atomic>
+#include <mutex>
 
 class SupportedVideoFormatList : public QList<int>
 {
@@ -95,6 +102,7 @@ class Session : public QObject
 
     friend class SdlInputHandler;
     friend class DeferredSessionCleanupTask;
+    friend class DecoderProbeTask;
     friend class AsyncConnectionStartThread;
 
 public:
@@ -117,7 +125,13 @@ public:
     static
     void getDecoderInfo(SDL_Window* window,
                         bool& isHardwareAccelerated, bool& isFullScreenOnly,
-                        bool& isHdrSupported, QSize& maxResolution);
+                        bool& isHdrSupported, QSize& maxResolution,
+                        bool useCache);
+
+    // Reruns every test decoder probe in the capability cache, so
+    // changes that don't affect the cache fingerprint are picked up.
+    static
+    void refreshDecoderCapabilityCache(SDL_Window* window);
 
     static Session* get()
     {
@@ -129,6 +143,35 @@ public:
         return m_OverlayManager;
     }
 
+    FrameTimingTrace& getFrameTimingTrace()
+    {
+        return m_FrameTimingTrace;
+    }
+
+    // Writes the frame timing trace to the log directory. Dumps taken while
+    // streaming should be written in the background to avoid stalling the
+    // thread that requested them.
+    void dumpFrameTimingTrace(bool inBackground);
+
+    DecodeUnitCapture& getDecodeUnitCapture()
+    {
+        return m_DecodeUnitCapture;
+    }
+
+    // Copies the audio stats for the performance overlay. These are
+    // collected on the audio thread, so the video decoder appends them.
+    void getAudioOverlayText(char* output, int length);
+
+    // Audio packets waiting for the audio decode thread. We queue packets
+    // ourselves, so these replace LiGetPendingAudioFrames() and
+    // LiGetPendingAudioDuration() for audio renderers.
+    int getPendingAudioFrames();
+    int getPendingAudioDuration();
+
+    // Called by the video decoder with its average time from receiving a
+    // frame to presenting it, which is compared with the audio latency.
+    void setVideoPresentationLatency(uint32_t latencyUs);
+
     void flushWindowEvents();
 
     void setShouldExit(bool quitHostApp = false);
@@ -170,6 +213,24 @@ private:
 
     int getAudioRendererCapabilities(int audioConfiguration);
 
+    // Returns false if nothing was played, which includes renderer failure
+    bool decodeAudioFrame(const unsigned char* data, int length, bool decodeFec);
+
+    // Synthesizes the pending lost frame, using FEC data from the
+    // following packet if we have it or packet loss concealment if not
+    void concealLostAudioFrame(const unsigned char* nextPacket, int nextPacketLength);
+
+    void updateAudioStats();
+
+    static
+    void addAudioStats(AUDIO_STATS& src, AUDIO_STATS& dst);
+
+    static
+    void stringifyAudioStats(AUDIO_STATS& stats, char* output, int length);
+
+    static
+    void logAudioStats(AUDIO_STATS& stats, const char* title);
+
     void getWindowDimensions(int& x, int& y,
                              int& width, int& height);
 
@@ -194,6 +255,28 @@ private:
         Hardware
     };
 
+    // Failed probes are only cached if cacheUnavailable is set, since a probe
+    // may fail spuriously while other probes are running concurrently.
+    static
+    bool probeDecoder(StreamingPreferences::VideoDecoderSelection vds,
+                      SDL_Window* window, int videoFormat, int width, int height,
+                      int frameRate, bool useCache, bool cacheUnavailable,
+                      DecoderCapabilityCache::ProbeResult& result);
+
+    // Runs the probes on a pool of worker threads, each with its own test
+    // window, and stores the successful results in the capability cache.
+    // Failed probes are returned in failedProbes to be confirmed serially.
+    // Returns false without probing anything if the probes must be run
+    // serially instead.
+    static
+    bool runDecoderProbesConcurrently(const QList<DecoderCapabilityCache::Probe>& probes,
+                                      QList<DecoderCapabilityCache::Probe>& failedProbes);
+
+    // Concurrently runs any of these probes that aren't already cached,
+    // so the serial probing that follows gets its results from the cache.
+    static
+    void prefetchDecoderProbes(const QList<DecoderCapabilityCache::Probe>& probes);
+
     static
     DecoderAvailability getDecoderAvailability(SDL_Window* window,
                                                StreamingPreferences::VideoDecoderSelection vds,
@@ -204,7 +287,8 @@ private:
                        SDL_Window* window, int videoFormat, int width, int height,
                        int frameRate, bool enableVsync, bool enableFramePacing,
                        bool testOnly,
-                       IVideoDecoder*& chosenDecoder);
+                       IVideoDecoder*& chosenDecoder,
+                       StreamingPreferences::PacingPolicy pacingPolicy = StreamingPreferences::PP_SMOOTH);
 
     static
     void clStageStarting(int stage);
@@ -250,6 +334,11 @@ private:
     static
     void arDecodeAndPlaySample(char* sampleData, int sampleLength);
 
+    static
+    int audioDecodeThread(void* context);
+
+    void decodeAndPlayAudioPacket(const unsigned char* data, int length);
+
     static
     int drSetup(int videoFormat, int width, int height, int frameRate, void*, int);
 
@@ -295,8 +384,24 @@ private:
     OPUS_MULTISTREAM_CONFIGURATION m_OriginalAudioConfig;
     int m_AudioSampleCount;
     Uint32 m_DropAudioEndTime;
+    bool m_AudioFrameLost;
+    bool m_AudioFecPossible;
+    int m_ConsecutiveLostAudioFrames;
+    AudioPacketRing* m_AudioPacketRing;
+    SDL_Thread* m_AudioDecodeThread;
+    SDL_sem* m_AudioPacketsQueued;
+    SDL_atomic_t m_AudioDecodeThreadStopping;
+    SDL_atomic_t m_AudioPacketsOverflowed;
+    AUDIO_STATS m_ActiveWndAudioStats;
+    AUDIO_STATS m_LastWndAudioStats;
+    AUDIO_STATS m_GlobalAudioStats;
+    std::atomic<uint32_t> m_VideoPresentationLatencyUs;
+    std::mutex m_AudioOverlayTextLock;
+    char m_AudioOverlayText[1024];
 
     Overlay::OverlayManager m_OverlayManager;
+    FrameTimingTrace m_FrameTimingTrace;
+    DecodeUnitCapture m_DecodeUnitCapture;
     qint64 m_CloudDeckSessionStartMs;
     qint64 m_CloudDeckSessionDurationMs;
     int m_CloudDeckSessionDisplayMode;
@@ -3,6 +3,8 @@
 #include <Qt>
 #include <QDir>
 
+#include <Limelight.h>
+
 #ifdef Q_OS_DARWIN
 #include <ApplicationServices/ApplicationServices.h>
 #endif
@@ -14,6 +16,7 @@
 #ifdef Q_OS_UNIX
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include <SDL_syswm.h>
 #endif
@@ -418,6 +421,32 @@ int StreamUtils::getDrmFd(bool preferRenderNode)
     return -1;
 }
 
+bool StreamUtils::convertMonotonicTimeUs(uint64_t monotonicTimeUs, uint64_t* timeUs)
+{
+#ifdef Q_OS_UNIX
+    struct timespec ts;
+    uint64_t now = LiGetMicroseconds();
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+        return false;
+    }
+
+    // Translate the timestamp by how long ago it was, so this works
+    // regardless of which clock LiGetMicroseconds() is based on.
+    uint64_t monotonicNowUs = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (monotonicTimeUs > monotonicNowUs || monotonicNowUs - monotonicTimeUs > now) {
+        return false;
+    }
+
+    *timeUs = now - (monotonicNowUs - monotonicTimeUs);
+    return true;
+#else
+    Q_UNUSED(monotonicTimeUs);
+    Q_UNUSED(timeUs);
+    return false;
+#endif
+}
+
 extern QAtomicInt g_AsyncLoggingEnabled;
 
 void StreamUtils::enterAsyncLoggingMode()
@@ -429,3 +458,9 @@ void StreamUtils::exitAsyncLoggingMode()
 {
     g_AsyncLoggingEnabled.deref();
 }
+
+std::mutex& StreamUtils::getVideoInitLock()
+{
+    static std::mutex s_VideoInitLock;
+    return s_VideoInitLock;
+}
@@ -2,6 +2,8 @@
 
 #include "SDL_compat.h"
 
+#include <mutex>
+
 class StreamUtils
 {
 public:
@@ -32,9 +34,19 @@ public:
     static
     int getDrmFd(bool preferRenderNode);
 
+    // Converts a past CLOCK_MONOTONIC timestamp from the display
+    // driver into the LiGetMicroseconds() timebase
+    static
+    bool convertMonotonicTimeUs(uint64_t monotonicTimeUs, uint64_t* timeUs);
+
     static
     void enterAsyncLoggingMode();
 
     static
     void exitAsyncLoggingMode();
+
+    // Serializes window and renderer creation and destruction while
+    // test decoders are being probed on multiple threads at once.
+    static
+    std::mutex& getVideoInitLock();
 };
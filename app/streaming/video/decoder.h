@@ -3,6 +3,7 @@
 #include <Limelight.h>
 #include "SDL_compat.h"
 #include "settings/streamingpreferences.h"
+#include "latencyhistogram.h"
 
 #define SDL_CODE_FRAME_READY 0
 
@@ -23,6 +24,8 @@ typedef struct _VIDEO_STATS {
     uint64_t totalDecodeTimeUs;                // high-res (1us)
     uint64_t totalPacerTimeUs;                 // high-res (1us)
     uint64_t totalRenderTimeUs;                // high-res (1us)
+    uint32_t framePoolHighWaterMark;           // max frames from the frame pool in use at once
+    uint32_t framePoolMisses;                  // frames allocated because the frame pool was empty
     uint32_t lastRtt;                          // low-res from enet (1ms)
     uint32_t lastRttVariance;                  // low-res from enet (1ms)
     double totalFps;                           // high-res
@@ -31,6 +34,16 @@ typedef struct _VIDEO_STATS {
     double renderedFps;                        // high-res
     double videoMegabitsPerSec;                // current video bitrate in Mbps, not including FEC overhead
     uint64_t measurementStartUs;               // microseconds
+    uint32_t pacingDecisions;                  // V-syncs where the pacing policy picked a queue target
+    uint32_t totalPacingQueueTarget;           // sum of the pacing policy's queue targets
+    uint32_t eglImageCacheHits;                // frames that reused cached EGLImages
+    uint32_t eglImageCacheMisses;              // frames that needed new EGLImages
+    uint64_t totalReadbackTimeUs;              // hwframe to swframe readback time (1us)
+    uint32_t readbackFrames;                   // hwframes read back to swframes
+    LatencyHistogram networkLatency;           // frame reassembly time
+    LatencyHistogram decodeLatency;            // reassembly to decoder output
+    LatencyHistogram pacerLatency;             // decoder output to render start
+    LatencyHistogram renderLatency;            // render start to render end
 } VIDEO_STATS, *PVIDEO_STATS;
 
 typedef struct _DECODER_PARAMETERS {
@@ -43,6 +56,7 @@ typedef struct _DECODER_PARAMETERS {
     int frameRate;
     bool enableVsync;
     bool enableFramePacing;
+    StreamingPreferences::PacingPolicy pacingPolicy;
     bool testOnly;
 } DECODER_PARAMETERS, *PDECODER_PARAMETERS;
 
@@ -0,0 +1,314 @@
+#include "decodercapabilitycache.h"
+#include "utils.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QSysInfo>
+
+#include <SDL.h>
+
+#ifdef HAVE_FFMPEG
+extern "C" {
+#include <libavutil/avutil.h>
+}
+#endif
+
+#ifdef Q_OS_WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <dxgi.h>
+#include <wrl/client.h>
+#endif
+
+#define CACHE_GROUP "decodercapabilities"
+#define FINGERPRINT_KEY CACHE_GROUP "/fingerprint"
+#define PROBES_GROUP CACHE_GROUP "/probes"
+
+// Bump this if the meaning of any cached value changes
+#define CACHE_VERSION 1
+
+DecoderCapabilityCache& DecoderCapabilityCache::get()
+{
+    static DecoderCapabilityCache s_Cache;
+    return s_Cache;
+}
+
+DecoderCapabilityCache::DecoderCapabilityCache()
+    : m_Enabled(true),
+      m_Loaded(false)
+{
+    int enabled;
+    if (Utils::getEnvironmentVariableOverride("DECODER_CAPABILITY_CACHE", &enabled) && enabled == 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Decoder capability cache persistence is disabled");
+        m_Enabled = false;
+    }
+}
+
+QString DecoderCapabilityCache::getProbeKey(const Probe& probe)
+{
+    return QString("%1-%2-%3-%4-%5")
+            .arg((int)probe.vds)
+            .arg(probe.videoFormat)
+            .arg(probe.width)
+            .arg(probe.height)
+            .arg(probe.frameRate);
+}
+
+QString DecoderCapabilityCache::getGpuIdentity()
+{
+    QStringList identity;
+
+#if defined(Q_OS_WIN32)
+    Microsoft::WRL::ComPtr<IDXGIFactory1> factory;
+    if (SUCCEEDED(CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&factory))) {
+        Microsoft::WRL::ComPtr<IDXGIAdapter1> adapter;
+        for (UINT i = 0; factory->EnumAdapters1(i, &adapter) != DXGI_ERROR_NOT_FOUND; i++) {
+            DXGI_ADAPTER_DESC1 desc;
+            LARGE_INTEGER umdVersion = {};
+
+            if (FAILED(adapter->GetDesc1(&desc))) {
+                continue;
+            }
+
+            // This returns the user-mode driver version
+            adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &umdVersion);
+
+            identity.append(QString("%1 %2:%3:%4:%5 %6")
+                            .arg(QString::fromWCharArray(desc.Description))
+                            .arg(desc.VendorId, 0, 16)
+                            .arg(desc.DeviceId, 0, 16)
+                            .arg(desc.SubSysId, 0, 16)
+                            .arg(desc.Revision, 0, 16)
+                            .arg(umdVersion.QuadPart, 0, 16));
+        }
+    }
+#elif defined(Q_OS_LINUX)
+    // The kernel driver and PCI IDs of each GPU
+    for (const QString& card : QDir("/sys/class/drm").entryList({"card?", "card??"}, QDir::Dirs | QDir::System)) {
+        QFile uevent(QString("/sys/class/drm/%1/device/uevent").arg(card));
+        if (uevent.open(QIODevice::ReadOnly)) {
+            for (const QByteArray& line : uevent.readAll().split('\n')) {
+                if (line.startsWith("DRIVER=") || line.startsWith("PCI_ID=") || line.startsWith("OF_COMPATIBLE_0=")) {
+                    identity.append(card + ":" + QString::fromUtf8(line));
+                }
+            }
+        }
+    }
+
+    // The proprietary NVIDIA driver reports its version here
+    QFile nvidiaVersion("/proc/driver/nvidia/version");
+    if (nvidiaVersion.open(QIODevice::ReadOnly)) {
+        identity.append(QString::fromUtf8(nvidiaVersion.readLine()).trimmed());
+    }
+
+    // Mesa and VA-API driver updates can't be detected cheaply, but the
+    // background refresh will catch those. These select the user-mode driver.
+    identity.append(qEnvironmentVariable("LIBVA_DRIVER_NAME"));
+    identity.append(qEnvironmentVariable("VDPAU_DRIVER"));
+#endif
+
+    // GPU drivers on other platforms are updated with the OS
+    identity.append(QSysInfo::kernelVersion());
+    identity.append(QSysInfo::productVersion());
+
+    return identity.join('\n');
+}
+
+QString DecoderCapabilityCache::computeFingerprint()
+{
+    QStringList fingerprint;
+
+    fingerprint.append(QString("v%1").arg(CACHE_VERSION));
+
+    // Our renderers and their workarounds change between versions
+    fingerprint.append(VERSION_STR);
+
+#ifdef HAVE_FFMPEG
+    fingerprint.append(av_version_info());
+#endif
+
+    SDL_version sdlVersion;
+    SDL_GetVersion(&sdlVersion);
+    fingerprint.append(QString("SDL %1.%2.%3 %4")
+                       .arg(sdlVersion.major)
+                       .arg(sdlVersion.minor)
+                       .arg(sdlVersion.patch)
+                       .arg(SDL_GetCurrentVideoDriver()));
+
+    // Renderer selection depends on the displays (HDR, refresh rate, etc.)
+    for (int i = 0; i < SDL_GetNumVideoDisplays(); i++) {
+        SDL_DisplayMode mode;
+        const char* name = SDL_GetDisplayName(i);
+
+        if (SDL_GetDesktopDisplayMode(i, &mode) == 0) {
+            fingerprint.append(QString("%1 %2x%3x%4 %5")
+                               .arg(name != nullptr ? name : "")
+                               .arg(mode.w)
+                               .arg(mode.h)
+                               .arg(mode.refresh_rate)
+                               .arg(mode.format, 0, 16));
+        }
+    }
+
+    fingerprint.append(getGpuIdentity());
+
+    return QCryptographicHash::hash(fingerprint.join('\n').toUtf8(), QCryptographicHash::Sha256).toHex();
+}
+
+bool DecoderCapabilityCache::isSameResult(const ProbeResult& a, const ProbeResult& b)
+{
+    return a.available == b.available &&
+           a.hardwareAccelerated == b.hardwareAccelerated &&
+           a.alwaysFullScreen == b.alwaysFullScreen &&
+           a.hdrSupported == b.hdrSupported &&
+           a.capabilities == b.capabilities &&
+           a.colorspace == b.colorspace &&
+           a.colorRange == b.colorRange &&
+           a.maxResolution == b.maxResolution;
+}
+
+void DecoderCapabilityCache::load()
+{
+    QSettings settings;
+
+    m_Fingerprint = settings.value(FINGERPRINT_KEY).toString();
+    m_Entries.clear();
+
+    settings.beginGroup(PROBES_GROUP);
+    for (const QString& key : settings.childKeys()) {
+        QStringList probeValues = key.split('-');
+        QStringList resultValues = settings.value(key).toStringList();
+        if (probeValues.size() != 5 || resultValues.size() != 9) {
+            continue;
+        }
+
+        Entry entry;
+        entry.probe.vds = (StreamingPreferences::VideoDecoderSelection)probeValues[0].toInt();
+        entry.probe.videoFormat = probeValues[1].toInt();
+        entry.probe.width = probeValues[2].toInt();
+        entry.probe.height = probeValues[3].toInt();
+        entry.probe.frameRate = probeValues[4].toInt();
+        entry.result.available = resultValues[0].toInt() != 0;
+        entry.result.hardwareAccelerated = resultValues[1].toInt() != 0;
+        entry.result.alwaysFullScreen = resultValues[2].toInt() != 0;
+        entry.result.hdrSupported = resultValues[3].toInt() != 0;
+        entry.result.capabilities = resultValues[4].toInt();
+        entry.result.colorspace = resultValues[5].toInt();
+        entry.result.colorRange = resultValues[6].toInt();
+        entry.result.maxResolution = QSize(resultValues[7].toInt(), resultValues[8].toInt());
+        m_Entries.insert(key, entry);
+    }
+    settings.endGroup();
+
+    m_Loaded = true;
+}
+
+void DecoderCapabilityCache::save()
+{
+    QSettings settings;
+
+    // Rewrite the whole group so stale probes don't linger
+    settings.remove(CACHE_GROUP);
+    settings.setValue(FINGERPRINT_KEY, m_Fingerprint);
+
+    settings.beginGroup(PROBES_GROUP);
+    for (auto it = m_Entries.constBegin(); it != m_Entries.constEnd(); ++it) {
+        const ProbeResult& result = it.value().result;
+        settings.setValue(it.key(), QStringList {
+                              QString::number(result.available),
+                              QString::number(result.hardwareAccelerated),
+                              QString::number(result.alwaysFullScreen),
+                              QString::number(result.hdrSupported),
+                              QString::number(result.capabilities),
+                              QString::number(result.colorspace),
+                              QString::number(result.colorRange),
+                              QString::number(result.maxResolution.width()),
+                              QString::number(result.maxResolution.height()),
+                          });
+    }
+    settings.endGroup();
+}
+
+void DecoderCapabilityCache::validate()
+{
+    if (!m_Enabled) {
+        // Only keep results within a single launch, which still lets
+        // concurrently prefetched probes be picked up by the serial code.
+        std::lock_guard lg { m_Lock };
+        m_Entries.clear();
+        m_Loaded = true;
+        return;
+    }
+
+    QString fingerprint = computeFingerprint();
+
+    std::lock_guard lg { m_Lock };
+
+    if (!m_Loaded) {
+        load();
+    }
+
+    if (m_Fingerprint != fingerprint) {
+        if (!m_Entries.isEmpty()) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "System configuration changed. Discarding %d cached decoder probes.",
+                        (int)m_Entries.size());
+        }
+
+        m_Fingerprint = fingerprint;
+        m_Entries.clear();
+        save();
+    }
+}
+
+bool DecoderCapabilityCache::lookup(const Probe& probe, ProbeResult* result)
+{
+    std::lock_guard lg { m_Lock };
+
+    if (!m_Loaded) {
+        return false;
+    }
+
+    auto it = m_Entries.constFind(getProbeKey(probe));
+    if (it == m_Entries.constEnd()) {
+        return false;
+    }
+
+    *result = it.value().result;
+    return true;
+}
+
+void DecoderCapabilityCache::store(const Probe& probe, const ProbeResult& result)
+{
+    std::lock_guard lg { m_Lock };
+
+    if (!m_Loaded) {
+        return;
+    }
+
+    QString key = getProbeKey(probe);
+    auto it = m_Entries.find(key);
+    if (it != m_Entries.end() && isSameResult(it.value().result, result)) {
+        // Nothing changed, so avoid hitting the disk
+        return;
+    }
+
+    m_Entries.insert(key, Entry { probe, result });
+    if (m_Enabled) {
+        save();
+    }
+}
+
+QList<DecoderCapabilityCache::Probe> DecoderCapabilityCache::getCachedProbes()
+{
+    std::lock_guard lg { m_Lock };
+
+    QList<Probe> probes;
+    for (const Entry& entry : m_Entries) {
+        probes.append(entry.probe);
+    }
+    return probes;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "settings/streamingpreferences.h"
+
+#include <QList>
+#include <QMap>
+#include <QSize>
+#include <QString>
+
+#include <mutex>
+
+// Persists the results of test decoder initialization across launches.
+//
+// Creating a test decoder opens the hardware decoder and decodes a test
+// frame, which can take hundreds of milliseconds for each codec that we
+// probe. The results only change when the hardware, drivers, displays, or
+// our own decoding code changes, so we key the cache on a fingerprint of
+// those and throw everything away if it changes.
+//
+// Not every driver update changes the fingerprint, so cached probes are
+// also refreshed in the background by SystemPropertyQueryThread on each
+// launch of the app.
+//
+// Setting DECODER_CAPABILITY_CACHE=0 stops results from being persisted,
+// but they're still kept in memory until the next call to validate().
+class DecoderCapabilityCache
+{
+public:
+    struct Probe {
+        StreamingPreferences::VideoDecoderSelection vds;
+        int videoFormat;
+        int width;
+        int height;
+        int frameRate;
+    };
+
+    struct ProbeResult {
+        bool available;
+        bool hardwareAccelerated;
+        bool alwaysFullScreen;
+        bool hdrSupported;
+        int capabilities;
+        int colorspace;
+        int colorRange;
+        QSize maxResolution;
+    };
+
+    static DecoderCapabilityCache& get();
+
+    // Discards the cache if the system fingerprint no longer matches the one
+    // the cache was built with. This must be called with SDL video initialized
+    // before any lookups, since the display configuration may have changed.
+    void validate();
+
+    bool lookup(const Probe& probe, ProbeResult* result);
+
+    void store(const Probe& probe, const ProbeResult& result);
+
+    // Returns every probe that currently has a cached result
+    QList<Probe> getCachedProbes();
+
+private:
+    struct Entry {
+        Probe probe;
+        ProbeResult result;
+    };
+
+    DecoderCapabilityCache();
+
+    static QString getProbeKey(const Probe& probe);
+    static QString computeFingerprint();
+    static QString getGpuIdentity();
+    static bool isSameResult(const ProbeResult& a, const ProbeResult& b);
+
+    void load();
+    void save();
+
+    std::mutex m_Lock;
+    bool m_Enabled;
+    bool m_Loaded;
+    QString m_Fingerprint;
+    QMap<QString, Entry> m_Entries;
+};
@@ -0,0 +1,232 @@
+#include "decodeunitcapture.h"
+#include "path.h"
+
+#include <QDateTime>
+#include <QDir>
+
+// If the disk can't keep up, we drop decode units rather than buffer them
+// without bound. The replay will see these as frames lost on the network.
+#define MAX_QUEUED_BYTES (64 * 1024 * 1024)
+
+const char* DecodeUnitCapture::k_HeaderMagic = "MLDU";
+const char* DecodeUnitCapture::k_FooterMagic = "MLDX";
+const uint32_t DecodeUnitCapture::k_Version = 1;
+
+DecodeUnitCapture::DecodeUnitCapture()
+    : m_WriterThread(nullptr),
+      m_Active(false),
+      m_Stopping(false),
+      m_QueuedBytes(0),
+      m_DroppedFrames(0),
+      m_WriteFailed(false)
+{
+}
+
+DecodeUnitCapture::~DecodeUnitCapture()
+{
+    stop();
+}
+
+bool DecodeUnitCapture::start(int videoFormat, int width, int height, int frameRate)
+{
+    std::lock_guard lg { m_Lock };
+
+    // If the capture was stopped by a write error, don't start another one
+    // until the session stops this one.
+    if (m_WriterThread != nullptr) {
+        return m_Active;
+    }
+
+    QString fileName = QString("Moonlight-Capture-%1.mldu").arg(QDateTime::currentMSecsSinceEpoch());
+    m_File.setFileName(QDir(Path::getLogDir()).filePath(fileName));
+    if (!m_File.open(QIODevice::WriteOnly)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to open decode unit capture file: %s",
+                     qPrintable(m_File.errorString()));
+        return false;
+    }
+
+    DecodeUnitCaptureHeader header = {};
+    memcpy(header.magic, k_HeaderMagic, sizeof(header.magic));
+    header.version = k_Version;
+    header.videoFormat = videoFormat;
+    header.width = width;
+    header.height = height;
+    header.frameRate = frameRate;
+    m_File.write((const char*)&header, sizeof(header));
+
+    m_Stopping = false;
+    m_QueuedBytes = 0;
+    m_DroppedFrames = 0;
+    m_WriteFailed = false;
+    m_Index.clear();
+
+    m_WriterThread = SDL_CreateThread(DecodeUnitCapture::writerThread, "DUCaptureWriter", this);
+    if (m_WriterThread == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to create decode unit capture thread: %s",
+                     SDL_GetError());
+        m_File.close();
+        m_File.remove();
+        return false;
+    }
+
+    m_Active = true;
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Capturing decode units to %s",
+                qPrintable(m_File.fileName()));
+    return true;
+}
+
+void DecodeUnitCapture::record(PDECODE_UNIT du)
+{
+    DecodeUnitCaptureRecord record = {};
+    record.frameNumber = du->frameNumber;
+    record.frameType = du->frameType;
+    record.rtpTimestamp = du->rtpTimestamp;
+    record.receiveTimeUs = du->receiveTimeUs;
+    record.enqueueTimeUs = du->enqueueTimeUs;
+    record.fullLength = du->fullLength;
+    record.frameHostProcessingLatency = du->frameHostProcessingLatency;
+    for (PLENTRY entry = du->bufferList; entry != nullptr; entry = entry->next) {
+        record.bufferCount++;
+    }
+
+    {
+        // Check before copying anything, since this is called for every frame
+        std::lock_guard lg { m_Lock };
+        if (!m_Active) {
+            return;
+        }
+        else if (m_QueuedBytes + du->fullLength > MAX_QUEUED_BYTES) {
+            m_DroppedFrames++;
+            return;
+        }
+    }
+
+    QByteArray data;
+    data.reserve(sizeof(record) + record.bufferCount * sizeof(DecodeUnitCaptureBuffer) + du->fullLength);
+    data.append((const char*)&record, sizeof(record));
+    for (PLENTRY entry = du->bufferList; entry != nullptr; entry = entry->next) {
+        DecodeUnitCaptureBuffer buffer = {};
+        buffer.bufferType = entry->bufferType;
+        buffer.length = entry->length;
+        data.append((const char*)&buffer, sizeof(buffer));
+    }
+    for (PLENTRY entry = du->bufferList; entry != nullptr; entry = entry->next) {
+        data.append(entry->data, entry->length);
+    }
+
+    {
+        std::lock_guard lg { m_Lock };
+        if (!m_Active) {
+            return;
+        }
+
+        m_QueuedBytes += data.size();
+        m_Queue.push_back(std::move(data));
+    }
+    m_QueueNotEmpty.notify_one();
+}
+
+void DecodeUnitCapture::stop()
+{
+    {
+        std::lock_guard lg { m_Lock };
+        if (m_WriterThread == nullptr) {
+            return;
+        }
+
+        // Reject any further decode units
+        m_Active = false;
+        m_Stopping = true;
+    }
+    m_QueueNotEmpty.notify_all();
+
+    // Wait for the queue to be drained
+    SDL_WaitThread(m_WriterThread, nullptr);
+    m_WriterThread = nullptr;
+
+    DecodeUnitCaptureFooter footer = {};
+    footer.indexOffset = m_File.pos();
+    footer.indexCount = (uint32_t)m_Index.size();
+    memcpy(footer.magic, k_FooterMagic, sizeof(footer.magic));
+
+    m_File.write((const char*)m_Index.data(), m_Index.size() * sizeof(DecodeUnitCaptureIndexEntry));
+    m_File.write((const char*)&footer, sizeof(footer));
+    m_File.close();
+
+    if (m_WriteFailed) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Decode unit capture was stopped early by a write error");
+    }
+
+    if (m_DroppedFrames != 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Dropped %u decode units because the capture file couldn't keep up",
+                    m_DroppedFrames);
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Wrote %d decode units to %s",
+                (int)m_Index.size(),
+                qPrintable(m_File.fileName()));
+    m_Index.clear();
+}
+
+int DecodeUnitCapture::writerThread(void* context)
+{
+    auto me = (DecodeUnitCapture*)context;
+
+    for (;;) {
+        QByteArray data;
+
+        {
+            std::unique_lock lock { me->m_Lock };
+            me->m_QueueNotEmpty.wait(lock, [me] {
+                return me->m_Stopping || !me->m_Queue.empty();
+            });
+
+            if (me->m_Queue.empty()) {
+                // We're stopping and the queue is drained
+                break;
+            }
+
+            data = std::move(me->m_Queue.front());
+            me->m_Queue.pop_front();
+            me->m_QueuedBytes -= data.size();
+        }
+
+        auto record = (const DecodeUnitCaptureRecord*)data.constData();
+
+        DecodeUnitCaptureIndexEntry entry;
+        entry.offset = me->m_File.pos();
+        entry.frameNumber = record->frameNumber;
+        entry.frameType = record->frameType;
+
+        if (me->m_File.write(data) != data.size()) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Failed to write decode unit capture: %s",
+                         qPrintable(me->m_File.errorString()));
+
+            // Stop capturing, since skipping this record would leave a gap that
+            // readers walking the records can't get past. Cut off the partial
+            // record, so stop() can still finish the file with what we have.
+            {
+                std::lock_guard lg { me->m_Lock };
+                me->m_Active = false;
+                me->m_Queue.clear();
+                me->m_QueuedBytes = 0;
+            }
+            me->m_File.resize(entry.offset);
+            me->m_File.seek(entry.offset);
+            me->m_WriteFailed = true;
+            continue;
+        }
+
+        me->m_Index.push_back(entry);
+    }
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <Limelight.h>
+
+#include <QByteArray>
+#include <QFile>
+
+#include <SDL.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Writes every decode unit received from the host to a file, so a session
+// can be replayed through the decoder later with its original timing.
+//
+// The file is little-endian and laid out as follows:
+//   DecodeUnitCaptureHeader
+//   For each decode unit:
+//     DecodeUnitCaptureRecord
+//     DecodeUnitCaptureBuffer[bufferCount]
+//     Buffer data (fullLength bytes)
+//   DecodeUnitCaptureIndexEntry[indexCount]
+//   DecodeUnitCaptureFooter
+//
+// The index and footer are only written when the capture is stopped. If
+// they're missing, readers can still recover every complete record by
+// walking them from the header.
+//
+// Records are written by a worker thread, so capturing never blocks the
+// thread submitting decode units on disk I/O.
+class DecodeUnitCapture
+{
+public:
+#pragma pack(push, 1)
+    struct DecodeUnitCaptureHeader {
+        char magic[4];              // "MLDU"
+        uint32_t version;
+        uint32_t videoFormat;
+        uint32_t width;
+        uint32_t height;
+        uint32_t frameRate;
+    };
+
+    struct DecodeUnitCaptureRecord {
+        uint32_t frameNumber;
+        uint32_t frameType;
+        uint32_t rtpTimestamp;
+        uint32_t bufferCount;
+        uint64_t receiveTimeUs;
+        uint64_t enqueueTimeUs;
+        uint32_t fullLength;
+        uint16_t frameHostProcessingLatency;
+        uint16_t reserved;
+    };
+
+    struct DecodeUnitCaptureBuffer {
+        uint32_t bufferType;
+        uint32_t length;
+    };
+
+    struct DecodeUnitCaptureIndexEntry {
+        uint64_t offset;            // Offset of the DecodeUnitCaptureRecord
+        uint32_t frameNumber;
+        uint32_t frameType;
+    };
+
+    struct DecodeUnitCaptureFooter {
+        uint64_t indexOffset;
+        uint32_t indexCount;
+        char magic[4];              // "MLDX"
+    };
+#pragma pack(pop)
+
+    static const char* k_HeaderMagic;
+    static const char* k_FooterMagic;
+    static const uint32_t k_Version;
+
+    DecodeUnitCapture();
+
+    ~DecodeUnitCapture();
+
+    // Creates a new capture file in the log directory. This does nothing
+    // if a capture is already in progress, so that decode units from
+    // every connection attempt end up in a single file.
+    bool start(int videoFormat, int width, int height, int frameRate);
+
+    // Queues a copy of the decode unit to be written. This is a no-op
+    // if no capture is in progress.
+    void record(PDECODE_UNIT du);
+
+    // Writes any queued decode units and the index, then closes the file
+    void stop();
+
+private:
+    static int writerThread(void* context);
+
+    QFile m_File;
+    SDL_Thread* m_WriterThread;
+
+    std::mutex m_Lock;
+    std::condition_variable m_QueueNotEmpty;
+    std::deque<QByteArray> m_Queue;
+    bool m_Active;
+    bool m_Stopping;
+    size_t m_QueuedBytes;
+    uint32_t m_DroppedFrames;
+
+    // Only touched by the writer thread
+    std::vector<DecodeUnitCaptureIndexEntry> m_Index;
+    bool m_WriteFailed;
+};
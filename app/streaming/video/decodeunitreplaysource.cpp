@@ -0,0 +1,164 @@
+#include "decodeunitreplaysource.h"
+#include "decodeunitcapture.h"
+
+#include <QFile>
+
+#include <SDL.h>
+
+DecodeUnitReplaySource::DecodeUnitReplaySource()
+{
+}
+
+bool DecodeUnitReplaySource::open(const QString& fileName)
+{
+    DecodeUnitCapture::DecodeUnitCaptureHeader header;
+    DecodeUnitCapture::DecodeUnitCaptureFooter footer;
+
+    SDL_assert(m_Frames.empty());
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to open %s: %s",
+                     qPrintable(fileName),
+                     qPrintable(file.errorString()));
+        return false;
+    }
+
+    QByteArray capture = file.readAll();
+    if (capture.size() < (int)sizeof(header)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "%s is too small to be a decode unit capture",
+                     qPrintable(fileName));
+        return false;
+    }
+
+    memcpy(&header, capture.constData(), sizeof(header));
+    if (memcmp(header.magic, DecodeUnitCapture::k_HeaderMagic, sizeof(header.magic)) != 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "%s is not a decode unit capture",
+                     qPrintable(fileName));
+        return false;
+    }
+    else if (header.version != DecodeUnitCapture::k_Version) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unsupported decode unit capture version: %u",
+                     header.version);
+        return false;
+    }
+
+    m_VideoFormat = header.videoFormat;
+    m_Width = header.width;
+    m_Height = header.height;
+    m_FrameRate = header.frameRate;
+
+    // Use the index if the capture was stopped cleanly
+    bool indexed = false;
+    if (capture.size() >= (int)(sizeof(header) + sizeof(footer))) {
+        memcpy(&footer, capture.constData() + capture.size() - sizeof(footer), sizeof(footer));
+        if (memcmp(footer.magic, DecodeUnitCapture::k_FooterMagic, sizeof(footer.magic)) == 0 &&
+                footer.indexOffset >= sizeof(header) &&
+                footer.indexOffset + (uint64_t)footer.indexCount * sizeof(DecodeUnitCapture::DecodeUnitCaptureIndexEntry) + sizeof(footer) == (uint64_t)capture.size()) {
+            auto index = (const DecodeUnitCapture::DecodeUnitCaptureIndexEntry*)(capture.constData() + footer.indexOffset);
+
+            m_Frames.reserve(footer.indexCount);
+            for (uint32_t i = 0; i < footer.indexCount; i++) {
+                qint64 nextOffset;
+                if (!readRecord(capture, index[i].offset, footer.indexOffset, &nextOffset)) {
+                    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                                 "Corrupt decode unit capture index entry: %u",
+                                 i);
+                    m_Frames.clear();
+                    return false;
+                }
+            }
+
+            indexed = true;
+        }
+    }
+
+    // Otherwise recover every complete record in the file
+    if (!indexed) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "%s has no index (capture was interrupted?)",
+                    qPrintable(fileName));
+
+        qint64 offset = sizeof(header);
+        while (readRecord(capture, offset, capture.size(), &offset));
+    }
+
+    if (m_Frames.empty()) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "No frames found in %s",
+                     qPrintable(fileName));
+        return false;
+    }
+
+    // Replay frames with the same spacing as they were reassembled
+    uint64_t firstEnqueueTimeUs = m_Frames.front().du.enqueueTimeUs;
+    for (Frame& frame : m_Frames) {
+        frame.scheduledTimeUs = frame.du.enqueueTimeUs - SDL_min(firstEnqueueTimeUs, frame.du.enqueueTimeUs);
+    }
+
+    finishLoading();
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Loaded %d frames (%dx%dx%d format 0x%x) spanning %.2f seconds from %s",
+                (int)m_Frames.size(),
+                m_Width, m_Height, m_FrameRate, m_VideoFormat,
+                m_Frames.back().scheduledTimeUs / 1000000.0,
+                qPrintable(fileName));
+    return true;
+}
+
+bool DecodeUnitReplaySource::readRecord(const QByteArray& capture, qint64 offset, qint64 endOffset, qint64* nextOffset)
+{
+    DecodeUnitCapture::DecodeUnitCaptureRecord record;
+
+    if (offset < 0 || offset + (qint64)sizeof(record) > endOffset) {
+        return false;
+    }
+    memcpy(&record, capture.constData() + offset, sizeof(record));
+    offset += sizeof(record);
+
+    qint64 bufferTableLength = (qint64)record.bufferCount * sizeof(DecodeUnitCapture::DecodeUnitCaptureBuffer);
+    if (offset + bufferTableLength + record.fullLength > endOffset) {
+        return false;
+    }
+
+    Frame frame;
+    frame.data = capture.mid(offset + bufferTableLength, record.fullLength);
+
+    uint32_t dataOffset = 0;
+    for (uint32_t i = 0; i < record.bufferCount; i++) {
+        DecodeUnitCapture::DecodeUnitCaptureBuffer buffer;
+        memcpy(&buffer, capture.constData() + offset + i * sizeof(buffer), sizeof(buffer));
+
+        if (buffer.length > record.fullLength - dataOffset) {
+            return false;
+        }
+
+        LENTRY entry = {};
+        entry.data = frame.data.data() + dataOffset;
+        entry.length = buffer.length;
+        entry.bufferType = buffer.bufferType;
+        frame.entries.push_back(entry);
+
+        dataOffset += buffer.length;
+    }
+
+    SDL_zero(frame.du);
+    frame.du.frameNumber = record.frameNumber;
+    frame.du.frameType = record.frameType;
+    frame.du.rtpTimestamp = record.rtpTimestamp;
+    frame.du.frameHostProcessingLatency = record.frameHostProcessingLatency;
+    frame.du.fullLength = record.fullLength;
+    frame.du.receiveTimeUs = record.receiveTimeUs;
+    frame.du.enqueueTimeUs = record.enqueueTimeUs;
+    frame.reassemblyTimeUs = record.enqueueTimeUs - SDL_min(record.receiveTimeUs, record.enqueueTimeUs);
+    frame.scheduledTimeUs = 0;
+    m_Frames.push_back(std::move(frame));
+
+    *nextOffset = offset + bufferTableLength + record.fullLength;
+    return true;
+}
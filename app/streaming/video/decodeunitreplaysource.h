@@ -0,0 +1,25 @@
+#pragma once
+
+#include "offlinedecodeunitsource.h"
+
+#include <QString>
+
+// Supplies decode units from a file written by DecodeUnitCapture, so a
+// real session can be decoded again without the host or the network.
+//
+// Frames keep their original frame numbers, so frames lost before they
+// were captured show up in the decoder's stats exactly as they did live.
+class DecodeUnitReplaySource : public OfflineDecodeUnitSource
+{
+public:
+    DecodeUnitReplaySource();
+
+    // Loads the whole capture up front, so reading the file
+    // doesn't take time away from the decoder later.
+    // When paced by start(), frames are handed out with the same
+    // spacing as they were originally received from the network.
+    bool open(const QString& fileName);
+
+private:
+    bool readRecord(const QByteArray& capture, qint64 offset, qint64 endOffset, qint64* nextOffset);
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Limelight.h>
+
+// Supplies decode units to FFmpegVideoDecoder's decoder thread. While
+// streaming, these come from moonlight-common-c's frame queue, but other
+// sources allow the decoder to run without a connection to a host.
+class IDecodeUnitSource
+{
+public:
+    virtual ~IDecodeUnitSource() {}
+
+    // Blocks until a decode unit is available or wake() is called
+    virtual bool waitForNextDecodeUnit(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du) = 0;
+
+    // Returns a decode unit only if one is available immediately
+    virtual bool pollNextDecodeUnit(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du) = 0;
+
+    virtual void completeDecodeUnit(VIDEO_FRAME_HANDLE handle, int drStatus) = 0;
+
+    // Causes a blocked (or the next) waitForNextDecodeUnit() to return false
+    virtual void wake() = 0;
+
+    virtual void requestIdrFrame() = 0;
+
+    virtual bool getHdrMetadata(PSS_HDR_METADATA) {
+        // No HDR metadata by default
+        return false;
+    }
+
+    virtual bool getEstimatedRttInfo(uint32_t*, uint32_t*) {
+        // No network by default
+        return false;
+    }
+};
+
+// Decode units received from the host by moonlight-common-c
+class LiveDecodeUnitSource : public IDecodeUnitSource
+{
+public:
+    virtual bool waitForNextDecodeUnit(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du) override {
+        return LiWaitForNextVideoFrame(handle, du);
+    }
+
+    virtual bool pollNextDecodeUnit(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du) override {
+        return LiPollNextVideoFrame(handle, du);
+    }
+
+    virtual void completeDecodeUnit(VIDEO_FRAME_HANDLE handle, int drStatus) override {
+        LiCompleteVideoFrame(handle, drStatus);
+    }
+
+    virtual void wake() override {
+        LiWakeWaitForVideoFrame();
+    }
+
+    virtual void requestIdrFrame() override {
+        LiRequestIdrFrame();
+    }
+
+    virtual bool getHdrMetadata(PSS_HDR_METADATA metadata) override {
+        return LiGetHdrMetadata(metadata);
+    }
+
+    virtual bool getEstimatedRttInfo(uint32_t* estimatedRtt, uint32_t* estimatedRttVariance) override {
+        return LiGetEstimatedRttInfo(estimatedRtt, estimatedRttVariance);
+    }
+};
@@ -0,0 +1,255 @@
+#include "elementarystreamsource.h"
+
+#include <QFile>
+
+#include <SDL.h>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+ElementaryStreamSource::ElementaryStreamSource()
+    : m_CodecId(AV_CODEC_ID_NONE)
+{
+}
+
+bool ElementaryStreamSource::open(const QString& fileName, enum AVCodecID codecId)
+{
+    AVCodecParserContext* parser = nullptr;
+    AVCodecContext* parserContext = nullptr;
+    enum AVPixelFormat pixelFormat = AV_PIX_FMT_NONE;
+    const AVPixFmtDescriptor* formatDesc;
+    const uint8_t* data;
+    int remaining;
+    bool tenBit, yuv444;
+    bool ret = false;
+
+    SDL_assert(m_Frames.empty());
+    m_CodecId = codecId;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to open %s: %s",
+                     qPrintable(fileName),
+                     qPrintable(file.errorString()));
+        return false;
+    }
+
+    QByteArray stream = file.readAll();
+    int streamLength = stream.size();
+
+    // The parser may read past the end of its input
+    stream.append(QByteArray(AV_INPUT_BUFFER_PADDING_SIZE, 0));
+
+    parser = av_parser_init(codecId);
+    parserContext = avcodec_alloc_context3(nullptr);
+    if (parser == nullptr || parserContext == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to create parser for codec: %d",
+                     codecId);
+        goto Exit;
+    }
+    parserContext->codec_id = codecId;
+
+    // Split the stream into access units. The final call with no data
+    // flushes out the last access unit.
+    data = (const uint8_t*)stream.constData();
+    remaining = streamLength;
+    for (;;) {
+        uint8_t* accessUnitData;
+        int accessUnitLength;
+
+        int consumed = av_parser_parse2(parser, parserContext,
+                                        &accessUnitData, &accessUnitLength,
+                                        remaining > 0 ? data : nullptr, remaining,
+                                        AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+        if (consumed < 0) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Failed to parse %s: %d",
+                         qPrintable(fileName),
+                         consumed);
+            goto Exit;
+        }
+
+        data += consumed;
+        remaining -= consumed;
+
+        if (accessUnitLength > 0) {
+            Frame frame;
+            frame.data = QByteArray((const char*)accessUnitData, accessUnitLength);
+            SDL_zero(frame.du);
+            frame.du.frameNumber = (int)m_Frames.size() + 1;
+            frame.du.frameType = parser->key_frame == 1 ? FRAME_TYPE_IDR : FRAME_TYPE_PFRAME;
+            frame.du.fullLength = accessUnitLength;
+            frame.reassemblyTimeUs = 0;
+            frame.scheduledTimeUs = 0;
+            m_Frames.push_back(std::move(frame));
+
+            if (pixelFormat == AV_PIX_FMT_NONE && parser->format != AV_PIX_FMT_NONE) {
+                pixelFormat = (enum AVPixelFormat)parser->format;
+            }
+            if (m_Width == 0 && parser->width > 0 && parser->height > 0) {
+                m_Width = parser->width;
+                m_Height = parser->height;
+            }
+        }
+        else if (remaining == 0) {
+            // Nothing left to flush
+            break;
+        }
+    }
+
+    if (m_Frames.empty()) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "No frames found in %s",
+                     qPrintable(fileName));
+        goto Exit;
+    }
+
+    formatDesc = av_pix_fmt_desc_get(pixelFormat);
+    if (formatDesc == nullptr || m_Width == 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to determine the video format of %s",
+                     qPrintable(fileName));
+        goto Exit;
+    }
+
+    tenBit = formatDesc->comp[0].depth > 8;
+    yuv444 = formatDesc->nb_components >= 3 && formatDesc->log2_chroma_w == 0 && formatDesc->log2_chroma_h == 0;
+
+    switch (codecId) {
+    case AV_CODEC_ID_H264:
+        if (tenBit) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "10-bit H.264 is not supported");
+            goto Exit;
+        }
+        m_VideoFormat = yuv444 ? VIDEO_FORMAT_H264_HIGH8_444 : VIDEO_FORMAT_H264;
+        break;
+    case AV_CODEC_ID_HEVC:
+        if (yuv444) {
+            m_VideoFormat = tenBit ? VIDEO_FORMAT_H265_REXT10_444 : VIDEO_FORMAT_H265_REXT8_444;
+        }
+        else {
+            m_VideoFormat = tenBit ? VIDEO_FORMAT_H265_MAIN10 : VIDEO_FORMAT_H265;
+        }
+        break;
+    case AV_CODEC_ID_AV1:
+        if (yuv444) {
+            m_VideoFormat = tenBit ? VIDEO_FORMAT_AV1_HIGH10_444 : VIDEO_FORMAT_AV1_HIGH8_444;
+        }
+        else {
+            m_VideoFormat = tenBit ? VIDEO_FORMAT_AV1_MAIN10 : VIDEO_FORMAT_AV1_MAIN8;
+        }
+        break;
+    default:
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unsupported codec: %d",
+                     codecId);
+        goto Exit;
+    }
+
+    for (Frame& frame : m_Frames) {
+        splitAccessUnit(frame);
+    }
+    setFrameRate(0);
+    finishLoading();
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Loaded %d frames (%dx%d %s) from %s",
+                (int)m_Frames.size(),
+                m_Width, m_Height,
+                av_get_pix_fmt_name(pixelFormat),
+                qPrintable(fileName));
+    ret = true;
+
+Exit:
+    if (!ret) {
+        m_Frames.clear();
+    }
+    avcodec_free_context(&parserContext);
+    if (parser != nullptr) {
+        av_parser_close(parser);
+    }
+    return ret;
+}
+
+void ElementaryStreamSource::splitAccessUnit(Frame& frame)
+{
+    char* data = frame.data.data();
+    int length = frame.data.size();
+
+    // Parameter sets get their own buffers like moonlight-common-c gives us,
+    // so the decoder treats them exactly the same way (for SPS fixup).
+    int entryStart = 0;
+    int entryType = BUFFER_TYPE_PICDATA;
+    auto addEntry = [&](int end) {
+        if (end > entryStart) {
+            LENTRY entry = {};
+            entry.data = &data[entryStart];
+            entry.length = end - entryStart;
+            entry.bufferType = entryType;
+            frame.entries.push_back(entry);
+        }
+    };
+
+    if (m_CodecId == AV_CODEC_ID_H264 || m_CodecId == AV_CODEC_ID_HEVC) {
+        for (int i = 0; i + 3 < length; i++) {
+            if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) {
+                continue;
+            }
+
+            // Include the leading zero of a 4 byte start sequence
+            int nalStart = (i > 0 && data[i - 1] == 0) ? i - 1 : i;
+            uint8_t nalHeader = (uint8_t)data[i + 3];
+            int bufferType = BUFFER_TYPE_PICDATA;
+
+            if (m_CodecId == AV_CODEC_ID_H264) {
+                switch (nalHeader & 0x1F) {
+                case 7:
+                    bufferType = BUFFER_TYPE_SPS;
+                    break;
+                case 8:
+                    bufferType = BUFFER_TYPE_PPS;
+                    break;
+                }
+            }
+            else {
+                switch ((nalHeader >> 1) & 0x3F) {
+                case 32:
+                    bufferType = BUFFER_TYPE_VPS;
+                    break;
+                case 33:
+                    bufferType = BUFFER_TYPE_SPS;
+                    break;
+                case 34:
+                    bufferType = BUFFER_TYPE_PPS;
+                    break;
+                }
+            }
+
+            // Consecutive picture data NALUs share a buffer
+            if (bufferType != BUFFER_TYPE_PICDATA || entryType != BUFFER_TYPE_PICDATA) {
+                addEntry(nalStart);
+                entryStart = nalStart;
+                entryType = bufferType;
+            }
+
+            i += 3;
+        }
+    }
+
+    addEntry(length);
+}
+
+void ElementaryStreamSource::setFrameRate(int frameRate)
+{
+    m_FrameRate = frameRate;
+
+    for (size_t i = 0; i < m_Frames.size(); i++) {
+        Frame& frame = m_Frames[i];
+        frame.du.rtpTimestamp = (uint32_t)(i * 90000 / (frameRate != 0 ? frameRate : 60));
+        frame.scheduledTimeUs = frameRate != 0 ? i * 1000000 / frameRate : 0;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "offlinedecodeunitsource.h"
+
+#include <QString>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// Supplies decode units from an Annex B H.264/HEVC or low overhead AV1 OBU
+// elementary stream file, so the decoder can be run without a host.
+class ElementaryStreamSource : public OfflineDecodeUnitSource
+{
+public:
+    ElementaryStreamSource();
+
+    // Splits the whole file into access units up front, so parsing
+    // doesn't take time away from the decoder later.
+    bool open(const QString& fileName, enum AVCodecID codecId);
+
+    // Schedules the frames at the specified frame rate. Raw elementary
+    // streams have no timing of their own, so this must be called before
+    // start() if the frames are to be paced.
+    void setFrameRate(int frameRate);
+
+private:
+    void splitAccessUnit(Frame& frame);
+
+    enum AVCodecID m_CodecId;
+};
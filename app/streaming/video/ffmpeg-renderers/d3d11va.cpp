@@ -790,6 +790,7 @@ void D3D11VARenderer::renderFrame(AVFrame* frame)
     }
 
     // Present according to the decoder parameters
+    markPresentStart();
     hr = m_SwapChain->Present(0, flags);
 
     if (m_DecodeDevice == m_RenderDevice) {
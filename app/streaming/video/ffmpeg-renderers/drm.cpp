@@ -68,6 +68,10 @@ extern "C" {
 
 #include <sys/mman.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "streaming/streamutils.h"
 #include "streaming/session.h"
 
@@ -148,13 +152,16 @@ DrmRenderer::DrmRenderer(AVHWDeviceType hwDeviceType, IFFmpegRenderer *backendRe
       m_MustCloseDrmFd(false),
       m_SupportsDirectRendering(false),
       m_VideoFormat(0),
+      m_CrtcIndex(-1),
+      m_HasMonotonicVsyncTimestamps(false),
       m_OverlayCompositionSurface(nullptr),
       m_OverlayRects{},
       m_Version(nullptr),
       m_HdrOutputMetadataBlobId(0),
       m_OutputRect{},
       m_SwFrameMapper(this),
-      m_CurrentSwFrameIdx(0)
+      m_SwUploadThread(nullptr),
+      m_SwUploadThreadStopping(false)
 #ifdef HAVE_EGL
     , m_EglImageFactory(this)
 #endif
@@ -164,6 +171,19 @@ DrmRenderer::DrmRenderer(AVHWDeviceType hwDeviceType, IFFmpegRenderer *backendRe
 
 DrmRenderer::~DrmRenderer()
 {
+    // Finish any pending software frame uploads
+    if (m_SwUploadThread != nullptr) {
+        {
+            std::lock_guard lg { m_SwUploadLock };
+            m_SwUploadThreadStopping = true;
+        }
+        m_SwUploadQueueNotEmpty.notify_all();
+        SDL_WaitThread(m_SwUploadThread, nullptr);
+    }
+
+    // All frames holding our dumb buffers must be gone by now
+    SDL_assert(m_LiveSwUploads.empty());
+
     // If we have a composition surface, unmap it before disabling planes
     if (m_OverlayCompositionSurface) {
         munmap(m_OverlayCompositionSurface->pixels, (uintptr_t)m_OverlayCompositionSurface->userdata);
@@ -208,7 +228,7 @@ DrmRenderer::~DrmRenderer()
         m_PropSetter.apply();
     }
 
-    for (int i = 0; i < k_SwFrameCount; i++) {
+    for (int i = 0; i < k_MaxSwFrameCount; i++) {
         if (m_SwFrame[i].primeFd) {
             close(m_SwFrame[i].primeFd);
         }
@@ -281,6 +301,14 @@ bool DrmRenderer::prepareDecoderContextInGetFormat(AVCodecContext*, AVPixelForma
     return true;
 }
 
+void DrmRenderer::addRendererStats(PVIDEO_STATS stats)
+{
+    m_SwFrameMapper.addReadbackStats(stats);
+#ifdef HAVE_EGL
+    m_EglImageFactory.addCacheStats(stats);
+#endif
+}
+
 void DrmRenderer::prepareToRender()
 {
     // Retake DRM master if we dropped it earlier
@@ -606,6 +634,8 @@ bool DrmRenderer::initialize(PDECODER_PARAMETERS params)
         return DIRECT_RENDERING_INIT_FAILED;
     }
 
+    m_CrtcIndex = crtcIndex;
+
     if (drmSetClientCap(m_DrmFd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1)) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "Universal planes are not supported!");
@@ -908,6 +938,15 @@ bool DrmRenderer::initialize(PDECODER_PARAMETERS params)
         }
     }
 
+    {
+        // Pacer's software V-sync source can follow the display using our
+        // V-sync timestamps, but only if they're in the monotonic clock.
+        uint64_t val;
+        if (drmGetCap(m_DrmFd, DRM_CAP_TIMESTAMP_MONOTONIC, &val) == 0 && val) {
+            m_HasMonotonicVsyncTimestamps = true;
+        }
+    }
+
     // If we got this far, we can do direct rendering via the DRM FD.
     m_SupportsDirectRendering = true;
 
@@ -1004,9 +1043,34 @@ int DrmRenderer::getRendererAttributes()
     }
 #endif
 
+    // We can query the time of the last V-sync on our CRTC
+    if (m_SupportsDirectRendering && m_HasMonotonicVsyncTimestamps) {
+        attributes |= RENDERER_ATTRIBUTE_VSYNC_TIMESTAMPS;
+    }
+
     return attributes;
 }
 
+bool DrmRenderer::getLastVsyncTime(uint64_t* vsyncTimeUs)
+{
+    if (m_CrtcIndex < 0 || !m_HasMonotonicVsyncTimestamps) {
+        return false;
+    }
+
+    // A relative wait for zero V-syncs returns immediately with the
+    // timestamp of the most recent V-sync on the CRTC
+    drmVBlank vbl = {};
+    vbl.request.type = (drmVBlankSeqType)(DRM_VBLANK_RELATIVE |
+                                          ((m_CrtcIndex << DRM_VBLANK_HIGH_CRTC_SHIFT) & DRM_VBLANK_HIGH_CRTC_MASK));
+    vbl.request.sequence = 0;
+    if (drmWaitVBlank(m_DrmFd, &vbl) < 0) {
+        return false;
+    }
+
+    return StreamUtils::convertMonotonicTimeUs((uint64_t)vbl.reply.tval_sec * 1000000 + vbl.reply.tval_usec,
+                                               vsyncTimeUs);
+}
+
 void DrmRenderer::setHdrMode(bool enabled)
 {
     if (auto prop = m_Connector.property("Colorspace")) {
@@ -1071,15 +1135,272 @@ void DrmRenderer::setHdrMode(bool enabled)
     }
 }
 
-bool DrmRenderer::mapSoftwareFrame(AVFrame *frame, AVDRMFrameDescriptor *mappedFrame)
+// Dumb buffers are usually mapped write-combined, so we want to write them
+// sequentially in large chunks and keep them out of the CPU caches.
+static void copyToDumbBuffer(uint8_t* dst, const uint8_t* src, size_t length)
 {
-    bool ret = false;
-    bool freeFrame;
-    auto drmFrame = &m_SwFrame[m_CurrentSwFrameIdx];
+#ifdef __SSE2__
+    // Align the destination for streaming stores
+    size_t head = SDL_min(length, (16 - ((uintptr_t)dst & 15)) & 15);
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    length -= head;
+
+    while (length >= 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)src);
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+        _mm_stream_si128((__m128i*)dst, a);
+        _mm_stream_si128((__m128i*)(dst + 16), b);
+        _mm_stream_si128((__m128i*)(dst + 32), c);
+        _mm_stream_si128((__m128i*)(dst + 48), d);
+        dst += 64;
+        src += 64;
+        length -= 64;
+    }
+#elif defined(__aarch64__) && defined(__GNUC__)
+    // Align the destination for non-temporal pair stores
+    size_t head = SDL_min(length, (16 - ((uintptr_t)dst & 15)) & 15);
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    length -= head;
+
+    // There are no intrinsics for STNP, so this has to be done in assembly
+    while (length >= 64) {
+        __asm__ __volatile__(
+            "ldp q0, q1, [%[src]]\n"
+            "ldp q2, q3, [%[src], #32]\n"
+            "stnp q0, q1, [%[dst]]\n"
+            "stnp q2, q3, [%[dst], #32]\n"
+            :
+            : [src] "r" (src), [dst] "r" (dst)
+            : "v0", "v1", "v2", "v3", "memory");
+        dst += 64;
+        src += 64;
+        length -= 64;
+    }
+#endif
+
+    // Copy whatever is left over (or everything on other architectures)
+    memcpy(dst, src, length);
+}
 
+bool DrmRenderer::mapSoftwareFrame(AVFrame *frame, AVDRMFrameDescriptor *mappedFrame)
+{
     SDL_assert(frame->format != AV_PIX_FMT_DRM_PRIME);
     SDL_assert(!m_DrmPrimeBackend);
 
+    // If this frame was sent to the upload thread when it was decoded,
+    // we just need to wait for that copy to finish (if it hasn't already).
+    if (frame->opaque_ref != nullptr) {
+        std::unique_lock lock { m_SwUploadLock };
+        auto upload = (SwFrameUpload*)frame->opaque_ref->data;
+
+        if (m_LiveSwUploads.count(upload) != 0) {
+            m_SwUploadCompleted.wait(lock, [upload] { return upload->complete; });
+            if (!upload->success) {
+                return false;
+            }
+
+            *mappedFrame = upload->mappedFrame;
+            return true;
+        }
+    }
+
+    // Otherwise, we'll do the copy synchronously
+    int bufferIndex = acquireSwFrameBuffer();
+    if (bufferIndex < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "No free dumb buffers for software frame");
+        return false;
+    }
+
+    if (!uploadSwFrame(frame, bufferIndex, mappedFrame)) {
+        releaseSwFrameBuffer(bufferIndex);
+        return false;
+    }
+
+    // Keep the dumb buffer reserved for as long as the frame is around
+    auto upload = new SwFrameUpload { this, nullptr, bufferIndex, *mappedFrame, true, true };
+    AVBufferRef* uploadRef = av_buffer_create((uint8_t*)upload, sizeof(*upload),
+                                              freeSwFrameUpload,
+                                              frame->opaque_ref, // Chain any existing buffer
+                                              0);
+    if (uploadRef == nullptr) {
+        delete upload;
+        releaseSwFrameBuffer(bufferIndex);
+        return true;
+    }
+
+    {
+        std::lock_guard lg { m_SwUploadLock };
+        m_LiveSwUploads.insert(upload);
+    }
+    frame->opaque_ref = uploadRef;
+
+    return true;
+}
+
+void DrmRenderer::notifyFrameDecoded(AVFrame* frame)
+{
+    // Only frames that must be copied into dumb buffers need any work here
+    if (frame->format == AV_PIX_FMT_DRM_PRIME || m_DrmPrimeBackend) {
+        return;
+    }
+
+    if (m_SwUploadThread == nullptr) {
+        m_SwUploadThread = SDL_CreateThread(DrmRenderer::swUploadThread, "DrmSwUpload", this);
+        if (m_SwUploadThread == nullptr) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Unable to create software frame upload thread: %s",
+                         SDL_GetError());
+            return;
+        }
+    }
+
+    // If we're out of buffers, the frame will be copied when it's rendered
+    int bufferIndex = acquireSwFrameBuffer();
+    if (bufferIndex < 0) {
+        return;
+    }
+
+    // The upload thread takes its own reference to the frame data. This must
+    // happen before we attach the upload to opaque_ref to avoid a cycle.
+    AVFrame* uploadFrame = av_frame_clone(frame);
+    if (uploadFrame == nullptr) {
+        releaseSwFrameBuffer(bufferIndex);
+        return;
+    }
+
+    auto upload = new SwFrameUpload { this, uploadFrame, bufferIndex, {}, false, false };
+    AVBufferRef* uploadRef = av_buffer_create((uint8_t*)upload, sizeof(*upload),
+                                              freeSwFrameUpload,
+                                              frame->opaque_ref, // Chain any existing buffer
+                                              0);
+    if (uploadRef == nullptr) {
+        av_frame_free(&uploadFrame);
+        delete upload;
+        releaseSwFrameBuffer(bufferIndex);
+        return;
+    }
+
+    // The frame owns the upload (and its chained buffers) from here on
+    frame->opaque_ref = uploadRef;
+
+    AVBufferRef* workerRef = av_buffer_ref(uploadRef);
+    if (workerRef == nullptr) {
+        // The buffer stays reserved until the frame is freed, but
+        // mapSoftwareFrame() won't find this upload and will copy
+        // the frame synchronously instead.
+        av_frame_free(&upload->frame);
+        return;
+    }
+
+    {
+        std::lock_guard lg { m_SwUploadLock };
+        m_LiveSwUploads.insert(upload);
+        m_SwUploadQueue.push_back(workerRef);
+    }
+    m_SwUploadQueueNotEmpty.notify_one();
+}
+
+int DrmRenderer::swUploadThread(void* context)
+{
+    auto me = (DrmRenderer*)context;
+
+    for (;;) {
+        AVBufferRef* uploadRef;
+
+        {
+            std::unique_lock lock { me->m_SwUploadLock };
+            me->m_SwUploadQueueNotEmpty.wait(lock, [me] {
+                return me->m_SwUploadThreadStopping || !me->m_SwUploadQueue.empty();
+            });
+
+            if (me->m_SwUploadQueue.empty()) {
+                // We're stopping and the queue is drained
+                break;
+            }
+
+            uploadRef = me->m_SwUploadQueue.front();
+            me->m_SwUploadQueue.pop_front();
+        }
+
+        auto upload = (SwFrameUpload*)uploadRef->data;
+        bool success = me->uploadSwFrame(upload->frame, upload->bufferIndex, &upload->mappedFrame);
+        av_frame_free(&upload->frame);
+
+        {
+            std::lock_guard lg { me->m_SwUploadLock };
+            upload->success = success;
+            upload->complete = true;
+        }
+        me->m_SwUploadCompleted.notify_all();
+
+        // This may free the upload if the frame has already been freed
+        av_buffer_unref(&uploadRef);
+    }
+
+    return 0;
+}
+
+void DrmRenderer::freeSwFrameUpload(void* opaque, uint8_t* data)
+{
+    auto upload = (SwFrameUpload*)data;
+
+    // The frame and the upload thread are both done with the dumb buffer
+    SDL_assert(upload->frame == nullptr);
+    {
+        std::lock_guard lg { upload->renderer->m_SwUploadLock };
+        upload->renderer->m_LiveSwUploads.erase(upload);
+    }
+    upload->renderer->releaseSwFrameBuffer(upload->bufferIndex);
+    delete upload;
+
+    // Free any chained buffers
+    av_buffer_unref((AVBufferRef**)&opaque);
+}
+
+int DrmRenderer::acquireSwFrameBuffer()
+{
+    std::lock_guard lg { m_SwUploadLock };
+
+    // Prefer a buffer that's already been created
+    for (int i = 0; i < k_MaxSwFrameCount; i++) {
+        if (!m_SwFrame[i].inUse && m_SwFrame[i].handle) {
+            m_SwFrame[i].inUse = true;
+            return i;
+        }
+    }
+
+    for (int i = 0; i < k_MaxSwFrameCount; i++) {
+        if (!m_SwFrame[i].inUse) {
+            m_SwFrame[i].inUse = true;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void DrmRenderer::releaseSwFrameBuffer(int index)
+{
+    std::lock_guard lg { m_SwUploadLock };
+
+    SDL_assert(m_SwFrame[index].inUse);
+    m_SwFrame[index].inUse = false;
+}
+
+// Only the holder of the buffer at bufferIndex may call this
+bool DrmRenderer::uploadSwFrame(AVFrame* frame, int bufferIndex, AVDRMFrameDescriptor* mappedFrame)
+{
+    bool ret = false;
+    bool freeFrame;
+    auto drmFrame = &m_SwFrame[bufferIndex];
+
     // If this is a non-DRM hwframe that cannot be exported to DRM format, we must
     // use the SwFrameMapper to map it to a swframe before we can copy it to dumb buffers.
     if (frame->hw_frames_ctx != nullptr) {
@@ -1227,17 +1548,17 @@ bool DrmRenderer::mapSoftwareFrame(AVFrame *frame, AVDRMFrameDescriptor *mappedF
 
                 // Copy the plane data into the dumb buffer
                 if (frame->linesize[i] == (int)plane.pitch) {
-                    // We can do a single memcpy() if the pitch is compatible
-                    memcpy(drmFrame->mapping + plane.offset,
-                           frame->data[i],
-                           frame->linesize[i] * planeHeight);
+                    // We can do a single copy if the pitch is compatible
+                    copyToDumbBuffer(drmFrame->mapping + plane.offset,
+                                     frame->data[i],
+                                     frame->linesize[i] * planeHeight);
                 }
                 else {
                     // The pitch is incompatible, so we must copy line-by-line
                     for (int j = 0; j < planeHeight; j++) {
-                        memcpy(drmFrame->mapping + (j * plane.pitch) + plane.offset,
-                               frame->data[i] + (j * frame->linesize[i]),
-                               qMin(frame->linesize[i], (int)plane.pitch));
+                        copyToDumbBuffer(drmFrame->mapping + (j * plane.pitch) + plane.offset,
+                                         frame->data[i] + (j * frame->linesize[i]),
+                                         qMin(frame->linesize[i], (int)plane.pitch));
                     }
                 }
 
@@ -1246,10 +1567,16 @@ bool DrmRenderer::mapSoftwareFrame(AVFrame *frame, AVDRMFrameDescriptor *mappedF
                 lastPlaneSize = plane.pitch * planeHeight;
             }
         }
+
+#if defined(__SSE2__)
+        // Make sure our streaming stores are visible before the buffer is scanned out
+        _mm_sfence();
+#elif defined(__aarch64__) && defined(__GNUC__)
+        __asm__ __volatile__("dmb oshst" ::: "memory");
+#endif
     }
 
     ret = true;
-    m_CurrentSwFrameIdx = (m_CurrentSwFrameIdx + 1) % k_SwFrameCount;
 
 Exit:
     if (freeFrame) {
@@ -1413,6 +1740,9 @@ void DrmRenderer::enterOverlayCompositionMode()
 
     // Disable blending to avoid costly reads of possibly WC/UC data
     SDL_SetSurfaceBlendMode(m_OverlayCompositionSurface, SDL_BLENDMODE_NONE);
+
+    // None of the overlays have been drawn into the new composition surface yet
+    memset(m_OverlayRects, 0, sizeof(m_OverlayRects));
     return;
 
 Fail:
@@ -1425,7 +1755,7 @@ Fail:
     drmIoctl(m_DrmFd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroyBuf);
 }
 
-void DrmRenderer::blitOverlayToCompositionSurface(Overlay::OverlayType type, SDL_Surface* newSurface, SDL_Rect* overlayRect)
+void DrmRenderer::blitOverlayToCompositionSurface(Overlay::OverlayType type, SDL_Surface* newSurface, SDL_Rect* overlayRect, SDL_Rect* dirtyRect)
 {
     SDL_assert(m_OverlayCompositionSurface);
 
@@ -1433,6 +1763,30 @@ void DrmRenderer::blitOverlayToCompositionSurface(Overlay::OverlayType type, SDL
         // Disable blending of the source surface when blitting
         SDL_SetSurfaceBlendMode(newSurface, SDL_BLENDMODE_NONE);
 
+        // If the overlay hasn't moved or changed size, the rest of it is already
+        // in the composition surface, so we only need to draw the part that changed.
+        if (dirtyRect && SDL_RectEquals(overlayRect, &m_OverlayRects[type])) {
+            if (SDL_RectEmpty(dirtyRect)) {
+                return;
+            }
+
+            uint8_t* dirtyPixels = (uint8_t*)newSurface->pixels +
+                                   dirtyRect->y * newSurface->pitch +
+                                   dirtyRect->x * newSurface->format->BytesPerPixel;
+            SDL_PremultiplyAlpha(dirtyRect->w, dirtyRect->h,
+                                 newSurface->format->format, dirtyPixels, newSurface->pitch,
+                                 newSurface->format->format, dirtyPixels, newSurface->pitch);
+
+            SDL_Rect dstRect = { overlayRect->x + dirtyRect->x, overlayRect->y + dirtyRect->y,
+                                 dirtyRect->w, dirtyRect->h };
+            SDL_Rect damageRect = dstRect;
+            SDL_BlitSurface(newSurface, dirtyRect, m_OverlayCompositionSurface, &dstRect);
+
+            // Dirty the modified portion of the plane
+            m_PropSetter.damagePlane(m_OverlayPlanes[0], damageRect);
+            return;
+        }
+
         // Premultiply alpha in place, so we can blit directly into the composition surface
         // without having to read anything (which may be very costly due to UC/WC memory)
         SDL_PremultiplyAlpha(newSurface->w, newSurface->h,
@@ -1519,7 +1873,7 @@ void DrmRenderer::notifyOverlayUpdated(Overlay::OverlayType type)
         // Turn the overlay plane off when transitioning from enabled to disabled
         if (m_OverlayRects[type].w || m_OverlayRects[type].h) {
             if (m_OverlayCompositionSurface) {
-                blitOverlayToCompositionSurface(type, nullptr, nullptr);
+                blitOverlayToCompositionSurface(type, nullptr, nullptr, nullptr);
             }
             else if (m_OverlayPlanes[type].isValid()) {
                 m_PropSetter.disablePlane(m_OverlayPlanes[type]);
@@ -1531,7 +1885,8 @@ void DrmRenderer::notifyOverlayUpdated(Overlay::OverlayType type)
     }
 
     // Upload a new overlay surface if needed
-    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type);
+    SDL_Rect dirtyRect;
+    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type, &dirtyRect);
     if (newSurface != nullptr) {
         uint32_t dumbBuffer, fbId;
         SDL_Rect overlayRect;
@@ -1556,14 +1911,17 @@ void DrmRenderer::notifyOverlayUpdated(Overlay::OverlayType type)
         overlayRect.h = newSurface->h;
 
         // Try to let the display controller composite for us
+        bool overlayRectChanged = !SDL_RectEquals(&m_OverlayRects[type], &overlayRect);
         if (!m_OverlayCompositionSurface) {
+            // Each update needs a new FB since the current one may be on screen,
+            // so the whole surface is copied here.
             if (!uploadSurfaceToFb(newSurface, &dumbBuffer, &fbId)) {
                 SDL_FreeSurface(newSurface);
                 return;
             }
 
             // If we changed our overlay rect, we need to reconfigure the plane
-            if (memcmp(&m_OverlayRects[type], &overlayRect, sizeof(overlayRect)) != 0) {
+            if (overlayRectChanged) {
                 if (m_PropSetter.testPlane(m_OverlayPlanes[type], m_Crtc.objectId(), fbId,
                                            overlayRect.x, overlayRect.y, overlayRect.w, overlayRect.h,
                                            0, 0,
@@ -1591,7 +1949,7 @@ void DrmRenderer::notifyOverlayUpdated(Overlay::OverlayType type)
 
         // If we're in overlay composition mode, blit this overlay into the composition surface
         if (m_OverlayCompositionSurface) {
-            blitOverlayToCompositionSurface(type, newSurface, &overlayRect);
+            blitOverlayToCompositionSurface(type, newSurface, &overlayRect, &dirtyRect);
         }
         else {
             // Otherwise queue the plane flip with the new FB
@@ -1599,6 +1957,12 @@ void DrmRenderer::notifyOverlayUpdated(Overlay::OverlayType type)
             // NB: This takes ownership of the FB and dumb buffer, even on failure
             m_PropSetter.flipPlane(m_OverlayCompositionSurface ? m_OverlayPlanes[0] : m_OverlayPlanes[type],
                                    fbId, dumbBuffer);
+
+            // The new FB only differs from the old one in the dirty area, so the
+            // display controller doesn't need to fetch the rest of it again.
+            if (!overlayRectChanged && !SDL_RectEmpty(&dirtyRect)) {
+                m_PropSetter.damagePlane(m_OverlayPlanes[type], dirtyRect);
+            }
         }
 
         memcpy(&m_OverlayRects[type], &overlayRect, sizeof(overlayRect));
@@ -1868,6 +2232,7 @@ void DrmRenderer::renderFrame(AVFrame* frame)
     m_PropSetter.flipPlane(m_VideoPlane, fbId, 0);
 
     // Apply pending atomic transaction (if in atomic mode)
+    markPresentStart();
     m_PropSetter.apply();
 }
 
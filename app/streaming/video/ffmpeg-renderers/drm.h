@@ -2,6 +2,7 @@
 
 #include "renderer.h"
 #include "swframemapper.h"
+#include "pacer/pacer.h"
 
 #ifdef HAVE_EGL
 #include "eglimagefactory.h"
@@ -13,6 +14,8 @@
 #include <set>
 #include <unordered_map>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
 
 // This is only defined in Linux 6.8+ headers
 #ifndef DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP
@@ -704,6 +707,7 @@ public:
     virtual bool prepareDecoderContext(AVCodecContext* context, AVDictionary** options) override;
     virtual bool prepareDecoderContextInGetFormat(AVCodecContext*, AVPixelFormat) override;
     virtual void prepareToRender() override;
+    virtual void notifyFrameDecoded(AVFrame* frame) override;
     virtual void renderFrame(AVFrame* frame) override;
     virtual enum AVPixelFormat getPreferredPixelFormat(int videoFormat) override;
     virtual bool isPixelFormatSupported(int videoFormat, AVPixelFormat pixelFormat) override;
@@ -713,6 +717,8 @@ public:
     virtual int getDecoderColorspace() override;
     virtual void setHdrMode(bool enabled) override;
     virtual void notifyOverlayUpdated(Overlay::OverlayType type) override;
+    virtual void addRendererStats(PVIDEO_STATS stats) override;
+    virtual bool getLastVsyncTime(uint64_t* vsyncTimeUs) override;
 #ifdef HAVE_EGL
     virtual bool canExportEGL() override;
     virtual AVPixelFormat getEGLImagePixelFormat() override;
@@ -724,12 +730,17 @@ private:
     const char* getDrmColorEncodingValue(AVFrame* frame);
     const char* getDrmColorRangeValue(AVFrame* frame);
     bool mapSoftwareFrame(AVFrame* frame, AVDRMFrameDescriptor* mappedFrame);
+    int acquireSwFrameBuffer();
+    void releaseSwFrameBuffer(int index);
+    bool uploadSwFrame(AVFrame* frame, int bufferIndex, AVDRMFrameDescriptor* mappedFrame);
+    static int swUploadThread(void* context);
+    static void freeSwFrameUpload(void* opaque, uint8_t* data);
     bool addFbForFrame(AVFrame* frame, uint32_t* newFbId, bool testMode);
     bool uploadSurfaceToFb(SDL_Surface *surface, uint32_t* handle, uint32_t* fbId);
     bool mapDumbBuffer(uint32_t handle, size_t size, void** mapping);
     bool createFbForDumbBuffer(struct drm_mode_create_dumb* createBuf, uint32_t* fbId);
     void enterOverlayCompositionMode();
-    void blitOverlayToCompositionSurface(Overlay::OverlayType type, SDL_Surface* newSurface, SDL_Rect* overlayRect);
+    void blitOverlayToCompositionSurface(Overlay::OverlayType type, SDL_Surface* newSurface, SDL_Rect* overlayRect, SDL_Rect* dirtyRect);
     static bool drmFormatMatchesVideoFormat(uint32_t drmFormat, int videoFormat);
 
     IFFmpegRenderer* m_BackendRenderer;
@@ -748,6 +759,8 @@ private:
     DrmPropertyMap m_Encoder;
     DrmPropertyMap m_Connector;
     DrmPropertyMap m_Crtc;
+    int m_CrtcIndex;
+    bool m_HasMonotonicVsyncTimestamps;
     std::unordered_map<uint32_t, DrmPropertyMap> m_UnusedActivePlanes;
     DrmPropertyMap m_VideoPlane;
     uint64_t m_VideoPlaneZpos;
@@ -761,9 +774,11 @@ private:
     SDL_Rect m_OutputRect;
     std::set<uint32_t> m_SupportedVideoPlaneFormats;
 
-    static constexpr int k_SwFrameCount = 2;
+    // Each software frame holds its dumb buffer until Pacer frees the frame,
+    // which isn't until after the following frame is on screen. Buffers are
+    // created on demand, so we only allocate as many as Pacer keeps in flight.
+    static constexpr int k_MaxSwFrameCount = PACER_MAX_OUTSTANDING_FRAMES + 1;
     SwFrameMapper m_SwFrameMapper;
-    int m_CurrentSwFrameIdx;
     struct {
         int width;
         int height;
@@ -774,7 +789,29 @@ private:
         uint64_t size;
         uint8_t* mapping;
         int primeFd;
-    } m_SwFrame[k_SwFrameCount];
+
+        bool inUse;
+    } m_SwFrame[k_MaxSwFrameCount];
+
+    // Software frames are copied into dumb buffers on a worker thread as
+    // soon as they're decoded, so the copy is usually done before the frame
+    // is due to be rendered. An SwFrameUpload is attached to each frame's
+    // opaque_ref and releases the dumb buffer when the frame is freed.
+    struct SwFrameUpload {
+        DrmRenderer* renderer;
+        AVFrame* frame; // Held by the worker until the copy is complete
+        int bufferIndex;
+        AVDRMFrameDescriptor mappedFrame;
+        bool complete;
+        bool success;
+    };
+    std::mutex m_SwUploadLock;
+    std::condition_variable m_SwUploadQueueNotEmpty;
+    std::condition_variable m_SwUploadCompleted;
+    std::deque<AVBufferRef*> m_SwUploadQueue;
+    std::set<SwFrameUpload*> m_LiveSwUploads;
+    SDL_Thread* m_SwUploadThread;
+    bool m_SwUploadThreadStopping;
 
 #ifdef HAVE_EGL
     EglImageFactory m_EglImageFactory;
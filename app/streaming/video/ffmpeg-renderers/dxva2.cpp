@@ -1015,6 +1015,7 @@ void DXVA2Renderer::renderFrame(AVFrame *frame)
         return;
     }
 
+    markPresentStart();
     do {
         // Use D3DPRESENT_DONOTWAIT if present may block in order to avoid holding the giant
         // lock around this D3D device for excessive lengths of time (blocking concurrent decoding tasks).
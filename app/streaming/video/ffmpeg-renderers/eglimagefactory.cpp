@@ -7,6 +7,16 @@
 
 #include <vector>
 
+#ifdef HAVE_DRM
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Decoder surface pools are small, but cap the cache in case
+// we're handed frames from somewhere that doesn't reuse them.
+#define MAX_CACHED_IMAGE_SETS 64
+
 // Don't take a dependency on libdrm just for these constants
 #ifndef DRM_FORMAT_MOD_INVALID
 #define DRM_FORMAT_MOD_INVALID ((1ULL << 56) - 1)
@@ -32,8 +42,20 @@ EglImageFactory::EglImageFactory(IFFmpegRenderer* renderer) :
     m_eglCreateImageKHR(nullptr),
     m_eglDestroyImageKHR(nullptr),
     m_eglQueryDmaBufFormatsEXT(nullptr),
-    m_eglQueryDmaBufModifiersEXT(nullptr)
+    m_eglQueryDmaBufModifiersEXT(nullptr),
+#ifdef HAVE_DRM
+    m_DmaBufInodesUnique(-1),
+#endif
+    m_ImageCacheLock(SDL_CreateMutex()),
+    m_ImageCacheHits(0),
+    m_ImageCacheMisses(0)
+{
+}
+
+EglImageFactory::~EglImageFactory()
 {
+    resetCache();
+    SDL_DestroyMutex(m_ImageCacheLock);
 }
 
 bool EglImageFactory::initializeEGL(EGLDisplay,
@@ -69,10 +91,127 @@ bool EglImageFactory::initializeEGL(EGLDisplay,
 
 void EglImageFactory::resetCache()
 {
+    SDL_LockMutex(m_ImageCacheLock);
+
+    // Frames still in flight hold their own references,
+    // so their EGLImages stay alive until they're freed.
+    for (CachedImages& entry : m_ImageCache) {
+        av_buffer_unref(&entry.imagesRef);
+    }
+    m_ImageCache.clear();
+
+    SDL_UnlockMutex(m_ImageCacheLock);
+}
+
+void EglImageFactory::addCacheStats(PVIDEO_STATS stats)
+{
+    stats->eglImageCacheHits += m_ImageCacheHits.exchange(0);
+    stats->eglImageCacheMisses += m_ImageCacheMisses.exchange(0);
+}
+
+AVBufferRef* EglImageFactory::lookupCachedImages(const std::vector<uint64_t>& key)
+{
+    AVBufferRef* imagesRef = nullptr;
+
+    SDL_LockMutex(m_ImageCacheLock);
+    for (const CachedImages& entry : m_ImageCache) {
+        if (entry.key == key) {
+            imagesRef = av_buffer_ref(entry.imagesRef);
+            break;
+        }
+    }
+    SDL_UnlockMutex(m_ImageCacheLock);
+
+    if (imagesRef != nullptr) {
+        m_ImageCacheHits++;
+    }
+
+    return imagesRef;
+}
+
+AVBufferRef* EglImageFactory::cacheImages(std::vector<uint64_t>&& key, EglImageContext* imgCtx)
+{
+    AVBufferRef* imagesRef = av_buffer_create((uint8_t*)imgCtx, sizeof(*imgCtx),
+                                              freeEglImageContextBuffer,
+                                              nullptr,
+                                              AV_BUFFER_FLAG_READONLY);
+    if (imagesRef == nullptr) {
+        delete imgCtx;
+        return nullptr;
+    }
+
+    m_ImageCacheMisses++;
+
+    // Without a key, the images just live as long as the frame
+    if (key.empty()) {
+        return imagesRef;
+    }
+
+    CachedImages entry;
+    entry.key = std::move(key);
+    entry.imagesRef = av_buffer_ref(imagesRef);
+    if (entry.imagesRef == nullptr) {
+        return imagesRef;
+    }
+
+    SDL_LockMutex(m_ImageCacheLock);
+    if (m_ImageCache.size() >= MAX_CACHED_IMAGE_SETS) {
+        av_buffer_unref(&m_ImageCache.front().imagesRef);
+        m_ImageCache.erase(m_ImageCache.begin());
+    }
+    m_ImageCache.push_back(std::move(entry));
+    SDL_UnlockMutex(m_ImageCacheLock);
+
+    return imagesRef;
+}
+
+void EglImageFactory::attachImagesToFrame(AVFrame* frame, AVBufferRef* imagesRef)
+{
+    // Add a buffer reference to the frame to keep the EGLImages alive until
+    // the frame is no longer referenced. This takes ownership of imagesRef.
+    frame->opaque_ref = av_buffer_create((uint8_t*)imagesRef, sizeof(*imagesRef),
+                                         freeCachedImagesRef,
+                                         frame->opaque_ref, // Chain any existing buffer
+                                         AV_BUFFER_FLAG_READONLY);
 }
 
 #ifdef HAVE_DRM
 
+bool EglImageFactory::areDmaBufInodesUnique(int dmaBufFd)
+{
+    if (m_DmaBufInodesUnique >= 0) {
+        return m_DmaBufInodesUnique != 0;
+    }
+
+    // Prior to Linux 5.3, every DMA-BUF shared the single anonymous inode
+    // and its inode number says nothing about which buffer it refers to.
+    // An eventfd lives on that same anonymous inode, so if the DMA-BUF is
+    // on the same device, we can't use the inode to identify the buffer.
+    m_DmaBufInodesUnique = 0;
+
+    int anonFd = eventfd(0, EFD_CLOEXEC);
+    if (anonFd < 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "eventfd() failed: %d",
+                    errno);
+        return false;
+    }
+
+    struct stat dmaBufStat, anonStat;
+    if (fstat(dmaBufFd, &dmaBufStat) == 0 && fstat(anonFd, &anonStat) == 0) {
+        m_DmaBufInodesUnique = dmaBufStat.st_dev != anonStat.st_dev;
+    }
+
+    close(anonFd);
+
+    if (!m_DmaBufInodesUnique) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "DMA-BUFs don't have unique inodes; EGLImage caching is disabled");
+    }
+
+    return m_DmaBufInodesUnique != 0;
+}
+
 ssize_t EglImageFactory::exportDRMImages(AVFrame* frame, EGLDisplay dpy, EGLImage images[EGL_MAX_PLANES])
 {
     SDL_assert(frame->format == AV_PIX_FMT_DRM_PRIME);
@@ -217,6 +356,46 @@ ssize_t EglImageFactory::exportDRMImages(AVFrame* frame, EGLDisplay dpy, EGLImag
     attribs[attribIndex++] = EGL_NONE;
     SDL_assert(attribIndex <= MAX_ATTRIB_COUNT);
 
+    // Build the cache key from our attributes. FD numbers can be reused for
+    // different buffers, so we key on the identity of the DMA-BUF instead.
+    // That's only possible if each DMA-BUF has its own inode.
+    std::vector<uint64_t> cacheKey;
+    if (drmFrame->nb_objects > 0 && areDmaBufInodesUnique(drmFrame->objects[0].fd)) {
+        cacheKey.push_back((uintptr_t)(frame->hw_frames_ctx ? frame->hw_frames_ctx->data : nullptr));
+    }
+    for (int i = 0; !cacheKey.empty() && i + 1 < attribIndex; i += 2) {
+        cacheKey.push_back((uint64_t)attribs[i]);
+
+        switch (attribs[i]) {
+        case EGL_DMA_BUF_PLANE0_FD_EXT:
+        case EGL_DMA_BUF_PLANE1_FD_EXT:
+        case EGL_DMA_BUF_PLANE2_FD_EXT:
+        case EGL_DMA_BUF_PLANE3_FD_EXT:
+        {
+            struct stat st;
+            if (fstat((int)attribs[i + 1], &st) == 0) {
+                cacheKey.push_back((uint64_t)st.st_dev);
+                cacheKey.push_back((uint64_t)st.st_ino);
+            }
+            else {
+                // We can't safely cache this one
+                cacheKey.clear();
+            }
+            break;
+        }
+        default:
+            cacheKey.push_back((uint64_t)attribs[i + 1]);
+            break;
+        }
+    }
+
+    AVBufferRef* imagesRef = cacheKey.empty() ? nullptr : lookupCachedImages(cacheKey);
+    if (imagesRef != nullptr) {
+        images[0] = ((EglImageContext*)imagesRef->data)->images[0];
+        attachImagesToFrame(frame, imagesRef);
+        return 1;
+    }
+
     // Our EGLImages are non-planar, so we only populate the first entry
     if (m_eglCreateImage) {
         images[0] = m_eglCreateImage(dpy, EGL_NO_CONTEXT,
@@ -249,13 +428,13 @@ ssize_t EglImageFactory::exportDRMImages(AVFrame* frame, EGLDisplay dpy, EGLImag
     imgCtx->images[0] = images[0];
     imgCtx->count = 1;
 
-    // Add a buffer reference to the frame to automatically destroy the EGLImages
-    // when the frame is no longer referenced.
-    frame->opaque_ref = av_buffer_create((uint8_t*)imgCtx, sizeof(*imgCtx),
-                                         freeEglImageContextBuffer,
-                                         frame->opaque_ref, // Chain any existing buffer
-                                         AV_BUFFER_FLAG_READONLY);
-    return imgCtx->count;
+    imagesRef = cacheImages(std::move(cacheKey), imgCtx);
+    if (imagesRef == nullptr) {
+        return -1;
+    }
+
+    attachImagesToFrame(frame, imagesRef);
+    return 1;
 }
 
 #endif
@@ -277,6 +456,28 @@ ssize_t EglImageFactory::exportVAImages(AVFrame *frame, uint32_t exportFlags, EG
         return -1;
     }
 
+    // VAAPI surfaces are recycled within the pool, so we can skip exporting
+    // the surface entirely if we've already imported it with these attributes.
+    std::vector<uint64_t> cacheKey = {
+        (uintptr_t)hwFrameCtx,
+        (uint64_t)surface_id,
+        (uint64_t)exportFlags,
+        (uint64_t)frame->width,
+        (uint64_t)frame->height,
+        (uint64_t)m_Renderer->getFrameColorspace(frame),
+        (uint64_t)m_Renderer->isFrameFullRange(frame),
+        (uint64_t)frame->chroma_location,
+    };
+    AVBufferRef* imagesRef = lookupCachedImages(cacheKey);
+    if (imagesRef != nullptr) {
+        auto imgCtx = (EglImageContext*)imagesRef->data;
+        ssize_t count = imgCtx->count;
+
+        memcpy(images, imgCtx->images, sizeof(EGLImage) * count);
+        attachImagesToFrame(frame, imagesRef);
+        return count;
+    }
+
     VADRMPRIMESurfaceDescriptor vaFrame;
     st = vaExportSurfaceHandle(vaDeviceContext->display,
                                surface_id,
@@ -475,15 +676,16 @@ ssize_t EglImageFactory::exportVAImages(AVFrame *frame, uint32_t exportFlags, EG
         return -1;
     }
 
-    // Add a buffer reference to the frame to automatically destroy the EGLImages
-    // when the frame is no longer referenced.
-    frame->opaque_ref = av_buffer_create((uint8_t*)imgCtx, sizeof(*imgCtx),
-                                         freeEglImageContextBuffer,
-                                         frame->opaque_ref, // Chain any existing buffer
-                                         AV_BUFFER_FLAG_READONLY);
+    ssize_t count = imgCtx->count;
+    memcpy(images, imgCtx->images, sizeof(EGLImage) * count);
+
+    imagesRef = cacheImages(std::move(cacheKey), imgCtx);
+    if (imagesRef == nullptr) {
+        return -1;
+    }
 
-    memcpy(images, imgCtx->images, sizeof(EGLImage) * imgCtx->count);
-    return imgCtx->count;
+    attachImagesToFrame(frame, imagesRef);
+    return count;
 }
 
 #endif
@@ -578,3 +780,13 @@ void EglImageFactory::freeEglImageContextBuffer(void* opaque, uint8_t* data)
     av_buffer_unref((AVBufferRef**)&opaque);
 }
 
+void EglImageFactory::freeCachedImagesRef(void* opaque, uint8_t* data)
+{
+    // Drop the frame's reference to the EGLImages
+    auto imagesRef = (AVBufferRef*)data;
+    av_buffer_unref(&imagesRef);
+
+    // Free any chained buffers
+    av_buffer_unref((AVBufferRef**)&opaque);
+}
+
@@ -6,7 +6,9 @@
 #include <va/va_drmcommon.h>
 #endif
 
+#include <atomic>
 #include <optional>
+#include <vector>
 
 class EglImageFactory
 {
@@ -42,9 +44,13 @@ class EglImageFactory
 
 public:
     EglImageFactory(IFFmpegRenderer* renderer);
+    ~EglImageFactory();
     bool initializeEGL(EGLDisplay, const EGLExtensions &ext);
     void resetCache();
 
+    // Adds and resets the EGLImage cache hit and miss counters
+    void addCacheStats(PVIDEO_STATS stats);
+
 #ifdef HAVE_DRM
     ssize_t exportDRMImages(AVFrame* frame, EGLDisplay dpy, EGLImage images[EGL_MAX_PLANES]);
 #endif
@@ -57,8 +63,28 @@ public:
     bool supportsImportingModifier(EGLDisplay dpy, EGLint format, EGLuint64KHR modifier);
 
 private:
+    // EGLImages are cached for each decoder surface, since hardware decoders
+    // cycle through a small fixed pool of them. The key identifies both the
+    // surface and every attribute we'd pass to eglCreateImage().
+    struct CachedImages {
+        std::vector<uint64_t> key;
+        AVBufferRef* imagesRef; // Holds an EglImageContext
+    };
+
     static void freeEglImageContextBuffer(void* opaque, uint8_t* data);
 
+    static void freeCachedImagesRef(void* opaque, uint8_t* data);
+
+    AVBufferRef* lookupCachedImages(const std::vector<uint64_t>& key);
+
+    AVBufferRef* cacheImages(std::vector<uint64_t>&& key, EglImageContext* imgCtx);
+
+    static void attachImagesToFrame(AVFrame* frame, AVBufferRef* imagesRef);
+
+#ifdef HAVE_DRM
+    bool areDmaBufInodesUnique(int dmaBufFd);
+#endif
+
     IFFmpegRenderer* m_Renderer;
     bool m_EGLExtDmaBuf;
     PFNEGLCREATEIMAGEPROC m_eglCreateImage;
@@ -67,4 +93,16 @@ private:
     PFNEGLDESTROYIMAGEKHRPROC m_eglDestroyImageKHR;
     PFNEGLQUERYDMABUFFORMATSEXTPROC m_eglQueryDmaBufFormatsEXT;
     PFNEGLQUERYDMABUFMODIFIERSEXTPROC m_eglQueryDmaBufModifiersEXT;
+
+#ifdef HAVE_DRM
+    // -1 until we've checked the first DMA-BUF we import
+    int m_DmaBufInodesUnique;
+#endif
+
+    // Lookups happen on the render thread, but resets
+    // come from the decoder thread in get_format()
+    SDL_mutex* m_ImageCacheLock;
+    std::vector<CachedImages> m_ImageCache;
+    std::atomic<uint32_t> m_ImageCacheHits;
+    std::atomic<uint32_t> m_ImageCacheMisses;
 };
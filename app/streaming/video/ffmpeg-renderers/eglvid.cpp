@@ -57,6 +57,8 @@ EGLRenderer::EGLRenderer(IFFmpegRenderer *backendRenderer)
         m_OverlayVBOs{0},
         m_OverlayVAOs{0},
         m_OverlayHasValidData{},
+        m_OverlayTextureWidth{},
+        m_OverlayTextureHeight{},
         m_ShaderProgram(0),
         m_OverlayShaderProgram(0),
         m_Context(0),
@@ -73,6 +75,8 @@ EGLRenderer::EGLRenderer(IFFmpegRenderer *backendRenderer)
         m_eglCreateSyncKHR(nullptr),
         m_eglDestroySync(nullptr),
         m_eglClientWaitSync(nullptr),
+        m_eglGetSyncValuesCHROMIUM(nullptr),
+        m_EGLSurface(EGL_NO_SURFACE),
         m_GlesMajorVersion(0),
         m_GlesMinorVersion(0),
         m_HasExtUnpackSubimage(false)
@@ -160,44 +164,68 @@ void EGLRenderer::renderOverlay(Overlay::OverlayType type, int viewportWidth, in
     }
 
     // Upload a new overlay texture if needed
-    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type);
+    SDL_Rect dirtyRect;
+    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type, &dirtyRect);
     if (newSurface != nullptr) {
         SDL_assert(!SDL_MUSTLOCK(newSurface));
         SDL_assert(newSurface->format->format == SDL_PIXELFORMAT_ARGB8888);
 
         glBindTexture(GL_TEXTURE_2D, m_OverlayTextures[type]);
 
-        // If the pixel data isn't tightly packed, it requires special handling
-        void* packedPixelData = nullptr;
-        if (newSurface->pitch != newSurface->w * newSurface->format->BytesPerPixel) {
-            if (m_GlesMajorVersion >= 3 || m_HasExtUnpackSubimage) {
-                // If we are GLES 3.0+ or have GL_EXT_unpack_subimage, GL can handle any pitch
-                SDL_assert(newSurface->pitch % newSurface->format->BytesPerPixel == 0);
-                glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, newSurface->pitch / newSurface->format->BytesPerPixel);
-            }
-            else {
-                // If we can't use GL_UNPACK_ROW_LENGTH, we must allocate a tightly packed buffer
-                // and copy our pixels there.
-                packedPixelData = malloc(newSurface->w * newSurface->h * newSurface->format->BytesPerPixel);
-                if (!packedPixelData) {
-                    SDL_FreeSurface(newSurface);
-                    return;
-                }
+        // If the texture is still the same size, we only need to upload the part that changed
+        bool fullUpload = newSurface->w != m_OverlayTextureWidth[type] || newSurface->h != m_OverlayTextureHeight[type];
+        if (fullUpload) {
+            dirtyRect = { 0, 0, newSurface->w, newSurface->h };
+        }
 
-                SDL_ConvertPixels(newSurface->w, newSurface->h,
-                                  newSurface->format->format, newSurface->pixels, newSurface->pitch,
-                                  newSurface->format->format, packedPixelData, newSurface->w * newSurface->format->BytesPerPixel);
+        if (!SDL_RectEmpty(&dirtyRect)) {
+            int bytesPerPixel = newSurface->format->BytesPerPixel;
+            const Uint8* pixels = (const Uint8*)newSurface->pixels +
+                                  dirtyRect.y * newSurface->pitch +
+                                  dirtyRect.x * bytesPerPixel;
+
+            // If the pixel data isn't tightly packed, it requires special handling
+            void* packedPixelData = nullptr;
+            if (newSurface->pitch != dirtyRect.w * bytesPerPixel) {
+                if (m_GlesMajorVersion >= 3 || m_HasExtUnpackSubimage) {
+                    // If we are GLES 3.0+ or have GL_EXT_unpack_subimage, GL can handle any pitch
+                    SDL_assert(newSurface->pitch % bytesPerPixel == 0);
+                    glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, newSurface->pitch / bytesPerPixel);
+                }
+                else {
+                    // If we can't use GL_UNPACK_ROW_LENGTH, we must allocate a tightly packed buffer
+                    // and copy our pixels there.
+                    packedPixelData = malloc(dirtyRect.w * dirtyRect.h * bytesPerPixel);
+                    if (!packedPixelData) {
+                        // The texture no longer matches what the overlay manager thinks we have
+                        m_OverlayTextureWidth[type] = m_OverlayTextureHeight[type] = 0;
+                        SDL_FreeSurface(newSurface);
+                        return;
+                    }
+
+                    SDL_ConvertPixels(dirtyRect.w, dirtyRect.h,
+                                      newSurface->format->format, pixels, newSurface->pitch,
+                                      newSurface->format->format, packedPixelData, dirtyRect.w * bytesPerPixel);
+                }
             }
-        }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, newSurface->w, newSurface->h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                     packedPixelData ? packedPixelData : newSurface->pixels);
+            if (fullUpload) {
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, newSurface->w, newSurface->h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                             packedPixelData ? packedPixelData : pixels);
+                m_OverlayTextureWidth[type] = newSurface->w;
+                m_OverlayTextureHeight[type] = newSurface->h;
+            }
+            else {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, dirtyRect.x, dirtyRect.y, dirtyRect.w, dirtyRect.h, GL_RGBA, GL_UNSIGNED_BYTE,
+                                packedPixelData ? packedPixelData : pixels);
+            }
 
-        if (packedPixelData) {
-            free(packedPixelData);
-        }
-        else if (newSurface->pitch != newSurface->w * newSurface->format->BytesPerPixel) {
-            glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+            if (packedPixelData) {
+                free(packedPixelData);
+            }
+            else if (newSurface->pitch != dirtyRect.w * bytesPerPixel) {
+                glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+            }
         }
 
         SDL_FRect overlayRect;
@@ -579,6 +607,17 @@ bool EGLRenderer::initialize(PDECODER_PARAMETERS params)
         m_eglClientWaitSync = nullptr;
     }
 
+    // EGL_CHROMIUM_sync_control is the EGL counterpart of GLX_OML_sync_control.
+    // Its UST is the monotonic clock time of the last V-sync, which Pacer can
+    // use to keep its software V-sync source in phase with the display.
+    if (eglExtensions.isSupported("EGL_CHROMIUM_sync_control")) {
+        m_eglGetSyncValuesCHROMIUM = (typeof(m_eglGetSyncValuesCHROMIUM))eglGetProcAddress("eglGetSyncValuesCHROMIUM");
+        m_EGLSurface = eglGetCurrentSurface(EGL_DRAW);
+        if (m_EGLSurface == EGL_NO_SURFACE) {
+            m_eglGetSyncValuesCHROMIUM = nullptr;
+        }
+    }
+
     // SDL always uses swap interval 0 under the hood on Wayland systems,
     // because the compositor guarantees tear-free rendering. In this
     // situation, swap interval > 0 behaves as a frame pacing option
@@ -627,6 +666,29 @@ bool EGLRenderer::initialize(PDECODER_PARAMETERS params)
     return err == GL_NO_ERROR;
 }
 
+int EGLRenderer::getRendererAttributes()
+{
+    int attributes = 0;
+
+    if (m_eglGetSyncValuesCHROMIUM != nullptr) {
+        attributes |= RENDERER_ATTRIBUTE_VSYNC_TIMESTAMPS;
+    }
+
+    return attributes;
+}
+
+bool EGLRenderer::getLastVsyncTime(uint64_t* vsyncTimeUs)
+{
+    EGLuint64KHR ust, msc, sbc;
+
+    if (m_eglGetSyncValuesCHROMIUM == nullptr ||
+            !m_eglGetSyncValuesCHROMIUM(m_EGLDisplay, m_EGLSurface, &ust, &msc, &sbc)) {
+        return false;
+    }
+
+    return StreamUtils::convertMonotonicTimeUs(ust, vsyncTimeUs);
+}
+
 bool EGLRenderer::setupVideoRenderingState() {
     // Setup the video plane textures
     glGenTextures(EGL_MAX_PLANES, m_Textures);
@@ -871,6 +933,7 @@ void EGLRenderer::renderFrame(AVFrame* frame)
         renderOverlay((Overlay::OverlayType)i, drawableWidth, drawableHeight);
     }
 
+    markPresentStart();
     SDL_GL_SwapWindow(m_Window);
 
     if (m_BlockingSwapBuffers) {
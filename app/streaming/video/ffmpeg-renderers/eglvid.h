@@ -21,6 +21,8 @@ public:
     virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO) override;
     virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
     virtual AVPixelFormat getPreferredPixelFormat(int videoFormat) override;
+    virtual int getRendererAttributes() override;
+    virtual bool getLastVsyncTime(uint64_t* vsyncTimeUs) override;
 
 private:
 
@@ -38,6 +40,8 @@ private:
     unsigned m_OverlayVBOs[Overlay::OverlayMax];
     unsigned m_OverlayVAOs[Overlay::OverlayMax];
     SDL_atomic_t m_OverlayHasValidData[Overlay::OverlayMax];
+    int m_OverlayTextureWidth[Overlay::OverlayMax];
+    int m_OverlayTextureHeight[Overlay::OverlayMax];
     unsigned m_ShaderProgram;
     unsigned m_OverlayShaderProgram;
     SDL_GLContext m_Context;
@@ -54,6 +58,8 @@ private:
     PFNEGLCREATESYNCKHRPROC m_eglCreateSyncKHR;
     PFNEGLDESTROYSYNCPROC m_eglDestroySync;
     PFNEGLCLIENTWAITSYNCPROC m_eglClientWaitSync;
+    PFNEGLGETSYNCVALUESCHROMIUMPROC m_eglGetSyncValuesCHROMIUM;
+    EGLSurface m_EGLSurface;
     int m_GlesMajorVersion;
     int m_GlesMinorVersion;
     bool m_HasExtUnpackSubimage;
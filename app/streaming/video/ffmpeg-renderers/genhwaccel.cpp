@@ -55,6 +55,12 @@ bool GenericHwAccelRenderer::isDirectRenderingSupported()
     return false;
 }
 
+bool GenericHwAccelRenderer::isConcurrentInitializationSupported()
+{
+    // We only create an FFmpeg device context and never touch the window
+    return true;
+}
+
 int GenericHwAccelRenderer::getDecoderCapabilities()
 {
     int caps;
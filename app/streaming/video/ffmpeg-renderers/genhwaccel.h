@@ -12,6 +12,7 @@ public:
     virtual void renderFrame(AVFrame* frame) override;
     virtual bool isDirectRenderingSupported() override;
     virtual int getDecoderCapabilities() override;
+    virtual bool isConcurrentInitializationSupported() override;
 
 private:
     AVHWDeviceType m_HwDeviceType;
@@ -0,0 +1,143 @@
+#include "nullrenderer.h"
+
+#include <Limelight.h>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+// Frame data is read at this stride when touching frames
+#define TOUCH_STRIDE 64
+
+NullRenderer::NullRenderer()
+    : IFFmpegRenderer(RendererType::Null),
+      m_SwFrameMapper(this),
+      m_FrameAccess(FrameAccess::None),
+      m_TouchChecksum(0)
+{
+}
+
+NullRenderer::~NullRenderer()
+{
+}
+
+bool NullRenderer::initialize(PDECODER_PARAMETERS params)
+{
+    m_SwFrameMapper.setVideoFormat(params->videoFormat);
+    return true;
+}
+
+bool NullRenderer::prepareDecoderContext(AVCodecContext*, AVDictionary**)
+{
+    // Software decoding needs no additional setup
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Using null renderer");
+    return true;
+}
+
+void NullRenderer::setFrameAccess(FrameAccess frameAccess)
+{
+    m_FrameAccess = frameAccess;
+}
+
+void NullRenderer::setFrameCallback(FrameCallback callback)
+{
+    m_FrameCallback = callback;
+}
+
+bool NullRenderer::isPixelFormatSupported(int, enum AVPixelFormat pixelFormat)
+{
+    // We can consume any format in system memory
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixelFormat);
+    return desc != nullptr && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL);
+}
+
+bool NullRenderer::testRenderFrame(AVFrame* frame)
+{
+    // Make sure hwframes can be read back in case that's requested later
+    if (frame->hw_frames_ctx != nullptr) {
+        AVFrame* swFrame = m_SwFrameMapper.getSwFrameFromHwFrame(frame);
+        if (swFrame == nullptr) {
+            return false;
+        }
+
+        av_frame_free(&swFrame);
+    }
+
+    return true;
+}
+
+void NullRenderer::notifyFrameDecoded(AVFrame* frame)
+{
+    if (m_FrameAccess == FrameAccess::Readback && frame->hw_frames_ctx != nullptr) {
+        m_SwFrameMapper.startReadback(frame);
+    }
+}
+
+void NullRenderer::addRendererStats(PVIDEO_STATS stats)
+{
+    m_SwFrameMapper.addReadbackStats(stats);
+}
+
+bool NullRenderer::isConcurrentInitializationSupported()
+{
+    // We have no window or graphics API state
+    return true;
+}
+
+void NullRenderer::touchFrame(const AVFrame* frame)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    if (desc == nullptr || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+        return;
+    }
+
+    uint8_t checksum = 0;
+    for (int plane = 0; plane < av_pix_fmt_count_planes((AVPixelFormat)frame->format); plane++) {
+        int rowBytes = av_image_get_linesize((AVPixelFormat)frame->format, frame->width, plane);
+        int rows = (plane == 1 || plane == 2) ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+
+        for (int y = 0; y < rows; y++) {
+            const uint8_t* row = frame->data[plane] + (ptrdiff_t)y * frame->linesize[plane];
+            for (int x = 0; x < rowBytes; x += TOUCH_STRIDE) {
+                checksum ^= row[x];
+            }
+        }
+    }
+
+    m_TouchChecksum ^= checksum;
+}
+
+void NullRenderer::renderFrame(AVFrame* frame)
+{
+    switch (m_FrameAccess) {
+    case FrameAccess::None:
+        break;
+
+    case FrameAccess::Touch:
+        // Only frames in system memory can be touched
+        touchFrame(frame);
+        break;
+
+    case FrameAccess::Readback:
+        if (frame->hw_frames_ctx != nullptr) {
+            AVFrame* swFrame = m_SwFrameMapper.getSwFrameFromHwFrame(frame);
+            if (swFrame == nullptr) {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                             "Failed to read back hwframe");
+                break;
+            }
+
+            touchFrame(swFrame);
+            av_frame_free(&swFrame);
+        }
+        else {
+            touchFrame(frame);
+        }
+        break;
+    }
+
+    if (m_FrameCallback) {
+        m_FrameCallback(frame, LiGetMicroseconds());
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "renderer.h"
+#include "swframemapper.h"
+
+#include <functional>
+
+// Consumes frames without displaying them. This is used when there's no
+// window, so the decoding pipeline can be benchmarked on headless systems.
+class NullRenderer : public IFFmpegRenderer
+{
+public:
+    enum class FrameAccess {
+        // Release frames without reading them
+        None,
+
+        // Read a byte from each cache line of a frame in system memory, which
+        // approximates the memory traffic of uploading it for display
+        Touch,
+
+        // Read hwframes back to system memory before touching them
+        Readback,
+    };
+
+    // Called on the render thread after each frame is consumed
+    typedef std::function<void(const AVFrame* frame, uint64_t renderedTimeUs)> FrameCallback;
+
+    NullRenderer();
+    virtual ~NullRenderer() override;
+    virtual bool initialize(PDECODER_PARAMETERS params) override;
+    virtual bool prepareDecoderContext(AVCodecContext* context, AVDictionary** options) override;
+    virtual void renderFrame(AVFrame* frame) override;
+    virtual bool testRenderFrame(AVFrame* frame) override;
+    virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
+    virtual void notifyFrameDecoded(AVFrame* frame) override;
+    virtual void addRendererStats(PVIDEO_STATS stats) override;
+    virtual bool isConcurrentInitializationSupported() override;
+
+    // These must be called before any frames are decoded
+    void setFrameAccess(FrameAccess frameAccess);
+    void setFrameCallback(FrameCallback callback);
+
+private:
+    void touchFrame(const AVFrame* frame);
+
+    SwFrameMapper m_SwFrameMapper;
+    FrameAccess m_FrameAccess;
+    FrameCallback m_FrameCallback;
+
+    // Keeps the reads in touchFrame() from being optimized away
+    uint8_t m_TouchChecksum;
+};
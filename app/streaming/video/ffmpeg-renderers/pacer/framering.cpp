@@ -0,0 +1,120 @@
+#include "framering.h"
+
+FrameRing::FrameRing(int capacity)
+    : m_Capacity(capacity),
+      m_ReadIndex(0),
+      m_WriteIndex(0)
+{
+    SDL_assert(capacity > 0);
+
+    m_Slots = new std::atomic<AVFrame*>[capacity];
+    for (int i = 0; i < capacity; i++) {
+        m_Slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    m_NotEmpty = SDL_CreateSemaphore(0);
+}
+
+FrameRing::~FrameRing()
+{
+    // The owner must drain the ring before destroying it
+    SDL_assert(count() == 0);
+
+    SDL_DestroySemaphore(m_NotEmpty);
+    delete[] m_Slots;
+}
+
+AVFrame* FrameRing::push(AVFrame* frame)
+{
+    uint64_t writeIndex = m_WriteIndex.load(std::memory_order_relaxed);
+    AVFrame* displacedFrame = nullptr;
+
+    // If we're full, take the oldest frame ourselves. The consumer may beat
+    // us to it, in which case we'll have room without displacing anything.
+    for (;;) {
+        uint64_t readIndex = m_ReadIndex.load(std::memory_order_acquire);
+        if (writeIndex - readIndex < (uint64_t)m_Capacity) {
+            break;
+        }
+
+        AVFrame* oldestFrame = m_Slots[readIndex % m_Capacity].load(std::memory_order_relaxed);
+        if (m_ReadIndex.compare_exchange_weak(readIndex, readIndex + 1, std::memory_order_acq_rel)) {
+            displacedFrame = oldestFrame;
+            break;
+        }
+    }
+
+    m_Slots[writeIndex % m_Capacity].store(frame, std::memory_order_relaxed);
+    m_WriteIndex.store(writeIndex + 1, std::memory_order_release);
+
+    // Only post if the consumer hasn't been signalled already
+    if (SDL_SemValue(m_NotEmpty) == 0) {
+        SDL_SemPost(m_NotEmpty);
+    }
+
+    return displacedFrame;
+}
+
+AVFrame* FrameRing::pop()
+{
+    uint64_t readIndex = m_ReadIndex.load(std::memory_order_acquire);
+    for (;;) {
+        if (readIndex == m_WriteIndex.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        // This slot can only be reused after the read index moves past it,
+        // so the frame we read is valid if our compare-and-swap succeeds.
+        AVFrame* frame = m_Slots[readIndex % m_Capacity].load(std::memory_order_relaxed);
+        if (m_ReadIndex.compare_exchange_weak(readIndex, readIndex + 1, std::memory_order_acq_rel)) {
+            return frame;
+        }
+    }
+}
+
+int FrameRing::count()
+{
+    // Read index first, so we never see it ahead of the write index
+    uint64_t readIndex = m_ReadIndex.load(std::memory_order_acquire);
+    return (int)(m_WriteIndex.load(std::memory_order_acquire) - readIndex);
+}
+
+bool FrameRing::waitNotEmpty(int timeoutMs)
+{
+    Uint32 deadline = SDL_GetTicks() + (Uint32)SDL_max(timeoutMs, 0);
+
+    while (count() == 0) {
+        int ret;
+
+        if (timeoutMs < 0) {
+            ret = SDL_SemWait(m_NotEmpty);
+        }
+        else {
+            Uint32 now = SDL_GetTicks();
+            if (SDL_TICKS_PASSED(now, deadline)) {
+                return false;
+            }
+
+            ret = SDL_SemWaitTimeout(m_NotEmpty, deadline - now);
+        }
+
+        if (ret != 0) {
+            // Timed out
+            return count() != 0;
+        }
+        else if (timeoutMs < 0 && count() == 0) {
+            // Either wake() was called or this was a stale post for a frame
+            // that has already been taken. Let the caller check whether it
+            // should stop before it waits again. Timed waits just keep
+            // waiting until their deadline.
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FrameRing::wake()
+{
+    SDL_SemPost(m_NotEmpty);
+}
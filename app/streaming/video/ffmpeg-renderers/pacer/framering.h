@@ -0,0 +1,48 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <atomic>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// A bounded lock-free ring of frames passed from one producer thread to
+// one consumer thread. When the ring is full, push() displaces the oldest
+// frame and hands it back to the producer to free, so the producer never
+// waits for the consumer.
+//
+// Pops are validated with a compare-and-swap on the read index, which is
+// what allows the producer to displace a frame while the consumer may be
+// popping it. A consumer waiting on an empty ring sleeps on a semaphore.
+class FrameRing
+{
+public:
+    explicit FrameRing(int capacity);
+
+    ~FrameRing();
+
+    // Producer only. Returns the frame displaced to make room, if any.
+    AVFrame* push(AVFrame* frame);
+
+    // Returns nullptr if the ring is empty
+    AVFrame* pop();
+
+    int count();
+
+    // Waits up to timeoutMs (or forever if negative) for the ring to
+    // become non-empty. Returns true if there are frames in the ring.
+    // Untimed waits may also return early after wake() is called.
+    bool waitNotEmpty(int timeoutMs);
+
+    // Wakes the consumer if it's in an untimed waitNotEmpty()
+    void wake();
+
+private:
+    std::atomic<AVFrame*>* m_Slots;
+    int m_Capacity;
+    std::atomic<uint64_t> m_ReadIndex;
+    std::atomic<uint64_t> m_WriteIndex;
+    SDL_sem* m_NotEmpty;
+};
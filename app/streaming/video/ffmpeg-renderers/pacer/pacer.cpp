@@ -1,5 +1,7 @@
 #include "pacer.h"
 #include "streaming/streamutils.h"
+#include "utils.h"
+#include "softwarevsyncsource.h"
 
 #ifdef Q_OS_WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -14,6 +16,8 @@
 
 #include <SDL_syswm.h>
 
+#include <thread>
+
 // Limit the number of queued frames to prevent excessive memory consumption
 // if the V-Sync source or renderer is blocked for a while. It's important
 // that the sum of all queued frames between both pacing and rendering queues
@@ -30,18 +34,43 @@ static_assert(PACER_MAX_OUTSTANDING_FRAMES == MAX_QUEUED_FRAMES + 2,
 // V-sync happens.
 #define TIMER_SLACK_MS 3
 
-Pacer::Pacer(IFFmpegRenderer* renderer, PVIDEO_STATS videoStats) :
+// When latching frames late, we leave this much time (at minimum) on top
+// of the predicted render time before the V-sync we're targeting. The
+// margin grows when we miss a V-sync and decays back when we don't.
+#define MIN_LATCH_MARGIN_US 1000
+
+// SDL_Delay() only has millisecond granularity and may oversleep, so we
+// sleep until we're this close to the latch point and spin the rest.
+#define LATCH_SPIN_US 2000
+
+Pacer::Pacer(IFFmpegRenderer* renderer, FramePool* framePool, FrameTimingTrace* frameTimingTrace, PVIDEO_STATS videoStats) :
+    m_RenderQueue(MAX_QUEUED_FRAMES),
+    m_PacingQueue(MAX_QUEUED_FRAMES),
+    m_VsyncSignalled(SDL_CreateSemaphore(0)),
     m_RenderThread(nullptr),
     m_VsyncThread(nullptr),
     m_DeferredFreeFrame(nullptr),
     m_Stopping(false),
     m_VsyncSource(nullptr),
+    m_VsyncPhaseEstimator(nullptr),
+    m_PacingPolicy(nullptr),
+    m_RenderTimingAvailable(false),
+    m_PredictedRenderTimeUs(0),
+    m_LatchMarginUs(MIN_LATCH_MARGIN_US),
+    m_LatchDeadlineUs(0),
     m_VsyncRenderer(renderer),
+    m_FramePool(framePool),
+    m_FrameTimingTrace(frameTimingTrace),
     m_MaxVideoFps(0),
     m_DisplayFps(0),
     m_VideoStats(videoStats)
 {
-
+    // Latching the newest frame just before V-sync is enabled by default. It only
+    // takes effect once the renderer reports when it starts presenting, since we
+    // can't otherwise tell render time apart from time spent blocked on V-sync.
+    if (!Utils::getEnvironmentVariableOverride("PACER_LATE_LATCH", &m_LateLatchEnabled)) {
+        m_LateLatchEnabled = true;
+    }
 }
 
 Pacer::~Pacer()
@@ -50,8 +79,7 @@ Pacer::~Pacer()
 
     // Stop the V-sync thread
     if (m_VsyncThread != nullptr) {
-        m_PacingQueueNotEmpty.wakeAll();
-        m_VsyncSignalled.wakeAll();
+        SDL_SemPost(m_VsyncSignalled);
         SDL_WaitThread(m_VsyncThread, nullptr);
     }
 
@@ -59,9 +87,12 @@ Pacer::~Pacer()
     delete m_VsyncSource;
     m_VsyncSource = nullptr;
 
+    delete m_PacingPolicy;
+    m_PacingPolicy = nullptr;
+
     // Stop the render thread
     if (m_RenderThread != nullptr) {
-        m_RenderQueueNotEmpty.wakeAll();
+        m_RenderQueue.wake();
         SDL_WaitThread(m_RenderThread, nullptr);
     }
     else {
@@ -71,15 +102,20 @@ Pacer::~Pacer()
     }
 
     // Delete any remaining unconsumed frames
-    while (!m_RenderQueue.isEmpty()) {
-        AVFrame* frame = m_RenderQueue.dequeue();
-        av_frame_free(&frame);
+    AVFrame* frame;
+    while ((frame = m_RenderQueue.pop()) != nullptr) {
+        m_FramePool->releaseFrame(&frame);
     }
-    while (!m_PacingQueue.isEmpty()) {
-        AVFrame* frame = m_PacingQueue.dequeue();
-        av_frame_free(&frame);
+    while ((frame = m_PacingQueue.pop()) != nullptr) {
+        m_FramePool->releaseFrame(&frame);
     }
-    av_frame_free(&m_DeferredFreeFrame);
+    m_FramePool->releaseFrame(&m_DeferredFreeFrame);
+
+    SDL_DestroySemaphore(m_VsyncSignalled);
+
+    // Both threads are gone, so nobody can be feeding the estimator now
+    delete m_VsyncPhaseEstimator;
+    m_VsyncPhaseEstimator = nullptr;
 }
 
 void Pacer::renderOnMainThread()
@@ -89,17 +125,10 @@ void Pacer::renderOnMainThread()
         return;
     }
 
-    m_FrameQueueLock.lock();
-
-    if (!m_RenderQueue.isEmpty()) {
-        AVFrame* frame = m_RenderQueue.dequeue();
-        m_FrameQueueLock.unlock();
-
+    AVFrame* frame = m_RenderQueue.pop();
+    if (frame != nullptr) {
         renderFrame(frame);
     }
-    else {
-        m_FrameQueueLock.unlock();
-    }
 }
 
 int Pacer::vsyncThread(void *context)
@@ -114,22 +143,29 @@ int Pacer::vsyncThread(void *context)
 
     bool async = me->m_VsyncSource->isAsync();
     while (!me->m_Stopping) {
+        uint64_t vsyncTimeUs = 0;
+
         if (async) {
+            // Discard any V-sync signalled while we were busy, since we
+            // can no longer tell when it actually happened
+            while (SDL_SemTryWait(me->m_VsyncSignalled) == 0);
+
             // Wait for the VSync source to invoke signalVsync() or 100ms to elapse
-            me->m_FrameQueueLock.lock();
-            me->m_VsyncSignalled.wait(&me->m_FrameQueueLock, 100);
-            me->m_FrameQueueLock.unlock();
+            if (SDL_SemWaitTimeout(me->m_VsyncSignalled, 100) == 0) {
+                vsyncTimeUs = LiGetMicroseconds();
+            }
         }
         else {
             // Let the VSync source wait in the context of our thread
             me->m_VsyncSource->waitForVsync();
+            vsyncTimeUs = LiGetMicroseconds();
         }
 
         if (me->m_Stopping) {
             break;
         }
 
-        me->handleVsync(1000 / me->m_DisplayFps);
+        me->handleVsync(1000 / me->m_DisplayFps, vsyncTimeUs);
     }
 
     return 0;
@@ -149,24 +185,18 @@ int Pacer::renderThread(void* context)
         // Wait for the renderer to be ready for the next frame
         me->m_VsyncRenderer->waitToRender();
 
-        // Acquire the frame queue lock to protect the queue and
-        // the not empty condition
-        me->m_FrameQueueLock.lock();
-
         // Wait for a frame to be ready to render
-        while (!me->m_Stopping && me->m_RenderQueue.isEmpty()) {
-            me->m_RenderQueueNotEmpty.wait(&me->m_FrameQueueLock);
+        AVFrame* frame = nullptr;
+        while (!me->m_Stopping && (frame = me->m_RenderQueue.pop()) == nullptr) {
+            me->m_RenderQueue.waitNotEmpty(-1);
         }
 
         if (me->m_Stopping) {
             // Exit this thread
-            me->m_FrameQueueLock.unlock();
+            me->m_FramePool->releaseFrame(&frame);
             break;
         }
 
-        AVFrame* frame = me->m_RenderQueue.dequeue();
-        me->m_FrameQueueLock.unlock();
-
         me->renderFrame(frame);
     }
 
@@ -177,17 +207,17 @@ int Pacer::renderThread(void* context)
     return 0;
 }
 
-void Pacer::enqueueFrameForRenderingAndUnlock(AVFrame *frame)
+void Pacer::enqueueFrameForRendering(AVFrame *frame)
 {
-    dropFrameForEnqueue(m_RenderQueue);
-    m_RenderQueue.enqueue(frame);
+    if (m_FrameTimingTrace != nullptr) {
+        m_FrameTimingTrace->recordStage(FRAME_NUMBER_FROM_AVFRAME(frame),
+                                        FrameTimingTrace::StagePacerDequeue,
+                                        LiGetMicroseconds());
+    }
 
-    m_FrameQueueLock.unlock();
+    enqueueFrame(m_RenderQueue, frame);
 
-    if (m_RenderThread != nullptr) {
-        m_RenderQueueNotEmpty.wakeOne();
-    }
-    else {
+    if (m_RenderThread == nullptr) {
         SDL_Event event;
 
         // For main thread rendering, we'll push an event to trigger a callback
@@ -199,73 +229,126 @@ void Pacer::enqueueFrameForRenderingAndUnlock(AVFrame *frame)
 
 // Called in an arbitrary thread by the IVsyncSource on V-sync
 // or an event synchronized with V-sync
-void Pacer::handleVsync(int timeUntilNextVsyncMillis)
+void Pacer::handleVsync(int timeUntilNextVsyncMillis, uint64_t vsyncTimeUs)
 {
     // Make sure initialize() has been called
     SDL_assert(m_MaxVideoFps != 0);
 
-    m_FrameQueueLock.lock();
-
-    // If the queue length history entries are large, be strict
-    // about dropping excess frames.
-    int frameDropTarget = 1;
-
-    // If we may get more frames per second than we can display, use
-    // frame history to drop frames only if consistently above the
-    // one queued frame mark.
-    if (m_MaxVideoFps >= m_DisplayFps) {
-        for (int queueHistoryEntry : m_PacingQueueHistory) {
-            if (queueHistoryEntry <= 1) {
-                // Be lenient as long as the queue length
-                // resolves before the end of frame history
-                frameDropTarget = 3;
-                break;
+    uint64_t latchDeadlineUs = 0;
+    if (m_LateLatchEnabled && m_RenderTimingAvailable && vsyncTimeUs != 0) {
+        uint64_t vsyncPeriodUs = 1000000 / m_DisplayFps;
+        uint64_t leadTimeUs = m_PredictedRenderTimeUs + m_LatchMarginUs;
+
+        latchDeadlineUs = vsyncTimeUs + vsyncPeriodUs;
+
+        // Rather than picking a frame right after this V-sync, wait until
+        // there's only enough time left to render it before the next one.
+        // This lets us pick up a newer frame if one arrives in the meantime.
+        if (leadTimeUs + (TIMER_SLACK_MS * 1000) < vsyncPeriodUs) {
+            uint64_t latchTimeUs = latchDeadlineUs - leadTimeUs;
+            uint64_t now = LiGetMicroseconds();
+            if (latchTimeUs > now + LATCH_SPIN_US) {
+                SDL_Delay((Uint32)((latchTimeUs - now - LATCH_SPIN_US) / 1000));
+            }
+            while (LiGetMicroseconds() < latchTimeUs && !m_Stopping) {
+                std::this_thread::yield();
             }
-        }
 
-        // Keep a rolling 500 ms window of pacing queue history
-        if (m_PacingQueueHistory.count() == m_DisplayFps / 2) {
-            m_PacingQueueHistory.dequeue();
+            if (m_Stopping) {
+                return;
+            }
         }
 
-        m_PacingQueueHistory.enqueue(m_PacingQueue.count());
+        // If the queue is empty, only wait until the deadline for a new frame
+        uint64_t now = LiGetMicroseconds();
+        timeUntilNextVsyncMillis = latchDeadlineUs > now ? (int)((latchDeadlineUs - now) / 1000) : 0;
     }
 
+    // Ask the pacing policy how many frames we can keep queued
+    int frameDropTarget = m_PacingPolicy->getPacingQueueTarget(m_PacingQueue.count());
+    SDL_assert(frameDropTarget >= 1 && frameDropTarget <= MAX_QUEUED_FRAMES);
+
+    m_VideoStats->pacingDecisions++;
+    m_VideoStats->totalPacingQueueTarget += frameDropTarget;
+
     // Catch up if we're several frames ahead
     while (m_PacingQueue.count() > frameDropTarget) {
-        AVFrame* frame = m_PacingQueue.dequeue();
+        AVFrame* frame = m_PacingQueue.pop();
+        if (frame == nullptr) {
+            // The producer displaced the frames we were going to drop
+            break;
+        }
 
-        // Drop the lock while we call av_frame_free()
-        m_FrameQueueLock.unlock();
         m_VideoStats->pacerDroppedFrames++;
-        av_frame_free(&frame);
-        m_FrameQueueLock.lock();
+        m_FramePool->releaseFrame(&frame);
     }
 
-    if (m_PacingQueue.isEmpty()) {
+    AVFrame* frame = m_PacingQueue.pop();
+    if (frame == nullptr) {
         // Wait for a frame to arrive or our V-sync timeout to expire
-        if (!m_PacingQueueNotEmpty.wait(&m_FrameQueueLock, SDL_max(timeUntilNextVsyncMillis, TIMER_SLACK_MS) - TIMER_SLACK_MS)) {
-            // Wait timed out - unlock and bail
-            m_FrameQueueLock.unlock();
+        if (!m_PacingQueue.waitNotEmpty(SDL_max(timeUntilNextVsyncMillis, TIMER_SLACK_MS) - TIMER_SLACK_MS)) {
+            // Wait timed out - bail
             return;
         }
 
         if (m_Stopping) {
-            m_FrameQueueLock.unlock();
             return;
         }
+
+        frame = m_PacingQueue.pop();
+        SDL_assert(frame != nullptr);
     }
 
+    // Tell the renderer which V-sync this frame is supposed to make
+    m_LatchDeadlineUs = latchDeadlineUs;
+
     // Place the first frame on the render queue
-    enqueueFrameForRenderingAndUnlock(m_PacingQueue.dequeue());
+    enqueueFrameForRendering(frame);
 }
 
-bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing)
+void Pacer::updateRenderTimePrediction(uint64_t renderTimeUs, uint64_t renderEndUs, uint64_t latchDeadlineUs)
+{
+    uint64_t vsyncPeriodUs = 1000000 / m_DisplayFps;
+
+    // Keep a running estimate of how long it takes to render a frame
+    int64_t predictedRenderTimeUs = m_PredictedRenderTimeUs;
+    predictedRenderTimeUs += ((int64_t)SDL_min(renderTimeUs, vsyncPeriodUs) - predictedRenderTimeUs) / 8;
+    m_PredictedRenderTimeUs = predictedRenderTimeUs;
+
+    // Only frames that were latched late tell us how close we can cut it
+    if (latchDeadlineUs == 0) {
+        return;
+    }
+
+    if (renderEndUs > latchDeadlineUs + vsyncPeriodUs / 2) {
+        // We missed the V-sync we were targeting, so back off quickly
+        m_LatchMarginUs = SDL_min(m_LatchMarginUs * 2, vsyncPeriodUs);
+    }
+    else {
+        // We made it, so slowly move the latch point closer to V-sync again
+        m_LatchMarginUs -= (m_LatchMarginUs - MIN_LATCH_MARGIN_US) / 32;
+    }
+}
+
+bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing, StreamingPreferences::PacingPolicy pacingPolicy)
 {
     m_MaxVideoFps = maxVideoFps;
-    m_DisplayFps = StreamUtils::getDisplayRefreshRate(window);
     m_RendererAttributes = m_VsyncRenderer->getRendererAttributes();
 
+    if (window == nullptr) {
+        // Headless rendering has no display to pace against, so frames
+        // are rendered as soon as they're decoded.
+        m_DisplayFps = maxVideoFps;
+        enablePacing = false;
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Frame pacing disabled: no window (%d FPS stream)",
+                    m_MaxVideoFps);
+    }
+    else {
+        m_DisplayFps = StreamUtils::getDisplayRefreshRate(window);
+    }
+
     if (enablePacing) {
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                     "Frame pacing: target %d Hz with %d FPS stream",
@@ -297,6 +380,31 @@ bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing)
             break;
     #endif
 
+    #if defined(SDL_VIDEO_DRIVER_X11)
+        case SDL_SYSWM_X11:
+    #endif
+    #if defined(SDL_VIDEO_DRIVER_KMSDRM) && SDL_VERSION_ATLEAST(2, 0, 15)
+        case SDL_SYSWM_KMSDRM:
+    #endif
+    #if defined(SDL_VIDEO_DRIVER_X11) || (defined(SDL_VIDEO_DRIVER_KMSDRM) && SDL_VERSION_ATLEAST(2, 0, 15))
+        {
+            // There's no V-sync notification we can use here, so the software source
+            // predicts V-sync instead. It's used by default when the renderer can get
+            // V-sync timestamps from the display driver (DRM or EGL_CHROMIUM_sync_control).
+            // Otherwise, it can be forced on to predict V-sync from the times presented
+            // frames finish rendering, which only works if presenting blocks until the flip.
+            bool softwareVsync;
+            if (!Utils::getEnvironmentVariableOverride("SOFTWARE_VSYNC_SOURCE", &softwareVsync)) {
+                softwareVsync = (m_RendererAttributes & RENDERER_ATTRIBUTE_VSYNC_TIMESTAMPS) != 0;
+            }
+            if (m_DisplayFps > 0 && softwareVsync) {
+                m_VsyncPhaseEstimator = new VsyncPhaseEstimator(1000000 / m_DisplayFps);
+                m_VsyncSource = new SoftwareVsyncSource(m_VsyncPhaseEstimator);
+            }
+            break;
+        }
+    #endif
+
         default:
             // Platforms without a VsyncSource will just render frames
             // immediately like they used to.
@@ -312,13 +420,30 @@ bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing)
             m_VsyncSource = nullptr;
         }
     }
-    else {
+    else if (window != nullptr) {
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                     "Frame pacing disabled: target %d Hz with %d FPS stream",
                     m_DisplayFps, m_MaxVideoFps);
     }
 
     if (m_VsyncSource != nullptr) {
+        switch (pacingPolicy) {
+        case StreamingPreferences::PP_LATEST_FRAME:
+            m_PacingPolicy = new LatestFramePacingPolicy();
+            break;
+        case StreamingPreferences::PP_ADAPTIVE:
+            m_PacingPolicy = new AdaptivePacingPolicy(m_MaxVideoFps, m_DisplayFps, MAX_QUEUED_FRAMES);
+            break;
+        default:
+            SDL_assert(pacingPolicy == StreamingPreferences::PP_SMOOTH);
+            m_PacingPolicy = new SmoothPacingPolicy(m_MaxVideoFps, m_DisplayFps);
+            break;
+        }
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Frame pacing policy: %s",
+                    m_PacingPolicy->getName());
+
         m_VsyncThread = SDL_CreateThread(Pacer::vsyncThread, "PacerVsync", this);
     }
 
@@ -329,9 +454,17 @@ bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing)
     return true;
 }
 
+const char* Pacer::getPacingPolicyName()
+{
+    return m_PacingPolicy != nullptr ? m_PacingPolicy->getName() : nullptr;
+}
+
 void Pacer::signalVsync()
 {
-    m_VsyncSignalled.wakeOne();
+    // Only post if the V-sync thread hasn't been signalled already
+    if (SDL_SemValue(m_VsyncSignalled) == 0) {
+        SDL_SemPost(m_VsyncSignalled);
+    }
 }
 
 void Pacer::renderFrame(AVFrame* frame)
@@ -339,23 +472,55 @@ void Pacer::renderFrame(AVFrame* frame)
     // Count time spent in Pacer's queues
     uint64_t beforeRender = LiGetMicroseconds();
     m_VideoStats->totalPacerTimeUs += (beforeRender - (uint64_t)frame->pkt_dts);
+    m_VideoStats->pacerLatency.addSample(beforeRender - (uint64_t)frame->pkt_dts);
 
     // Render it
     m_VsyncRenderer->renderFrame(frame);
     uint64_t afterRender = LiGetMicroseconds();
 
+    if (m_FrameTimingTrace != nullptr) {
+        uint32_t frameNumber = FRAME_NUMBER_FROM_AVFRAME(frame);
+        m_FrameTimingTrace->recordStage(frameNumber, FrameTimingTrace::StageRenderStart, beforeRender);
+        m_FrameTimingTrace->recordStage(frameNumber, FrameTimingTrace::StageRenderEnd, afterRender);
+    }
+
     m_VideoStats->totalRenderTimeUs += (afterRender - beforeRender);
+
+    // Predict render time from the work done before presenting. Blocking
+    // renderers can spend the rest of the V-sync period waiting in present,
+    // which would otherwise make late latching look impossible. If this frame
+    // was latched late, also check whether it made its V-sync.
+    uint64_t latchDeadlineUs = m_LatchDeadlineUs.exchange(0);
+    uint64_t presentStartUs = m_VsyncRenderer->getLastPresentStartTimeUs();
+    if (presentStartUs >= beforeRender && presentStartUs <= afterRender) {
+        updateRenderTimePrediction(presentStartUs - beforeRender, afterRender, latchDeadlineUs);
+        m_RenderTimingAvailable = true;
+    }
+    m_VideoStats->renderLatency.addSample(afterRender - beforeRender);
+
+    // Keep our V-sync estimate in phase with the display. Without V-sync
+    // timestamps from the renderer, we assume it blocked until the frame
+    // was flipped. The estimator discards samples that aren't near a V-sync.
+    if (m_VsyncPhaseEstimator != nullptr) {
+        if (m_RendererAttributes & RENDERER_ATTRIBUTE_VSYNC_TIMESTAMPS) {
+            uint64_t vsyncTimeUs;
+            if (m_VsyncRenderer->getLastVsyncTime(&vsyncTimeUs)) {
+                m_VsyncPhaseEstimator->addVsyncObservation(vsyncTimeUs);
+            }
+        }
+        else {
+            m_VsyncPhaseEstimator->addVsyncObservation(afterRender);
+        }
+    }
     m_VideoStats->renderedFrames++;
 
     // Wait until after next frame to free this one to ensure the GPU
     // doesn't stall or read garbage if the backing buffer gets returned
     // to the pool and the decoder tries to write a new frame into it
     std::swap(frame, m_DeferredFreeFrame);
-    av_frame_free(&frame);
+    m_FramePool->releaseFrame(&frame);
 
     // Drop frames if we have too many queued up for a while
-    m_FrameQueueLock.lock();
-
     int frameDropTarget;
 
     if (m_RendererAttributes & RENDERER_ATTRIBUTE_NO_BUFFERING) {
@@ -384,25 +549,22 @@ void Pacer::renderFrame(AVFrame* frame)
 
     // Catch up if we're several frames ahead
     while (m_RenderQueue.count() > frameDropTarget) {
-        AVFrame* frame = m_RenderQueue.dequeue();
+        AVFrame* frame = m_RenderQueue.pop();
+        if (frame == nullptr) {
+            // The producer displaced the frames we were going to drop
+            break;
+        }
 
-        // Drop the lock while we call av_frame_free()
-        m_FrameQueueLock.unlock();
         m_VideoStats->pacerDroppedFrames++;
-        av_frame_free(&frame);
-        m_FrameQueueLock.lock();
+        m_FramePool->releaseFrame(&frame);
     }
-
-    m_FrameQueueLock.unlock();
 }
 
-void Pacer::dropFrameForEnqueue(QQueue<AVFrame*>& queue)
+void Pacer::enqueueFrame(FrameRing& ring, AVFrame* frame)
 {
-    SDL_assert(queue.size() <= MAX_QUEUED_FRAMES);
-    if (queue.size() == MAX_QUEUED_FRAMES) {
-        AVFrame* frame = queue.dequeue();
-        av_frame_free(&frame);
-    }
+    // If the ring is full, the oldest frame is displaced to make room
+    AVFrame* displacedFrame = ring.push(frame);
+    m_FramePool->releaseFrame(&displacedFrame);
 }
 
 void Pacer::submitFrame(AVFrame* frame)
@@ -411,14 +573,11 @@ void Pacer::submitFrame(AVFrame* frame)
     SDL_assert(m_MaxVideoFps != 0);
 
     // Queue the frame and possibly wake up the render thread
-    m_FrameQueueLock.lock();
     if (m_VsyncSource != nullptr) {
-        dropFrameForEnqueue(m_PacingQueue);
-        m_PacingQueue.enqueue(frame);
-        m_FrameQueueLock.unlock();
-        m_PacingQueueNotEmpty.wakeOne();
+        m_PacingPolicy->frameSubmitted((uint64_t)frame->pkt_dts);
+        enqueueFrame(m_PacingQueue, frame);
     }
     else {
-        enqueueFrameForRenderingAndUnlock(frame);
+        enqueueFrameForRendering(frame);
     }
 }
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "../../decoder.h"
+#include "../../framepool.h"
+#include "../../frametimingtrace.h"
+#include "pacingpolicy.h"
+#include "framering.h"
 #include "../renderer.h"
 
 #include <QQueue>
-#include <QMutex>
-#include <QWaitCondition>
+
+#include <atomic>
 
 // The maximum number of frames pacer will ever hold is:
 // - 3 frames in the pacing queue
@@ -13,6 +17,11 @@
 // - 1 frame for deferred free
 #define PACER_MAX_OUTSTANDING_FRAMES (3 + 1 + 1)
 
+// The decoder stores each frame's frame number in AVFrame::opaque
+#define FRAME_NUMBER_FROM_AVFRAME(frame) ((uint32_t)(uintptr_t)(frame)->opaque)
+
+class VsyncPhaseEstimator;
+
 class IVsyncSource {
 public:
     virtual ~IVsyncSource() {}
@@ -31,13 +40,16 @@ public:
 class Pacer
 {
 public:
-    Pacer(IFFmpegRenderer* renderer, PVIDEO_STATS videoStats);
+    Pacer(IFFmpegRenderer* renderer, FramePool* framePool, FrameTimingTrace* frameTimingTrace, PVIDEO_STATS videoStats);
 
     ~Pacer();
 
     void submitFrame(AVFrame* frame);
 
-    bool initialize(SDL_Window* window, int maxVideoFps, bool enablePacing);
+    bool initialize(SDL_Window* window, int maxVideoFps, bool enablePacing, StreamingPreferences::PacingPolicy pacingPolicy);
+
+    // Returns nullptr if frame pacing is not active
+    const char* getPacingPolicyName();
 
     void signalVsync();
 
@@ -48,29 +60,39 @@ private:
 
     static int renderThread(void* context);
 
-    void handleVsync(int timeUntilNextVsyncMillis);
+    void handleVsync(int timeUntilNextVsyncMillis, uint64_t vsyncTimeUs);
+
+    void updateRenderTimePrediction(uint64_t renderTimeUs, uint64_t renderEndUs, uint64_t latchDeadlineUs);
 
-    void enqueueFrameForRenderingAndUnlock(AVFrame* frame);
+    void enqueueFrameForRendering(AVFrame* frame);
 
     void renderFrame(AVFrame* frame);
 
-    void dropFrameForEnqueue(QQueue<AVFrame*>& queue);
+    void enqueueFrame(FrameRing& ring, AVFrame* frame);
 
-    QQueue<AVFrame*> m_RenderQueue;
-    QQueue<AVFrame*> m_PacingQueue;
-    QQueue<int> m_PacingQueueHistory;
+    // The decoder thread feeds the pacing queue, which is drained by the
+    // V-sync thread. The render queue is fed by the V-sync thread (or the
+    // decoder thread without a V-sync source) and drained by the renderer.
+    FrameRing m_RenderQueue;
+    FrameRing m_PacingQueue;
     QQueue<int> m_RenderQueueHistory;
-    QMutex m_FrameQueueLock;
-    QWaitCondition m_RenderQueueNotEmpty;
-    QWaitCondition m_PacingQueueNotEmpty;
-    QWaitCondition m_VsyncSignalled;
+    SDL_sem* m_VsyncSignalled;
     SDL_Thread* m_RenderThread;
     SDL_Thread* m_VsyncThread;
     AVFrame* m_DeferredFreeFrame;
-    bool m_Stopping;
+    std::atomic<bool> m_Stopping;
 
     IVsyncSource* m_VsyncSource;
+    VsyncPhaseEstimator* m_VsyncPhaseEstimator;
+    IPacingPolicy* m_PacingPolicy;
+    bool m_LateLatchEnabled;
+    std::atomic<bool> m_RenderTimingAvailable;
+    std::atomic<uint64_t> m_PredictedRenderTimeUs;
+    std::atomic<uint64_t> m_LatchMarginUs;
+    std::atomic<uint64_t> m_LatchDeadlineUs;
     IFFmpegRenderer* m_VsyncRenderer;
+    FramePool* m_FramePool;
+    FrameTimingTrace* m_FrameTimingTrace;
     int m_MaxVideoFps;
     int m_DisplayFps;
     PVIDEO_STATS m_VideoStats;
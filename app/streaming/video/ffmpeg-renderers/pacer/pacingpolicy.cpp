@@ -0,0 +1,97 @@
+#include "pacingpolicy.h"
+
+#include <SDL.h>
+
+#include <cmath>
+
+// The adaptive policy tries to keep enough frames queued to cover
+// this many multiples of the mean frame arrival jitter.
+#define ADAPTIVE_JITTER_MULTIPLIER 2.0
+
+SmoothPacingPolicy::SmoothPacingPolicy(int maxVideoFps, int displayFps) :
+    m_MaxVideoFps(maxVideoFps),
+    m_DisplayFps(displayFps)
+{
+
+}
+
+const char* SmoothPacingPolicy::getName()
+{
+    return "Smooth";
+}
+
+int SmoothPacingPolicy::getPacingQueueTarget(int pacingQueueLength)
+{
+    // If the queue length history entries are large, be strict
+    // about dropping excess frames.
+    int frameDropTarget = 1;
+
+    // If we may get more frames per second than we can display, use
+    // frame history to drop frames only if consistently above the
+    // one queued frame mark.
+    if (m_MaxVideoFps >= m_DisplayFps) {
+        for (int queueHistoryEntry : m_PacingQueueHistory) {
+            if (queueHistoryEntry <= 1) {
+                // Be lenient as long as the queue length
+                // resolves before the end of frame history
+                frameDropTarget = 3;
+                break;
+            }
+        }
+
+        // Keep a rolling 500 ms window of pacing queue history
+        if (m_PacingQueueHistory.count() == m_DisplayFps / 2) {
+            m_PacingQueueHistory.dequeue();
+        }
+
+        m_PacingQueueHistory.enqueue(pacingQueueLength);
+    }
+
+    return frameDropTarget;
+}
+
+const char* LatestFramePacingPolicy::getName()
+{
+    return "Latest frame";
+}
+
+int LatestFramePacingPolicy::getPacingQueueTarget(int)
+{
+    // Drop everything except the newest frame
+    return 1;
+}
+
+AdaptivePacingPolicy::AdaptivePacingPolicy(int maxVideoFps, int displayFps, int maxQueuedFrames) :
+    m_ExpectedFrameIntervalUs(1000000 / maxVideoFps),
+    m_VsyncIntervalUs(1000000 / displayFps),
+    m_MaxQueuedFrames(maxQueuedFrames),
+    m_LastFrameTimeUs(0),
+    m_JitterUs(0)
+{
+
+}
+
+const char* AdaptivePacingPolicy::getName()
+{
+    return "Adaptive";
+}
+
+void AdaptivePacingPolicy::frameSubmitted(uint64_t timeUs)
+{
+    if (m_LastFrameTimeUs != 0) {
+        // Estimate the mean deviation of frame arrival from the stream's
+        // frame interval, smoothed like RTP interarrival jitter (RFC 3550)
+        double deviationUs = std::fabs((double)(timeUs - m_LastFrameTimeUs) - (double)m_ExpectedFrameIntervalUs);
+        double jitterUs = m_JitterUs.load(std::memory_order_relaxed);
+        m_JitterUs.store(jitterUs + (deviationUs - jitterUs) / 16, std::memory_order_relaxed);
+    }
+
+    m_LastFrameTimeUs = timeUs;
+}
+
+int AdaptivePacingPolicy::getPacingQueueTarget(int)
+{
+    // Keep one frame to render plus enough frames to cover the jitter
+    int jitterFrames = (int)std::ceil(m_JitterUs.load(std::memory_order_relaxed) * ADAPTIVE_JITTER_MULTIPLIER / m_VsyncIntervalUs);
+    return SDL_clamp(1 + jitterFrames, 1, m_MaxQueuedFrames);
+}
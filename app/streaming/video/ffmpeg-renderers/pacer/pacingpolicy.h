@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QQueue>
+
+#include <atomic>
+#include <cstdint>
+
+// A pacing policy decides how many decoded frames Pacer may keep queued
+// at each V-sync. Frames beyond that target are dropped oldest first, and
+// the oldest remaining frame is rendered.
+//
+// frameSubmitted() is called on the decoder thread while the other methods
+// are called on Pacer's V-sync thread, so any state shared between them
+// must be safe to access concurrently.
+class IPacingPolicy {
+public:
+    virtual ~IPacingPolicy() {}
+
+    virtual const char* getName() = 0;
+
+    // Called when the decoder submits a new frame to Pacer
+    virtual void frameSubmitted(uint64_t) {}
+
+    // Returns the number of frames that may remain in the pacing queue
+    virtual int getPacingQueueTarget(int pacingQueueLength) = 0;
+};
+
+// Drops frames only if the pacing queue has stayed above one frame for
+// a while. This smooths over jitter at the cost of extra latency.
+class SmoothPacingPolicy : public IPacingPolicy {
+public:
+    SmoothPacingPolicy(int maxVideoFps, int displayFps);
+
+    virtual const char* getName() override;
+
+    virtual int getPacingQueueTarget(int pacingQueueLength) override;
+
+private:
+    int m_MaxVideoFps;
+    int m_DisplayFps;
+    QQueue<int> m_PacingQueueHistory;
+};
+
+// Always renders the newest decoded frame at each V-sync for the
+// lowest possible latency, even if that means dropping frames.
+class LatestFramePacingPolicy : public IPacingPolicy {
+public:
+    virtual const char* getName() override;
+
+    virtual int getPacingQueueTarget(int pacingQueueLength) override;
+};
+
+// Picks the queue depth needed to absorb the frame arrival jitter that
+// has actually been measured, so it only adds latency when it must.
+class AdaptivePacingPolicy : public IPacingPolicy {
+public:
+    AdaptivePacingPolicy(int maxVideoFps, int displayFps, int maxQueuedFrames);
+
+    virtual const char* getName() override;
+
+    virtual void frameSubmitted(uint64_t timeUs) override;
+
+    virtual int getPacingQueueTarget(int pacingQueueLength) override;
+
+private:
+    uint64_t m_ExpectedFrameIntervalUs;
+    uint64_t m_VsyncIntervalUs;
+    int m_MaxQueuedFrames;
+    uint64_t m_LastFrameTimeUs;
+    std::atomic<double> m_JitterUs;
+};
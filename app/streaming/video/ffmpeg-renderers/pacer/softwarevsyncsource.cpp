@@ -0,0 +1,129 @@
+#include "softwarevsyncsource.h"
+
+#include <cmath>
+
+// PLL gains for phase and period corrections
+#define PHASE_GAIN (1.0 / 8)
+#define PERIOD_GAIN (1.0 / 64)
+
+// Observations further than this fraction of a period away
+// from the nearest predicted V-sync are ignored
+#define MAX_PHASE_ERROR 0.25
+
+// Don't let the period estimate drift too far from the display's refresh rate
+#define MAX_PERIOD_DEVIATION 0.05
+
+VsyncPhaseEstimator::VsyncPhaseEstimator(uint64_t nominalPeriodUs) :
+    m_NominalPeriodUs(nominalPeriodUs),
+    m_PeriodUs(nominalPeriodUs),
+    m_PhaseUs(0),
+    m_HasPhase(false),
+    m_AcceptedObservations(0),
+    m_RejectedObservations(0)
+{
+    SDL_assert(nominalPeriodUs > 0);
+}
+
+void VsyncPhaseEstimator::addVsyncObservation(uint64_t timeUs)
+{
+    std::lock_guard lg { m_Lock };
+
+    if (!m_HasPhase) {
+        // The first observation just sets the phase
+        m_PhaseUs = timeUs;
+        m_HasPhase = true;
+        m_AcceptedObservations++;
+        return;
+    }
+
+    // Find the V-sync we predicted closest to this observation
+    double elapsedUs = (double)timeUs - m_PhaseUs;
+    double periods = std::round(elapsedUs / m_PeriodUs);
+    double errorUs = elapsedUs - periods * m_PeriodUs;
+
+    if (periods < 1 || std::fabs(errorUs) > m_PeriodUs * MAX_PHASE_ERROR) {
+        // This wasn't close enough to a V-sync to be useful
+        m_RejectedObservations++;
+        return;
+    }
+
+    // Move the phase reference up to this V-sync, correcting part of the
+    // error. The period is adjusted by a smaller fraction of the error
+    // spread across the elapsed periods to correct for clock drift.
+    m_PhaseUs += periods * m_PeriodUs + errorUs * PHASE_GAIN;
+    m_PeriodUs += errorUs * PERIOD_GAIN / periods;
+    m_PeriodUs = SDL_clamp(m_PeriodUs,
+                           m_NominalPeriodUs * (1 - MAX_PERIOD_DEVIATION),
+                           m_NominalPeriodUs * (1 + MAX_PERIOD_DEVIATION));
+    m_AcceptedObservations++;
+}
+
+uint64_t VsyncPhaseEstimator::getNextVsyncTime(uint64_t timeUs)
+{
+    std::lock_guard lg { m_Lock };
+
+    if (!m_HasPhase) {
+        // With no observations yet, just tick at the nominal rate
+        m_PhaseUs = timeUs;
+        m_HasPhase = true;
+    }
+
+    double periods = std::floor(((double)timeUs - m_PhaseUs) / m_PeriodUs) + 1;
+    return (uint64_t)(m_PhaseUs + periods * m_PeriodUs);
+}
+
+uint64_t VsyncPhaseEstimator::getPeriodUs()
+{
+    std::lock_guard lg { m_Lock };
+    return (uint64_t)m_PeriodUs;
+}
+
+int VsyncPhaseEstimator::getAcceptedObservations()
+{
+    std::lock_guard lg { m_Lock };
+    return m_AcceptedObservations;
+}
+
+int VsyncPhaseEstimator::getRejectedObservations()
+{
+    std::lock_guard lg { m_Lock };
+    return m_RejectedObservations;
+}
+
+SoftwareVsyncSource::SoftwareVsyncSource(VsyncPhaseEstimator* estimator) :
+    m_Estimator(estimator),
+    m_LastVsyncTimeUs(0)
+{
+
+}
+
+bool SoftwareVsyncSource::initialize(SDL_Window*, int displayFps)
+{
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Using software V-sync source at %d Hz",
+                displayFps);
+    return true;
+}
+
+bool SoftwareVsyncSource::isAsync()
+{
+    return false;
+}
+
+void SoftwareVsyncSource::waitForVsync()
+{
+    uint64_t now = LiGetMicroseconds();
+    uint64_t nextVsyncTimeUs = m_Estimator->getNextVsyncTime(now);
+
+    // If the phase estimate moved backwards slightly, don't
+    // signal the same V-sync period twice.
+    if (nextVsyncTimeUs < m_LastVsyncTimeUs + m_Estimator->getPeriodUs() / 2) {
+        nextVsyncTimeUs = m_Estimator->getNextVsyncTime(nextVsyncTimeUs);
+    }
+
+    if (nextVsyncTimeUs > now) {
+        SDL_Delay((Uint32)((nextVsyncTimeUs - now + 500) / 1000));
+    }
+
+    m_LastVsyncTimeUs = nextVsyncTimeUs;
+}
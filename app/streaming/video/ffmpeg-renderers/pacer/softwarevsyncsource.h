@@ -0,0 +1,65 @@
+#pragma once
+
+#include "pacer.h"
+
+#include <mutex>
+
+// Tracks the phase and period of the display's refresh cycle from
+// timestamps that are expected to land close to a V-sync (such as the
+// time a blocking buffer swap or page flip returns). A simple PLL pulls
+// the estimate toward each observation, and observations that are too
+// far from any predicted V-sync are ignored as noise.
+//
+// This class never reads a clock itself. All times are passed in by the
+// caller, so it can be driven by a simulated clock with no display.
+class VsyncPhaseEstimator
+{
+public:
+    explicit VsyncPhaseEstimator(uint64_t nominalPeriodUs);
+
+    // Adds a timestamp observed near a V-sync
+    void addVsyncObservation(uint64_t timeUs);
+
+    // Returns the predicted time of the first V-sync after timeUs
+    uint64_t getNextVsyncTime(uint64_t timeUs);
+
+    uint64_t getPeriodUs();
+
+    // Number of observations accepted and rejected by the PLL
+    int getAcceptedObservations();
+    int getRejectedObservations();
+
+private:
+    std::mutex m_Lock;
+    double m_NominalPeriodUs;
+    double m_PeriodUs;
+    double m_PhaseUs;
+    bool m_HasPhase;
+    int m_AcceptedObservations;
+    int m_RejectedObservations;
+};
+
+// A synchronous V-sync source for platforms without a native V-sync
+// notification (X11 and KMSDRM). It sleeps until the next V-sync
+// predicted by a VsyncPhaseEstimator, which Pacer keeps in sync
+// using V-sync timestamps from the renderer.
+//
+// For renderers without V-sync timestamps, Pacer can only use the
+// render completion times of frames it presents. Those only follow
+// the display when presenting blocks until the flip, so this is only
+// used for them if SOFTWARE_VSYNC_SOURCE=1 is set.
+class SoftwareVsyncSource : public IVsyncSource
+{
+public:
+    SoftwareVsyncSource(VsyncPhaseEstimator* estimator);
+
+    virtual bool initialize(SDL_Window* window, int displayFps) override;
+
+    virtual bool isAsync() override;
+
+    virtual void waitForVsync() override;
+
+private:
+    VsyncPhaseEstimator* m_Estimator;
+    uint64_t m_LastVsyncTimeUs;
+};
@@ -869,6 +869,7 @@ void PlVkRenderer::renderFrame(AVFrame *frame)
     }
 
     // Submit the frame for display and swap buffers
+    markPresentStart();
     m_HasPendingSwapchainFrame = false;
     if (!pl_swapchain_submit_frame(m_Swapchain)) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
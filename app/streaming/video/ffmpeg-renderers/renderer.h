@@ -59,6 +59,10 @@ typedef EGLDisplay (EGLAPIENTRYP PFNEGLGETPLATFORMDISPLAYPROC) (EGLenum platform
 typedef uint64_t EGLuint64KHR;
 #endif
 
+#ifndef EGL_CHROMIUM_sync_control
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLGETSYNCVALUESCHROMIUMPROC) (EGLDisplay dpy, EGLSurface surface, EGLuint64KHR *ust, EGLuint64KHR *msc, EGLuint64KHR *sbc);
+#endif
+
 #if !defined(EGL_KHR_image) || !defined(EGL_EGLEXT_PROTOTYPES)
 // EGL_KHR_image technically uses EGLImageKHR instead of EGLImage, but they're compatible
 // so we swap them here to avoid mixing them all over the place
@@ -136,6 +140,7 @@ private:
 #define RENDERER_ATTRIBUTE_HDR_SUPPORT 0x04
 #define RENDERER_ATTRIBUTE_NO_BUFFERING 0x08
 #define RENDERER_ATTRIBUTE_FORCE_PACING 0x10
+#define RENDERER_ATTRIBUTE_VSYNC_TIMESTAMPS 0x20
 
 class IFFmpegRenderer : public Overlay::IOverlayRenderer {
 public:
@@ -153,6 +158,7 @@ public:
         VDPAU,
         VTSampleLayer,
         VTMetal,
+        Null,
     };
 
     IFFmpegRenderer(RendererType type) : m_Type(type) {}
@@ -263,6 +269,13 @@ public:
         return true;
     }
 
+    virtual bool isConcurrentInitializationSupported() {
+        // Most renderers use the window or global graphics API state
+        // during initialization and destruction, so by default we
+        // serialize them when test decoders are probed in parallel.
+        return false;
+    }
+
     virtual AVPixelFormat getPreferredPixelFormat(int videoFormat) {
         if (videoFormat & VIDEO_FORMAT_MASK_10BIT) {
             return (videoFormat & VIDEO_FORMAT_MASK_YUV444) ?
@@ -301,6 +314,25 @@ public:
         // preparations might include clearing the window.
     }
 
+    virtual void notifyFrameDecoded(AVFrame*) {
+        // Called on the decoder thread before a frame is queued for
+        // rendering. Renderers may start work on the frame here that
+        // doesn't need to wait until it's time to display it.
+    }
+
+    virtual void addRendererStats(PVIDEO_STATS) {
+        // Called on the decoder thread at the end of each stats window
+        // for renderers to add (and reset) any counters they keep.
+    }
+
+    // Renderers that set RENDERER_ATTRIBUTE_VSYNC_TIMESTAMPS return the time
+    // of the display's most recent V-sync (in the LiGetMicroseconds() timebase)
+    // as reported by the display driver. Called on the render thread.
+    virtual bool getLastVsyncTime(uint64_t*) {
+        // V-sync timestamps are not available by default
+        return false;
+    }
+
     RendererType getRendererType() {
         return m_Type;
     }
@@ -334,6 +366,8 @@ public:
             return "VideoToolbox (AVSampleBufferDisplayLayer)";
         case RendererType::VTMetal:
             return "VideoToolbox (Metal)";
+        case RendererType::Null:
+            return "Null (headless)";
         }
     }
 
@@ -487,6 +521,18 @@ public:
         return true;
     }
 
+    // Called by renderFrame() once it has submitted all of its work for the
+    // frame, right before presenting (which may block until V-sync)
+    void markPresentStart() {
+        m_LastPresentStartTimeUs = LiGetMicroseconds();
+    }
+
+    // Returns the time of the last markPresentStart() call or 0 if the
+    // renderer doesn't report it. Must be called on the render thread.
+    uint64_t getLastPresentStartTimeUs() {
+        return m_LastPresentStartTimeUs;
+    }
+
     // IOverlayRenderer
     virtual void notifyOverlayUpdated(Overlay::OverlayType) override {
         // Nothing
@@ -540,4 +586,6 @@ private:
     AVColorTransferCharacteristic m_LastColorTrc = AVCOL_TRC_UNSPECIFIED;
     AVColorSpace m_LastColorSpace = AVCOL_SPC_UNSPECIFIED;
     AVChromaLocation m_LastChromaLocation = AVCHROMA_LOC_UNSPECIFIED;
+
+    uint64_t m_LastPresentStartTimeUs = 0;
 };
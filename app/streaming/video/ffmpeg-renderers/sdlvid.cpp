@@ -18,6 +18,7 @@ SdlRenderer::SdlRenderer()
       m_Renderer(nullptr),
       m_Texture(nullptr),
       m_NeedsYuvToRgbConversion(false),
+      m_UseYuvToRgbConverter(false),
       m_SwsContext(nullptr),
       m_RgbFrame(av_frame_alloc()),
       m_SwFrameMapper(this)
@@ -227,12 +228,9 @@ void SdlRenderer::renderOverlay(Overlay::OverlayType type)
         // If a new surface has been created for updated overlay data, convert it into a texture.
         // NB: We have to do this conversion at render-time because we can only interact
         // with the renderer on a single thread.
-        SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type);
+        SDL_Rect dirtyRect;
+        SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type, &dirtyRect);
         if (newSurface != nullptr) {
-            if (m_OverlayTextures[type] != nullptr) {
-                SDL_DestroyTexture(m_OverlayTextures[type]);
-            }
-
             if (type == Overlay::OverlayStatusUpdate) {
                 // Bottom Left
                 SDL_Rect viewportRect;
@@ -256,12 +254,33 @@ void SdlRenderer::renderOverlay(Overlay::OverlayType type)
             m_OverlayRects[type].w = newSurface->w;
             m_OverlayRects[type].h = newSurface->h;
 
-            m_OverlayTextures[type] = SDL_CreateTextureFromSurface(m_Renderer, newSurface);
-            SDL_FreeSurface(newSurface);
+            // If the existing texture matches the new surface, just update the part that changed
+            Uint32 textureFormat;
+            int textureWidth, textureHeight;
+            if (m_OverlayTextures[type] != nullptr &&
+                    SDL_QueryTexture(m_OverlayTextures[type], &textureFormat, nullptr, &textureWidth, &textureHeight) == 0 &&
+                    textureFormat == newSurface->format->format &&
+                    textureWidth == newSurface->w && textureHeight == newSurface->h &&
+                    (SDL_RectEmpty(&dirtyRect) ||
+                     SDL_UpdateTexture(m_OverlayTextures[type], &dirtyRect,
+                                       (Uint8*)newSurface->pixels +
+                                       dirtyRect.y * newSurface->pitch +
+                                       dirtyRect.x * newSurface->format->BytesPerPixel,
+                                       newSurface->pitch) == 0)) {
+                SDL_FreeSurface(newSurface);
+            }
+            else {
+                if (m_OverlayTextures[type] != nullptr) {
+                    SDL_DestroyTexture(m_OverlayTextures[type]);
+                }
+
+                m_OverlayTextures[type] = SDL_CreateTextureFromSurface(m_Renderer, newSurface);
+                SDL_FreeSurface(newSurface);
 
-            if (m_OverlayTextures[type]) {
-                // Overlays are always drawn at exact size
-                SDL_SetTextureScaleMode(m_OverlayTextures[type], SDL_ScaleModeNearest);
+                if (m_OverlayTextures[type]) {
+                    // Overlays are always drawn at exact size
+                    SDL_SetTextureScaleMode(m_OverlayTextures[type], SDL_ScaleModeNearest);
+                }
             }
         }
 
@@ -339,7 +358,21 @@ ReadbackRetry:
             break;
         }
 
-        if (m_NeedsYuvToRgbConversion) {
+        m_UseYuvToRgbConverter = false;
+        if (m_NeedsYuvToRgbConversion && YuvToRgbConverter::isFormatSupported((AVPixelFormat)frame->format)) {
+            std::array<float, 9> cscMatrix;
+            std::array<float, 3> offsets;
+            getFramePremultipliedCscConstants(frame, cscMatrix, offsets);
+
+            // Prefer our own SIMD converters over swscale for formats they handle.
+            // Like swscale, they split each frame across up to 4 threads, and the
+            // benchmark's color conversion test checks them against swscale's output.
+            m_UseYuvToRgbConverter = m_YuvToRgbConverter.initialize((AVPixelFormat)frame->format,
+                                                                    cscMatrix, offsets,
+                                                                    getFrameBitsPerChannel(frame));
+        }
+
+        if (m_NeedsYuvToRgbConversion && !m_UseYuvToRgbConverter) {
             m_RgbFrame->width = frame->width;
             m_RgbFrame->height = frame->height;
             m_RgbFrame->format = AV_PIX_FMT_BGR0;
@@ -527,6 +560,24 @@ ReadbackRetry:
             SDL_UnlockTexture(m_Texture);
         }
     }
+    else if (m_UseYuvToRgbConverter) {
+        // We have a pixel format that SDL doesn't natively support, but our
+        // own converter can write RGB pixels directly into the texture.
+        uint8_t* pixels;
+        int texturePitch;
+
+        err = SDL_LockTexture(m_Texture, nullptr, (void**)&pixels, &texturePitch);
+        if (err < 0) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "SDL_LockTexture() failed: %s",
+                         SDL_GetError());
+            goto Exit;
+        }
+
+        m_YuvToRgbConverter.convertFrame(frame, pixels, texturePitch);
+
+        SDL_UnlockTexture(m_Texture);
+    }
     else {
         // We have a pixel format that SDL doesn't natively support, so we must use
         // swscale to convert the YUV frame into an RGB frame to upload to the GPU.
@@ -598,6 +649,7 @@ ReadbackRetry:
         renderOverlay((Overlay::OverlayType)i);
     }
 
+    markPresentStart();
     SDL_RenderPresent(m_Renderer);
 
 Exit:
@@ -644,6 +696,20 @@ bool SdlRenderer::testRenderFrame(AVFrame* frame)
     return true;
 }
 
+void SdlRenderer::notifyFrameDecoded(AVFrame* frame)
+{
+    // Start reading back hwframes now, so the readback of this frame can
+    // overlap with the texture upload of the frame before it.
+    if (frame->hw_frames_ctx != nullptr && frame->format != AV_PIX_FMT_CUDA) {
+        m_SwFrameMapper.startReadback(frame);
+    }
+}
+
+void SdlRenderer::addRendererStats(PVIDEO_STATS stats)
+{
+    m_SwFrameMapper.addReadbackStats(stats);
+}
+
 bool SdlRenderer::notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO info)
 {
     // We can transparently handle size and display changes, except Windows where
@@ -2,6 +2,7 @@
 
 #include "renderer.h"
 #include "swframemapper.h"
+#include "yuvconverter.h"
 
 #ifdef HAVE_CUDA
 #include "cuda.h"
@@ -23,6 +24,8 @@ public:
     virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
     virtual bool testRenderFrame(AVFrame* frame) override;
     virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO) override;
+    virtual void notifyFrameDecoded(AVFrame* frame) override;
+    virtual void addRendererStats(PVIDEO_STATS stats) override;
 
 private:
     void renderOverlay(Overlay::OverlayType type);
@@ -37,6 +40,8 @@ private:
 
     // Used for CPU conversion of YUV to RGB if needed
     bool m_NeedsYuvToRgbConversion;
+    bool m_UseYuvToRgbConverter;
+    YuvToRgbConverter m_YuvToRgbConverter;
     SwsContext* m_SwsContext;
     AVFrame* m_RgbFrame;
 
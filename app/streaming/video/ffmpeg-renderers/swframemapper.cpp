@@ -1,13 +1,42 @@
 #include "swframemapper.h"
+#include "pacer/pacer.h"
+
+// Enough for every frame the pacer can hold plus the one being rendered
+#define MAX_POOLED_SW_FRAMES (PACER_MAX_OUTSTANDING_FRAMES + 1)
 
 SwFrameMapper::SwFrameMapper(IFFmpegRenderer* renderer)
     : m_Renderer(renderer),
       m_VideoFormat(0),
       m_SwPixelFormat(AV_PIX_FMT_NONE),
-      m_MapFrame(false)
+      m_MapFrame(false),
+      m_ReadbackThread(nullptr),
+      m_ReadbackThreadStopping(false),
+      m_TotalReadbackTimeUs(0),
+      m_ReadbackFrames(0)
 {
 }
 
+SwFrameMapper::~SwFrameMapper()
+{
+    // Finish any pending readbacks
+    if (m_ReadbackThread != nullptr) {
+        {
+            std::lock_guard lg { m_ReadbackLock };
+            m_ReadbackThreadStopping = true;
+        }
+        m_ReadbackQueueNotEmpty.notify_all();
+        SDL_WaitThread(m_ReadbackThread, nullptr);
+    }
+
+    // All frames holding our readbacks must be gone by now
+    SDL_assert(m_LiveReadbacks.empty());
+
+    // Any swframes still referencing pooled buffers keep them alive
+    for (AVFrame* frame : m_FramePool) {
+        av_frame_free(&frame);
+    }
+}
+
 void SwFrameMapper::setVideoFormat(int videoFormat)
 {
     m_VideoFormat = videoFormat;
@@ -99,28 +128,93 @@ Exit:
     return true;
 }
 
-AVFrame* SwFrameMapper::getSwFrameFromHwFrame(AVFrame* hwFrame)
+AVFrame* SwFrameMapper::getPooledFrame(const AVFrame* hwFrame)
 {
-    int err;
+    std::lock_guard lg { m_ReadbackLock };
 
-    // setVideoFormat() must have been called before our first frame
-    SDL_assert(m_VideoFormat != 0);
+    for (auto it = m_FramePool.begin(); it != m_FramePool.end();) {
+        AVFrame* frame = *it;
 
-    if (m_SwPixelFormat == AV_PIX_FMT_NONE) {
-        SDL_assert(hwFrame->hw_frames_ctx != nullptr);
-        if (!initializeReadBackFormat(hwFrame->hw_frames_ctx, hwFrame)) {
-            return nullptr;
+        if (av_frame_is_writable(frame)) {
+            if (frame->format == m_SwPixelFormat &&
+                    frame->width == hwFrame->width &&
+                    frame->height == hwFrame->height) {
+                // Hand out a new reference to the pooled buffers
+                return av_frame_clone(frame);
+            }
+
+            // Drop unused frames left over from a previous format or size
+            av_frame_free(&frame);
+            it = m_FramePool.erase(it);
+            continue;
+        }
+
+        it++;
+    }
+
+    if (m_FramePool.size() >= MAX_POOLED_SW_FRAMES) {
+        // Every pooled frame is in use, so av_hwframe_transfer_data()
+        // will allocate a one-off frame instead.
+        AVFrame* frame = av_frame_alloc();
+        if (frame != nullptr) {
+            frame->format = m_SwPixelFormat;
         }
+        return frame;
+    }
+
+    AVFrame* frame = av_frame_alloc();
+    if (frame == nullptr) {
+        return nullptr;
     }
 
-    AVFrame* swFrame = av_frame_alloc();
-    if (swFrame == nullptr) {
+    frame->format = m_SwPixelFormat;
+    frame->width = hwFrame->width;
+    frame->height = hwFrame->height;
+
+    int err = av_frame_get_buffer(frame, 0);
+    if (err < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "av_frame_get_buffer() failed: %d",
+                     err);
+        av_frame_free(&frame);
         return nullptr;
     }
 
-    swFrame->format = m_SwPixelFormat;
+    m_FramePool.push_back(frame);
+    return av_frame_clone(frame);
+}
+
+AVFrame* SwFrameMapper::readBackFrame(AVFrame* hwFrame)
+{
+    int err;
+
+    // setVideoFormat() must have been called before our first frame
+    SDL_assert(m_VideoFormat != 0);
+
+    {
+        // Readbacks may be started on the decoder thread while the
+        // render thread is also reading back a frame synchronously.
+        std::lock_guard lg { m_FormatLock };
+
+        if (m_SwPixelFormat == AV_PIX_FMT_NONE) {
+            SDL_assert(hwFrame->hw_frames_ctx != nullptr);
+            if (!initializeReadBackFormat(hwFrame->hw_frames_ctx, hwFrame)) {
+                return nullptr;
+            }
+        }
+    }
+
+    uint64_t startTimeUs = LiGetMicroseconds();
+    AVFrame* swFrame;
 
     if (m_MapFrame) {
+        swFrame = av_frame_alloc();
+        if (swFrame == nullptr) {
+            return nullptr;
+        }
+
+        swFrame->format = m_SwPixelFormat;
+
         // We don't use AV_HWFRAME_MAP_DIRECT here because it can cause huge
         // performance penalties on Intel hardware with VAAPI due to mappings
         // being uncached memory.
@@ -134,6 +228,11 @@ AVFrame* SwFrameMapper::getSwFrameFromHwFrame(AVFrame* hwFrame)
         }
     }
     else {
+        swFrame = getPooledFrame(hwFrame);
+        if (swFrame == nullptr) {
+            return nullptr;
+        }
+
         err = av_hwframe_transfer_data(swFrame, hwFrame, 0);
         if (err < 0) {
             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -149,5 +248,145 @@ AVFrame* SwFrameMapper::getSwFrameFromHwFrame(AVFrame* hwFrame)
         av_frame_copy_props(swFrame, hwFrame);
     }
 
+    m_TotalReadbackTimeUs += LiGetMicroseconds() - startTimeUs;
+    m_ReadbackFrames++;
+
     return swFrame;
 }
+
+void SwFrameMapper::startReadback(AVFrame* hwFrame)
+{
+    SDL_assert(hwFrame->hw_frames_ctx != nullptr);
+
+    if (m_ReadbackThread == nullptr) {
+        m_ReadbackThread = SDL_CreateThread(SwFrameMapper::readbackThread, "SwFrameReadback", this);
+        if (m_ReadbackThread == nullptr) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Unable to create hwframe readback thread: %s",
+                         SDL_GetError());
+            return;
+        }
+    }
+
+    // The worker takes its own reference to the hwframe. This must
+    // happen before we attach the readback to opaque_ref to avoid a cycle.
+    AVFrame* readbackFrame = av_frame_clone(hwFrame);
+    if (readbackFrame == nullptr) {
+        return;
+    }
+
+    auto readback = new Readback { this, readbackFrame, nullptr, false };
+    AVBufferRef* readbackRef = av_buffer_create((uint8_t*)readback, sizeof(*readback),
+                                                freeReadback,
+                                                hwFrame->opaque_ref, // Chain any existing buffer
+                                                0);
+    if (readbackRef == nullptr) {
+        av_frame_free(&readbackFrame);
+        delete readback;
+        return;
+    }
+
+    // The hwframe owns the readback (and its chained buffers) from here on
+    hwFrame->opaque_ref = readbackRef;
+
+    AVBufferRef* workerRef = av_buffer_ref(readbackRef);
+    if (workerRef == nullptr) {
+        // getSwFrameFromHwFrame() won't find this readback
+        // and will read back the frame synchronously instead.
+        av_frame_free(&readback->hwFrame);
+        return;
+    }
+
+    {
+        std::lock_guard lg { m_ReadbackLock };
+        m_LiveReadbacks.insert(readback);
+        m_ReadbackQueue.push_back(workerRef);
+    }
+    m_ReadbackQueueNotEmpty.notify_one();
+}
+
+int SwFrameMapper::readbackThread(void* context)
+{
+    auto me = (SwFrameMapper*)context;
+
+    for (;;) {
+        AVBufferRef* readbackRef;
+
+        {
+            std::unique_lock lock { me->m_ReadbackLock };
+            me->m_ReadbackQueueNotEmpty.wait(lock, [me] {
+                return me->m_ReadbackThreadStopping || !me->m_ReadbackQueue.empty();
+            });
+
+            if (me->m_ReadbackQueue.empty()) {
+                // We're stopping and the queue is drained
+                break;
+            }
+
+            readbackRef = me->m_ReadbackQueue.front();
+            me->m_ReadbackQueue.pop_front();
+        }
+
+        auto readback = (Readback*)readbackRef->data;
+        AVFrame* swFrame = me->readBackFrame(readback->hwFrame);
+        av_frame_free(&readback->hwFrame);
+
+        {
+            std::lock_guard lg { me->m_ReadbackLock };
+            readback->swFrame = swFrame;
+            readback->complete = true;
+        }
+        me->m_ReadbackCompleted.notify_all();
+
+        // This may free the readback if the hwframe has already been freed
+        av_buffer_unref(&readbackRef);
+    }
+
+    return 0;
+}
+
+void SwFrameMapper::freeReadback(void* opaque, uint8_t* data)
+{
+    auto readback = (Readback*)data;
+
+    // The hwframe and the worker are both done with the readback
+    SDL_assert(readback->hwFrame == nullptr);
+    {
+        std::lock_guard lg { readback->mapper->m_ReadbackLock };
+        readback->mapper->m_LiveReadbacks.erase(readback);
+    }
+    av_frame_free(&readback->swFrame);
+    delete readback;
+
+    // Free any chained buffers
+    av_buffer_unref((AVBufferRef**)&opaque);
+}
+
+AVFrame* SwFrameMapper::getSwFrameFromHwFrame(AVFrame* hwFrame)
+{
+    // If this frame's readback was started when it was decoded,
+    // we just need to wait for it to finish (if it hasn't already).
+    if (hwFrame->opaque_ref != nullptr) {
+        std::unique_lock lock { m_ReadbackLock };
+        auto readback = (Readback*)hwFrame->opaque_ref->data;
+
+        if (m_LiveReadbacks.count(readback) != 0) {
+            m_ReadbackCompleted.wait(lock, [readback] { return readback->complete; });
+            if (readback->swFrame == nullptr) {
+                return nullptr;
+            }
+
+            // The caller gets its own reference to the swframe
+            return av_frame_clone(readback->swFrame);
+        }
+    }
+
+    // Otherwise, we'll do the readback synchronously
+    return readBackFrame(hwFrame);
+}
+
+void SwFrameMapper::addReadbackStats(PVIDEO_STATS stats)
+{
+    stats->totalReadbackTimeUs += m_TotalReadbackTimeUs.exchange(0);
+    stats->readbackFrames += m_ReadbackFrames.exchange(0);
+}
@@ -2,18 +2,60 @@
 
 #include "renderer.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <vector>
+
 class SwFrameMapper
 {
 public:
     explicit SwFrameMapper(IFFmpegRenderer* renderer);
+    ~SwFrameMapper();
     void setVideoFormat(int videoFormat);
+
+    // Begins reading back the hwframe on a worker thread, so the swframe
+    // is usually ready by the time getSwFrameFromHwFrame() is called.
+    void startReadback(AVFrame* hwFrame);
     AVFrame* getSwFrameFromHwFrame(AVFrame* hwFrame);
 
+    void addReadbackStats(PVIDEO_STATS stats);
+
 private:
     bool initializeReadBackFormat(AVBufferRef* hwFrameCtxRef, AVFrame* testFrame);
+    AVFrame* readBackFrame(AVFrame* hwFrame);
+    AVFrame* getPooledFrame(const AVFrame* hwFrame);
+    static int readbackThread(void* context);
+    static void freeReadback(void* opaque, uint8_t* data);
 
     IFFmpegRenderer* m_Renderer;
     int m_VideoFormat;
+    std::mutex m_FormatLock;
     enum AVPixelFormat m_SwPixelFormat;
     bool m_MapFrame;
+
+    // A Readback is attached to each hwframe's opaque_ref when its readback
+    // is started and owns the resulting swframe until the hwframe is freed.
+    struct Readback {
+        SwFrameMapper* mapper;
+        AVFrame* hwFrame; // Held by the worker until the readback is complete
+        AVFrame* swFrame;
+        bool complete;
+    };
+    std::mutex m_ReadbackLock;
+    std::condition_variable m_ReadbackQueueNotEmpty;
+    std::condition_variable m_ReadbackCompleted;
+    std::deque<AVBufferRef*> m_ReadbackQueue;
+    std::set<Readback*> m_LiveReadbacks;
+    SDL_Thread* m_ReadbackThread;
+    bool m_ReadbackThreadStopping;
+
+    // Preallocated swframes for av_hwframe_transfer_data(). A pooled frame
+    // is free again once every reference we've handed out is released.
+    std::vector<AVFrame*> m_FramePool;
+
+    std::atomic<uint64_t> m_TotalReadbackTimeUs;
+    std::atomic<uint32_t> m_ReadbackFrames;
 };
@@ -580,6 +580,16 @@ VAAPIRenderer::prepareDecoderContextInGetFormat(AVCodecContext*, AVPixelFormat)
     return true;
 }
 
+void
+VAAPIRenderer::addRendererStats(PVIDEO_STATS stats)
+{
+#ifdef HAVE_EGL
+    m_EglImageFactory.addCacheStats(stats);
+#else
+    (void)stats;
+#endif
+}
+
 bool
 VAAPIRenderer::isDirectRenderingSupported()
 {
@@ -671,13 +681,56 @@ void VAAPIRenderer::notifyOverlayUpdated(Overlay::OverlayType type)
         return;
     }
 
-    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type);
+    SDL_Rect dirtyRect;
+    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type, &dirtyRect);
     bool overlayEnabled = Session::get()->getOverlayManager().isOverlayEnabled(type);
     if (newSurface == nullptr && overlayEnabled) {
         // There's no updated surface and the overlay is enabled, so just leave the old surface alone.
         return;
     }
 
+    // If the overlay is still the same size, we only need to update the part that changed.
+    // We can only write to the image if the render thread doesn't currently own it.
+    if (newSurface != nullptr && overlayEnabled) {
+        SDL_LockMutex(m_OverlayMutex);
+        if (m_OverlayImage[type].image_id != 0 &&
+                m_OverlayImage[type].width == newSurface->w &&
+                m_OverlayImage[type].height == newSurface->h) {
+            status = VA_STATUS_SUCCESS;
+            if (!SDL_RectEmpty(&dirtyRect)) {
+                void* imagePixels;
+                status = vaMapBuffer(vaDeviceContext->display, m_OverlayImage[type].buf, &imagePixels);
+                if (status == VA_STATUS_SUCCESS) {
+                    SDL_ConvertPixels(dirtyRect.w, dirtyRect.h, newSurface->format->format,
+                                      (uint8_t*)newSurface->pixels +
+                                          dirtyRect.y * newSurface->pitch +
+                                          dirtyRect.x * newSurface->format->BytesPerPixel,
+                                      newSurface->pitch,
+                                      m_OverlaySdlPixelFormat,
+                                      (uint8_t*)imagePixels +
+                                          dirtyRect.y * m_OverlayImage[type].pitches[0] +
+                                          dirtyRect.x * SDL_BYTESPERPIXEL(m_OverlaySdlPixelFormat),
+                                      (int)m_OverlayImage[type].pitches[0]);
+                    status = vaUnmapBuffer(vaDeviceContext->display, m_OverlayImage[type].buf);
+                }
+            }
+            SDL_UnlockMutex(m_OverlayMutex);
+
+            if (status == VA_STATUS_SUCCESS) {
+                SDL_FreeSurface(newSurface);
+                return;
+            }
+
+            // Fall through to replace the image entirely
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Failed to update overlay image in place: %d",
+                         status);
+        }
+        else {
+            SDL_UnlockMutex(m_OverlayMutex);
+        }
+    }
+
     // Destroy the old image and subpicture
     // NB: The mutex ensures the overlay is not currently being read for rendering.
     // NB 2: It is safe to unlock here because this thread is the only surface producer.
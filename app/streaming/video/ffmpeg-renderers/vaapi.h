@@ -67,6 +67,7 @@ public:
     virtual int getDecoderCapabilities() override;
     virtual void notifyOverlayUpdated(Overlay::OverlayType) override;
     virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO) override;
+    virtual void addRendererStats(PVIDEO_STATS stats) override;
 
 #ifdef HAVE_EGL
     virtual bool canExportEGL() override;
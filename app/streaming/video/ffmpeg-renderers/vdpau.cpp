@@ -371,13 +371,54 @@ void VDPAURenderer::notifyOverlayUpdated(Overlay::OverlayType type)
 {
     VdpStatus status;
 
-    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type);
+    SDL_Rect dirtyRect;
+    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type, &dirtyRect);
     bool overlayEnabled = Session::get()->getOverlayManager().isOverlayEnabled(type);
     if (newSurface == nullptr && overlayEnabled) {
         // There's no updated surface and the overlay is enabled, so just leave the old surface alone.
         return;
     }
 
+    // If the overlay is still the same size, we only need to update the part that changed.
+    // NB: The mutex ensures the surface is not currently being read for rendering.
+    if (newSurface != nullptr && overlayEnabled) {
+        SDL_LockMutex(m_OverlayMutex);
+        if (m_OverlaySurface[type] != 0 &&
+                m_OverlayRect[type].x1 - m_OverlayRect[type].x0 == (uint32_t)newSurface->w &&
+                m_OverlayRect[type].y1 - m_OverlayRect[type].y0 == (uint32_t)newSurface->h) {
+            status = VDP_STATUS_OK;
+            if (!SDL_RectEmpty(&dirtyRect)) {
+                const void* dirtyPixels = (uint8_t*)newSurface->pixels +
+                                          dirtyRect.y * newSurface->pitch +
+                                          dirtyRect.x * newSurface->format->BytesPerPixel;
+                VdpRect destinationRect;
+                destinationRect.x0 = dirtyRect.x;
+                destinationRect.y0 = dirtyRect.y;
+                destinationRect.x1 = dirtyRect.x + dirtyRect.w;
+                destinationRect.y1 = dirtyRect.y + dirtyRect.h;
+
+                status = m_VdpBitmapSurfacePutBitsNative(m_OverlaySurface[type],
+                                                         &dirtyPixels,
+                                                         (const uint32_t*)&newSurface->pitch,
+                                                         &destinationRect);
+            }
+            SDL_UnlockMutex(m_OverlayMutex);
+
+            if (status == VDP_STATUS_OK) {
+                SDL_FreeSurface(newSurface);
+                return;
+            }
+
+            // Fall through to replace the surface entirely
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "VdpBitmapSurfacePutBitsNative() failed: %s",
+                         m_VdpGetErrorString(status));
+        }
+        else {
+            SDL_UnlockMutex(m_OverlayMutex);
+        }
+    }
+
     // Destroy the old surface
     // NB: The mutex ensures the surface is not currently being read for rendering.
     // NB 2: It is safe to unlock here because this thread is the only surface producer.
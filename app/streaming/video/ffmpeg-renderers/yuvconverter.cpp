@@ -0,0 +1,718 @@
+#include "yuvconverter.h"
+
+#include "utils.h"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+// MSVC allows use of any intrinsic without special compiler flags
+#define HAVE_X86_KERNELS
+#define TARGET_SSE41
+#define TARGET_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+// We only build the NEON kernels for AArch64 because they use instructions
+// like UZP1/ZIP1 on full Q registers which aren't available on AArch32.
+#define HAVE_NEON_KERNELS
+#include <arm_neon.h>
+#endif
+
+// Number of fractional bits in the fixed-point coefficients. This is small enough
+// that a 10-bit sample multiplied by the largest coefficient fits in 32 bits.
+#define COEFFICIENT_SHIFT 14
+#define COEFFICIENT_ROUND (1 << (COEFFICIENT_SHIFT - 1))
+
+#define ALPHA_MASK 0xFF000000
+
+// More threads than this just contend for memory bandwidth
+#define MAX_THREADS 16
+
+namespace {
+
+enum RowFormat {
+    RowFormatNV12,
+    RowFormatP010,
+    RowFormatYUV444P,
+    RowFormatYUV444P10,
+};
+
+inline uint32_t clampComponent(int32_t value)
+{
+    return (uint32_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+template <int Format>
+void convertRowScalarFrom(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                          uint32_t* dst, int start, int width,
+                          const YuvToRgbConverter::Coefficients& c)
+{
+    for (int x = start; x < width; x++) {
+        int32_t y, u, v;
+
+        switch (Format) {
+        case RowFormatNV12:
+            y = yRow[x];
+            u = uRow[(x >> 1) * 2];
+            v = uRow[(x >> 1) * 2 + 1];
+            break;
+        case RowFormatP010:
+            y = ((const uint16_t*)yRow)[x] >> 6;
+            u = ((const uint16_t*)uRow)[(x >> 1) * 2] >> 6;
+            v = ((const uint16_t*)uRow)[(x >> 1) * 2 + 1] >> 6;
+            break;
+        case RowFormatYUV444P:
+            y = yRow[x];
+            u = uRow[x];
+            v = vRow[x];
+            break;
+        case RowFormatYUV444P10:
+        default:
+            y = ((const uint16_t*)yRow)[x];
+            u = ((const uint16_t*)uRow)[x];
+            v = ((const uint16_t*)vRow)[x];
+            break;
+        }
+
+        y = (y - c.yOffset) * c.yScale + COEFFICIENT_ROUND;
+        u -= c.uvOffset;
+        v -= c.uvOffset;
+
+        uint32_t r = clampComponent((y + c.vToR * v) >> COEFFICIENT_SHIFT);
+        uint32_t g = clampComponent((y + c.uToG * u + c.vToG * v) >> COEFFICIENT_SHIFT);
+        uint32_t b = clampComponent((y + c.uToB * u) >> COEFFICIENT_SHIFT);
+
+        dst[x] = ALPHA_MASK | (r << 16) | (g << 8) | b;
+    }
+}
+
+template <int Format>
+void convertRowScalar(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                      uint32_t* dst, int width,
+                      const YuvToRgbConverter::Coefficients& c)
+{
+    convertRowScalarFrom<Format>(yRow, uRow, vRow, dst, 0, width, c);
+}
+
+#ifdef HAVE_X86_KERNELS
+
+TARGET_SSE41
+inline __m128i loadU8x4(const uint8_t* src)
+{
+    int32_t value;
+    memcpy(&value, src, sizeof(value));
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(value));
+}
+
+TARGET_SSE41
+inline __m128i loadU16x4(const uint8_t* src)
+{
+    return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)src));
+}
+
+template <int Format>
+TARGET_SSE41
+void convertRowSse41(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                     uint32_t* dst, int width,
+                     const YuvToRgbConverter::Coefficients& c)
+{
+    const __m128i yOffset = _mm_set1_epi32(c.yOffset);
+    const __m128i uvOffset = _mm_set1_epi32(c.uvOffset);
+    const __m128i yScale = _mm_set1_epi32(c.yScale);
+    const __m128i uToG = _mm_set1_epi32(c.uToG);
+    const __m128i uToB = _mm_set1_epi32(c.uToB);
+    const __m128i vToR = _mm_set1_epi32(c.vToR);
+    const __m128i vToG = _mm_set1_epi32(c.vToG);
+    const __m128i round = _mm_set1_epi32(COEFFICIENT_ROUND);
+    const __m128i minValue = _mm_setzero_si128();
+    const __m128i maxValue = _mm_set1_epi32(255);
+    const __m128i alpha = _mm_set1_epi32((int)ALPHA_MASK);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i y, u, v;
+
+        switch (Format) {
+        case RowFormatNV12:
+        {
+            // 4 luma samples share 2 interleaved chroma pairs
+            __m128i uv = loadU8x4(uRow + x);
+            y = loadU8x4(yRow + x);
+            u = _mm_shuffle_epi32(uv, _MM_SHUFFLE(2, 2, 0, 0));
+            v = _mm_shuffle_epi32(uv, _MM_SHUFFLE(3, 3, 1, 1));
+            break;
+        }
+        case RowFormatP010:
+        {
+            __m128i uv = _mm_srli_epi32(loadU16x4(uRow + x * 2), 6);
+            y = _mm_srli_epi32(loadU16x4(yRow + x * 2), 6);
+            u = _mm_shuffle_epi32(uv, _MM_SHUFFLE(2, 2, 0, 0));
+            v = _mm_shuffle_epi32(uv, _MM_SHUFFLE(3, 3, 1, 1));
+            break;
+        }
+        case RowFormatYUV444P:
+            y = loadU8x4(yRow + x);
+            u = loadU8x4(uRow + x);
+            v = loadU8x4(vRow + x);
+            break;
+        case RowFormatYUV444P10:
+        default:
+            y = loadU16x4(yRow + x * 2);
+            u = loadU16x4(uRow + x * 2);
+            v = loadU16x4(vRow + x * 2);
+            break;
+        }
+
+        y = _mm_add_epi32(_mm_mullo_epi32(_mm_sub_epi32(y, yOffset), yScale), round);
+        u = _mm_sub_epi32(u, uvOffset);
+        v = _mm_sub_epi32(v, uvOffset);
+
+        __m128i r = _mm_add_epi32(y, _mm_mullo_epi32(v, vToR));
+        __m128i g = _mm_add_epi32(y, _mm_add_epi32(_mm_mullo_epi32(u, uToG), _mm_mullo_epi32(v, vToG)));
+        __m128i b = _mm_add_epi32(y, _mm_mullo_epi32(u, uToB));
+
+        r = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(r, COEFFICIENT_SHIFT), minValue), maxValue);
+        g = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(g, COEFFICIENT_SHIFT), minValue), maxValue);
+        b = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(b, COEFFICIENT_SHIFT), minValue), maxValue);
+
+        __m128i pixels = _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(r, 16)),
+                                      _mm_or_si128(_mm_slli_epi32(g, 8), b));
+        _mm_storeu_si128((__m128i*)(dst + x), pixels);
+    }
+
+    convertRowScalarFrom<Format>(yRow, uRow, vRow, dst, x, width, c);
+}
+
+TARGET_AVX2
+inline __m256i loadU8x8(const uint8_t* src)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src));
+}
+
+TARGET_AVX2
+inline __m256i loadU16x8(const uint8_t* src)
+{
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)src));
+}
+
+template <int Format>
+TARGET_AVX2
+void convertRowAvx2(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                    uint32_t* dst, int width,
+                    const YuvToRgbConverter::Coefficients& c)
+{
+    const __m256i yOffset = _mm256_set1_epi32(c.yOffset);
+    const __m256i uvOffset = _mm256_set1_epi32(c.uvOffset);
+    const __m256i yScale = _mm256_set1_epi32(c.yScale);
+    const __m256i uToG = _mm256_set1_epi32(c.uToG);
+    const __m256i uToB = _mm256_set1_epi32(c.uToB);
+    const __m256i vToR = _mm256_set1_epi32(c.vToR);
+    const __m256i vToG = _mm256_set1_epi32(c.vToG);
+    const __m256i round = _mm256_set1_epi32(COEFFICIENT_ROUND);
+    const __m256i minValue = _mm256_setzero_si256();
+    const __m256i maxValue = _mm256_set1_epi32(255);
+    const __m256i alpha = _mm256_set1_epi32((int)ALPHA_MASK);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i y, u, v;
+
+        switch (Format) {
+        case RowFormatNV12:
+        {
+            // The widened chroma pairs land as [u0 v0 u1 v1 | u2 v2 u3 v3], so the
+            // in-lane shuffle duplicates them to line up with luma samples 0-3 | 4-7.
+            __m256i uv = loadU8x8(uRow + x);
+            y = loadU8x8(yRow + x);
+            u = _mm256_shuffle_epi32(uv, _MM_SHUFFLE(2, 2, 0, 0));
+            v = _mm256_shuffle_epi32(uv, _MM_SHUFFLE(3, 3, 1, 1));
+            break;
+        }
+        case RowFormatP010:
+        {
+            __m256i uv = _mm256_srli_epi32(loadU16x8(uRow + x * 2), 6);
+            y = _mm256_srli_epi32(loadU16x8(yRow + x * 2), 6);
+            u = _mm256_shuffle_epi32(uv, _MM_SHUFFLE(2, 2, 0, 0));
+            v = _mm256_shuffle_epi32(uv, _MM_SHUFFLE(3, 3, 1, 1));
+            break;
+        }
+        case RowFormatYUV444P:
+            y = loadU8x8(yRow + x);
+            u = loadU8x8(uRow + x);
+            v = loadU8x8(vRow + x);
+            break;
+        case RowFormatYUV444P10:
+        default:
+            y = loadU16x8(yRow + x * 2);
+            u = loadU16x8(uRow + x * 2);
+            v = loadU16x8(vRow + x * 2);
+            break;
+        }
+
+        y = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(y, yOffset), yScale), round);
+        u = _mm256_sub_epi32(u, uvOffset);
+        v = _mm256_sub_epi32(v, uvOffset);
+
+        __m256i r = _mm256_add_epi32(y, _mm256_mullo_epi32(v, vToR));
+        __m256i g = _mm256_add_epi32(y, _mm256_add_epi32(_mm256_mullo_epi32(u, uToG), _mm256_mullo_epi32(v, vToG)));
+        __m256i b = _mm256_add_epi32(y, _mm256_mullo_epi32(u, uToB));
+
+        r = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(r, COEFFICIENT_SHIFT), minValue), maxValue);
+        g = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(g, COEFFICIENT_SHIFT), minValue), maxValue);
+        b = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(b, COEFFICIENT_SHIFT), minValue), maxValue);
+
+        __m256i pixels = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(r, 16)),
+                                         _mm256_or_si256(_mm256_slli_epi32(g, 8), b));
+        _mm256_storeu_si256((__m256i*)(dst + x), pixels);
+    }
+
+    convertRowScalarFrom<Format>(yRow, uRow, vRow, dst, x, width, c);
+}
+
+#endif
+
+#ifdef HAVE_NEON_KERNELS
+
+struct NeonCoefficients {
+    int32x4_t yOffset;
+    int32x4_t uvOffset;
+    int32x4_t yScale;
+    int32x4_t uToG;
+    int32x4_t uToB;
+    int32x4_t vToR;
+    int32x4_t vToG;
+    int32x4_t round;
+    int32x4_t minValue;
+    int32x4_t maxValue;
+    uint32x4_t alpha;
+};
+
+inline uint32x4_t convertQuadNeon(int32x4_t y, int32x4_t u, int32x4_t v, const NeonCoefficients& c)
+{
+    y = vaddq_s32(vmulq_s32(vsubq_s32(y, c.yOffset), c.yScale), c.round);
+    u = vsubq_s32(u, c.uvOffset);
+    v = vsubq_s32(v, c.uvOffset);
+
+    int32x4_t r = vmlaq_s32(y, v, c.vToR);
+    int32x4_t g = vmlaq_s32(vmlaq_s32(y, u, c.uToG), v, c.vToG);
+    int32x4_t b = vmlaq_s32(y, u, c.uToB);
+
+    r = vminq_s32(vmaxq_s32(vshrq_n_s32(r, COEFFICIENT_SHIFT), c.minValue), c.maxValue);
+    g = vminq_s32(vmaxq_s32(vshrq_n_s32(g, COEFFICIENT_SHIFT), c.minValue), c.maxValue);
+    b = vminq_s32(vmaxq_s32(vshrq_n_s32(b, COEFFICIENT_SHIFT), c.minValue), c.maxValue);
+
+    return vorrq_u32(vorrq_u32(c.alpha, vshlq_n_u32(vreinterpretq_u32_s32(r), 16)),
+                     vorrq_u32(vshlq_n_u32(vreinterpretq_u32_s32(g), 8), vreinterpretq_u32_s32(b)));
+}
+
+inline int32x4_t widenLow(uint16x8_t value)
+{
+    return vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(value)));
+}
+
+inline int32x4_t widenHigh(uint16x8_t value)
+{
+    return vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(value)));
+}
+
+template <int Format>
+void convertRowNeon(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                    uint32_t* dst, int width,
+                    const YuvToRgbConverter::Coefficients& c)
+{
+    NeonCoefficients nc;
+    nc.yOffset = vdupq_n_s32(c.yOffset);
+    nc.uvOffset = vdupq_n_s32(c.uvOffset);
+    nc.yScale = vdupq_n_s32(c.yScale);
+    nc.uToG = vdupq_n_s32(c.uToG);
+    nc.uToB = vdupq_n_s32(c.uToB);
+    nc.vToR = vdupq_n_s32(c.vToR);
+    nc.vToG = vdupq_n_s32(c.vToG);
+    nc.round = vdupq_n_s32(COEFFICIENT_ROUND);
+    nc.minValue = vdupq_n_s32(0);
+    nc.maxValue = vdupq_n_s32(255);
+    nc.alpha = vdupq_n_u32(ALPHA_MASK);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t y, u, v;
+
+        switch (Format) {
+        case RowFormatNV12:
+        case RowFormatP010:
+        {
+            uint16x8_t uv;
+            if (Format == RowFormatNV12) {
+                y = vmovl_u8(vld1_u8(yRow + x));
+                uv = vmovl_u8(vld1_u8(uRow + x));
+            }
+            else {
+                y = vshrq_n_u16(vld1q_u16((const uint16_t*)yRow + x), 6);
+                uv = vshrq_n_u16(vld1q_u16((const uint16_t*)uRow + x), 6);
+            }
+
+            // De-interleave [u0 v0 u1 v1 u2 v2 u3 v3] then duplicate each
+            // chroma sample across the 2 luma samples that share it.
+            uint16x8_t uOnly = vuzp1q_u16(uv, uv);
+            uint16x8_t vOnly = vuzp2q_u16(uv, uv);
+            u = vzip1q_u16(uOnly, uOnly);
+            v = vzip1q_u16(vOnly, vOnly);
+            break;
+        }
+        case RowFormatYUV444P:
+            y = vmovl_u8(vld1_u8(yRow + x));
+            u = vmovl_u8(vld1_u8(uRow + x));
+            v = vmovl_u8(vld1_u8(vRow + x));
+            break;
+        case RowFormatYUV444P10:
+        default:
+            y = vld1q_u16((const uint16_t*)yRow + x);
+            u = vld1q_u16((const uint16_t*)uRow + x);
+            v = vld1q_u16((const uint16_t*)vRow + x);
+            break;
+        }
+
+        vst1q_u32(dst + x, convertQuadNeon(widenLow(y), widenLow(u), widenLow(v), nc));
+        vst1q_u32(dst + x + 4, convertQuadNeon(widenHigh(y), widenHigh(u), widenHigh(v), nc));
+    }
+
+    convertRowScalarFrom<Format>(yRow, uRow, vRow, dst, x, width, c);
+}
+
+#endif
+
+template <template <int> class Kernel>
+YuvToRgbConverter::RowFunction selectRowFunction(enum AVPixelFormat format)
+{
+    switch (format) {
+    case AV_PIX_FMT_NV12:
+        return Kernel<RowFormatNV12>::convertRow;
+    case AV_PIX_FMT_P010:
+        return Kernel<RowFormatP010>::convertRow;
+    case AV_PIX_FMT_YUV444P:
+        return Kernel<RowFormatYUV444P>::convertRow;
+    case AV_PIX_FMT_YUV444P10:
+        return Kernel<RowFormatYUV444P10>::convertRow;
+    default:
+        return nullptr;
+    }
+}
+
+#define DECLARE_ROW_KERNEL(name, function) \
+    template <int Format> \
+    struct name { \
+        static void convertRow(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow, \
+                               uint32_t* dst, int width, \
+                               const YuvToRgbConverter::Coefficients& c) { \
+            function<Format>(yRow, uRow, vRow, dst, width, c); \
+        } \
+    }
+
+DECLARE_ROW_KERNEL(ScalarKernel, convertRowScalar);
+#ifdef HAVE_X86_KERNELS
+DECLARE_ROW_KERNEL(Sse41Kernel, convertRowSse41);
+DECLARE_ROW_KERNEL(Avx2Kernel, convertRowAvx2);
+#endif
+#ifdef HAVE_NEON_KERNELS
+DECLARE_ROW_KERNEL(NeonKernel, convertRowNeon);
+#endif
+
+}
+
+YuvToRgbConverter::YuvToRgbConverter()
+    : m_Format(AV_PIX_FMT_NONE),
+      m_Implementation(Scalar),
+      m_RowFunction(nullptr),
+      m_WorkStartSem(SDL_CreateSemaphore(0)),
+      m_WorkDoneSem(SDL_CreateSemaphore(0)),
+      m_BandFrame(nullptr),
+      m_BandDst(nullptr),
+      m_BandDstPitch(0),
+      m_BandHeight(0),
+      m_BandCount(0)
+{
+    SDL_zero(m_Coefficients);
+    SDL_AtomicSet(&m_WorkersStopping, 0);
+    SDL_AtomicSet(&m_NextBand, 0);
+}
+
+YuvToRgbConverter::~YuvToRgbConverter()
+{
+    stopWorkerThreads();
+
+    if (m_WorkStartSem != nullptr) {
+        SDL_DestroySemaphore(m_WorkStartSem);
+    }
+    if (m_WorkDoneSem != nullptr) {
+        SDL_DestroySemaphore(m_WorkDoneSem);
+    }
+}
+
+bool YuvToRgbConverter::isFormatSupported(enum AVPixelFormat format)
+{
+    return getRowFunction(format, Scalar) != nullptr;
+}
+
+bool YuvToRgbConverter::isImplementationAvailable(Implementation implementation)
+{
+    switch (implementation) {
+    case Scalar:
+        return true;
+#ifdef HAVE_X86_KERNELS
+    case SSE41:
+        return SDL_HasSSE41();
+    case AVX2:
+        return SDL_HasAVX2();
+#endif
+#ifdef HAVE_NEON_KERNELS
+    case NEON:
+        return SDL_HasNEON();
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* YuvToRgbConverter::getImplementationName(Implementation implementation)
+{
+    switch (implementation) {
+    case Scalar:
+        return "Scalar";
+    case SSE41:
+        return "SSE4.1";
+    case AVX2:
+        return "AVX2";
+    case NEON:
+        return "NEON";
+    default:
+        SDL_assert(false);
+        return "Unknown";
+    }
+}
+
+YuvToRgbConverter::RowFunction YuvToRgbConverter::getRowFunction(enum AVPixelFormat format, Implementation implementation)
+{
+    switch (implementation) {
+    case Scalar:
+        return selectRowFunction<ScalarKernel>(format);
+#ifdef HAVE_X86_KERNELS
+    case SSE41:
+        return selectRowFunction<Sse41Kernel>(format);
+    case AVX2:
+        return selectRowFunction<Avx2Kernel>(format);
+#endif
+#ifdef HAVE_NEON_KERNELS
+    case NEON:
+        return selectRowFunction<NeonKernel>(format);
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+bool YuvToRgbConverter::initialize(enum AVPixelFormat format,
+                                   const std::array<float, 9>& cscMatrix,
+                                   const std::array<float, 3>& offsets,
+                                   int bitsPerChannel)
+{
+    if (!isFormatSupported(format)) {
+        return false;
+    }
+
+    m_Format = format;
+
+    // The CSC matrix operates on normalized samples, so fold the conversion
+    // from N-bit input to 8-bit output into the fixed-point coefficients.
+    double channelMax = (1 << bitsPerChannel) - 1;
+    double scale = 255.0 / channelMax * (1 << COEFFICIENT_SHIFT);
+
+    // All of our supported matrices have equal luma weights for R, G, and B
+    // and no contribution from U to R or V to B.
+    SDL_assert(cscMatrix[0] == cscMatrix[1] && cscMatrix[1] == cscMatrix[2]);
+    SDL_assert(cscMatrix[3] == 0.0f && cscMatrix[8] == 0.0f);
+
+    m_Coefficients.yOffset = (int32_t)std::lround(offsets[0] * channelMax);
+    m_Coefficients.uvOffset = (int32_t)std::lround(offsets[1] * channelMax);
+    m_Coefficients.yScale = (int32_t)std::lround(cscMatrix[0] * scale);
+    m_Coefficients.uToG = (int32_t)std::lround(cscMatrix[4] * scale);
+    m_Coefficients.uToB = (int32_t)std::lround(cscMatrix[5] * scale);
+    m_Coefficients.vToR = (int32_t)std::lround(cscMatrix[6] * scale);
+    m_Coefficients.vToG = (int32_t)std::lround(cscMatrix[7] * scale);
+
+    // Pick the fastest implementation unless one was requested explicitly
+    int implementation;
+    if (!Utils::getEnvironmentVariableOverride("CPU_CSC_IMPLEMENTATION", &implementation) ||
+            !setImplementation((Implementation)implementation)) {
+        if (!setImplementation(AVX2) && !setImplementation(SSE41) && !setImplementation(NEON)) {
+            setImplementation(Scalar);
+        }
+    }
+
+    // A single core can't keep up with 4K on many ARM devices, so split
+    // the frame across the same number of threads we give swscale.
+    int threadCount;
+    if (!Utils::getEnvironmentVariableOverride("CPU_CSC_THREADS", &threadCount) ||
+            !setThreadCount(threadCount)) {
+        setThreadCount(std::min(SDL_GetCPUCount(), 4));
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Using %s CPU color conversion for %d-bit video on %d threads",
+                getImplementationName(m_Implementation),
+                bitsPerChannel,
+                getThreadCount());
+    return true;
+}
+
+bool YuvToRgbConverter::setImplementation(Implementation implementation)
+{
+    if (implementation < 0 || implementation >= ImplementationMax ||
+            !isImplementationAvailable(implementation)) {
+        return false;
+    }
+
+    RowFunction rowFunction = getRowFunction(m_Format, implementation);
+    if (rowFunction == nullptr) {
+        return false;
+    }
+
+    m_Implementation = implementation;
+    m_RowFunction = rowFunction;
+    return true;
+}
+
+YuvToRgbConverter::Implementation YuvToRgbConverter::getImplementation() const
+{
+    return m_Implementation;
+}
+
+bool YuvToRgbConverter::setThreadCount(int threadCount)
+{
+    if (threadCount < 1 || threadCount > MAX_THREADS) {
+        return false;
+    }
+    else if (threadCount == getThreadCount()) {
+        return true;
+    }
+
+    stopWorkerThreads();
+
+    if (m_WorkStartSem == nullptr || m_WorkDoneSem == nullptr) {
+        // Conversion still works on the caller's thread alone
+        return threadCount == 1;
+    }
+
+    SDL_AtomicSet(&m_WorkersStopping, 0);
+    for (int i = 1; i < threadCount; i++) {
+        SDL_Thread* thread = SDL_CreateThread(YuvToRgbConverter::workerThread, "CscWorker", this);
+        if (thread == nullptr) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Unable to create color conversion thread: %s",
+                        SDL_GetError());
+            break;
+        }
+
+        m_WorkerThreads.push_back(thread);
+    }
+
+    return true;
+}
+
+int YuvToRgbConverter::getThreadCount() const
+{
+    return (int)m_WorkerThreads.size() + 1;
+}
+
+void YuvToRgbConverter::stopWorkerThreads()
+{
+    if (m_WorkerThreads.empty()) {
+        return;
+    }
+
+    SDL_AtomicSet(&m_WorkersStopping, 1);
+    for (size_t i = 0; i < m_WorkerThreads.size(); i++) {
+        SDL_SemPost(m_WorkStartSem);
+    }
+    for (SDL_Thread* thread : m_WorkerThreads) {
+        SDL_WaitThread(thread, nullptr);
+    }
+    m_WorkerThreads.clear();
+}
+
+int YuvToRgbConverter::workerThread(void* context)
+{
+    YuvToRgbConverter* me = reinterpret_cast<YuvToRgbConverter*>(context);
+
+    // The render thread is blocked until we're done
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+
+    while (SDL_SemWait(me->m_WorkStartSem) == 0 && !SDL_AtomicGet(&me->m_WorkersStopping)) {
+        me->convertBands();
+        SDL_SemPost(me->m_WorkDoneSem);
+    }
+
+    return 0;
+}
+
+void YuvToRgbConverter::convertBands()
+{
+    const AVFrame* frame = m_BandFrame;
+    bool chromaSubsampled = (m_Format == AV_PIX_FMT_NV12 || m_Format == AV_PIX_FMT_P010);
+
+    // Each thread claims bands until they're all taken, so a thread
+    // that gets preempted doesn't hold up the whole frame.
+    for (int band = SDL_AtomicAdd(&m_NextBand, 1); band < m_BandCount; band = SDL_AtomicAdd(&m_NextBand, 1)) {
+        int startRow = band * m_BandHeight;
+        int endRow = std::min(startRow + m_BandHeight, frame->height);
+
+        for (int row = startRow; row < endRow; row++) {
+            int chromaRow = chromaSubsampled ? row / 2 : row;
+
+            m_RowFunction(frame->data[0] + (ptrdiff_t)row * frame->linesize[0],
+                          frame->data[1] + (ptrdiff_t)chromaRow * frame->linesize[1],
+                          chromaSubsampled ? nullptr : frame->data[2] + (ptrdiff_t)chromaRow * frame->linesize[2],
+                          (uint32_t*)(m_BandDst + (ptrdiff_t)row * m_BandDstPitch),
+                          frame->width,
+                          m_Coefficients);
+        }
+    }
+}
+
+void YuvToRgbConverter::convertFrame(const AVFrame* frame, uint8_t* dst, int dstPitch)
+{
+    SDL_assert(frame->format == m_Format);
+    SDL_assert(m_RowFunction != nullptr);
+
+    int threadCount = getThreadCount();
+
+    // Use a few bands per thread to even out scheduling delays. Bands start
+    // on even rows so each 4:2:0 chroma row is only fetched by one thread.
+    m_BandFrame = frame;
+    m_BandDst = dst;
+    m_BandDstPitch = dstPitch;
+    m_BandHeight = SDL_max((frame->height + threadCount * 4 - 1) / (threadCount * 4), 1);
+    m_BandHeight = (m_BandHeight + 1) & ~1;
+    m_BandCount = (frame->height + m_BandHeight - 1) / m_BandHeight;
+    SDL_AtomicSet(&m_NextBand, 0);
+
+    for (int i = 1; i < threadCount; i++) {
+        SDL_SemPost(m_WorkStartSem);
+    }
+
+    // Convert on this thread too rather than sitting idle
+    convertBands();
+
+    for (int i = 1; i < threadCount; i++) {
+        SDL_SemWait(m_WorkDoneSem);
+    }
+
+    m_BandFrame = nullptr;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <SDL.h>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// Converts YUV frames to XRGB8888 on the CPU for renderers that can't
+// upload the decoder's native format. The row kernels are hand-vectorized
+// for SSE4.1, AVX2 and NEON, and the fastest one supported by the CPU
+// is picked at runtime. Frames are split into horizontal bands that are
+// converted in parallel on a small pool of worker threads.
+class YuvToRgbConverter
+{
+public:
+    enum Implementation {
+        Scalar,
+        SSE41,
+        AVX2,
+        NEON,
+        ImplementationMax
+    };
+
+    YuvToRgbConverter();
+    ~YuvToRgbConverter();
+
+    static bool isFormatSupported(enum AVPixelFormat format);
+    static bool isImplementationAvailable(Implementation implementation);
+    static const char* getImplementationName(Implementation implementation);
+
+    // The CSC constants are in the form returned by
+    // IFFmpegRenderer::getFramePremultipliedCscConstants()
+    bool initialize(enum AVPixelFormat format,
+                    const std::array<float, 9>& cscMatrix,
+                    const std::array<float, 3>& offsets,
+                    int bitsPerChannel);
+
+    // Overrides the automatically selected implementation
+    bool setImplementation(Implementation implementation);
+    Implementation getImplementation() const;
+
+    // Overrides the automatically selected number of threads (including
+    // the caller's) that convertFrame() uses
+    bool setThreadCount(int threadCount);
+    int getThreadCount() const;
+
+    void convertFrame(const AVFrame* frame, uint8_t* dst, int dstPitch);
+
+    // Fixed-point coefficients with COEFFICIENT_SHIFT fractional bits
+    struct Coefficients {
+        int32_t yOffset;
+        int32_t uvOffset;
+        int32_t yScale;
+        int32_t uToG;
+        int32_t uToB;
+        int32_t vToR;
+        int32_t vToG;
+    };
+
+    typedef void (*RowFunction)(const uint8_t* yRow,
+                                const uint8_t* uRow,
+                                const uint8_t* vRow,
+                                uint32_t* dst,
+                                int width,
+                                const Coefficients& coefficients);
+
+private:
+    static RowFunction getRowFunction(enum AVPixelFormat format, Implementation implementation);
+    static int workerThread(void* context);
+
+    void stopWorkerThreads();
+    void convertBands();
+
+    enum AVPixelFormat m_Format;
+    Implementation m_Implementation;
+    RowFunction m_RowFunction;
+    Coefficients m_Coefficients;
+
+    std::vector<SDL_Thread*> m_WorkerThreads;
+    SDL_sem* m_WorkStartSem;
+    SDL_sem* m_WorkDoneSem;
+    SDL_atomic_t m_WorkersStopping;
+
+    // The frame being converted, published to the workers by m_WorkStartSem
+    const AVFrame* m_BandFrame;
+    uint8_t* m_BandDst;
+    int m_BandDstPitch;
+    int m_BandHeight;
+    int m_BandCount;
+    SDL_atomic_t m_NextBand;
+};
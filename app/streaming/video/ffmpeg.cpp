@@ -2,9 +2,12 @@
 #include "ffmpeg.h"
 #include "utils.h"
 #include "streaming/session.h"
+#include "streaming/streamutils.h"
 
 #include <h264_stream.h>
 
+#include <QHash>
+
 extern "C" {
 #include <libavutil/mastering_display_metadata.h>
 #include <libavutil/pixdesc.h>
@@ -12,6 +15,7 @@ extern "C" {
 
 #include "ffmpeg-renderers/sdlvid.h"
 #include "ffmpeg-renderers/genhwaccel.h"
+#include "ffmpeg-renderers/nullrenderer.h"
 
 #ifdef Q_OS_WIN32
 #include "ffmpeg-renderers/dxva2.h"
@@ -57,8 +61,19 @@ extern "C" {
 
 #define MAX_SPS_EXTRA_SIZE 16
 
+#define INITIAL_DECODE_BUFFER_SIZE (1024 * 1024)
+
+// The decoder thread holds one frame while receiving output from
+// FFmpeg and Pacer can hold up to PACER_MAX_OUTSTANDING_FRAMES
+#define FRAME_POOL_SIZE (PACER_MAX_OUTSTANDING_FRAMES + 1)
+
 #define FAILED_DECODES_RESET_THRESHOLD 20
 
+// How long to wait for new input before polling an asynchronous decoder for
+// output again when it's still working on a frame we submitted. New input
+// from the host will wake the decoder thread immediately.
+#define DEFAULT_DECODER_POLL_INTERVAL_US 500
+
 // Note: This is NOT an exhaustive list of all decoders
 // that Moonlight could pick. It will pick any working
 // decoder that matches the codec ID and outputs one of
@@ -221,12 +236,16 @@ FFmpegVideoDecoder::FFmpegVideoDecoder(bool testOnly)
     : m_Pkt(av_packet_alloc()),
       m_VideoDecoderCtx(nullptr),
       m_RequiredPixelFormat(AV_PIX_FMT_NONE),
-      m_DecodeBuffer(1024 * 1024, 0),
+      m_DecodeBufferPool(nullptr),
+      m_DecodeBufferPoolSize(0),
       m_HwDecodeCfg(nullptr),
       m_BackendRenderer(nullptr),
       m_FrontendRenderer(nullptr),
       m_ConsecutiveFailedDecodes(0),
       m_Pacer(nullptr),
+      m_FramePool(FRAME_POOL_SIZE),
+      m_FrameTimingTrace(nullptr),
+      m_DecodeUnitCapture(nullptr),
       m_BwTracker(10, 250),
       m_FramesIn(0),
       m_FramesOut(0),
@@ -234,15 +253,37 @@ FFmpegVideoDecoder::FFmpegVideoDecoder(bool testOnly)
       m_StreamFps(0),
       m_VideoFormat(0),
       m_NeedsSpsFixup(false),
+      m_CachedSpsHash(0),
       m_TestOnly(testOnly),
       m_CurrentTestMode(TestMode::TestFrameOnly),
-      m_DecoderThread(nullptr)
+      m_DecoderThread(nullptr),
+      m_DecodeUnitSource(&m_LiveDecodeUnitSource),
+      m_LegacyDecoderPolling(false),
+      m_DecoderPollIntervalUs(DEFAULT_DECODER_POLL_INTERVAL_US),
+      m_DecoderHasAsyncOutput(false),
+      m_DecoderWakeThread(nullptr),
+      m_DecoderWakeArmed(false),
+      m_DecoderWakeThreadShouldQuit(false)
 {
     SDL_zero(m_ActiveWndVideoStats);
     SDL_zero(m_LastWndVideoStats);
     SDL_zero(m_GlobalVideoStats);
 
     SDL_AtomicSet(&m_DecoderThreadShouldQuit, 0);
+
+    // The legacy polling mode sleeps for 2 ms at a time while waiting for output.
+    // It is retained to allow comparing the average decoding time in the stats
+    // overlay against the wakeup-based mode.
+    if (!Utils::getEnvironmentVariableOverride("LEGACY_DECODER_POLLING", &m_LegacyDecoderPolling)) {
+        m_LegacyDecoderPolling = false;
+    }
+
+    if (Utils::getEnvironmentVariableOverride("DECODER_POLL_INTERVAL_US", &m_DecoderPollIntervalUs)) {
+        m_DecoderPollIntervalUs = SDL_max(m_DecoderPollIntervalUs, 50);
+    }
+    else {
+        m_DecoderPollIntervalUs = DEFAULT_DECODER_POLL_INTERVAL_US;
+    }
 }
 
 FFmpegVideoDecoder::~FFmpegVideoDecoder()
@@ -256,6 +297,9 @@ FFmpegVideoDecoder::~FFmpegVideoDecoder()
     av_log_set_level(AV_LOG_INFO);
 
     av_packet_free(&m_Pkt);
+
+    // Any outstanding buffers will be freed when FFmpeg releases them
+    av_buffer_pool_uninit(&m_DecodeBufferPool);
 }
 
 IFFmpegRenderer* FFmpegVideoDecoder::getBackendRenderer()
@@ -263,18 +307,45 @@ IFFmpegRenderer* FFmpegVideoDecoder::getBackendRenderer()
     return m_BackendRenderer;
 }
 
+IFFmpegRenderer* FFmpegVideoDecoder::getFrontendRenderer()
+{
+    return m_FrontendRenderer;
+}
+
+void FFmpegVideoDecoder::setDecodeUnitSource(IDecodeUnitSource* source)
+{
+    // The decoder thread must not be running yet
+    SDL_assert(m_DecoderThread == nullptr);
+
+    m_DecodeUnitSource = source != nullptr ? source : &m_LiveDecodeUnitSource;
+}
+
 void FFmpegVideoDecoder::reset()
 {
     // Terminate the decoder thread before doing anything else.
     // It might be touching things we're about to free.
     if (m_DecoderThread != nullptr) {
         SDL_AtomicSet(&m_DecoderThreadShouldQuit, 1);
-        LiWakeWaitForVideoFrame();
+        m_DecodeUnitSource->wake();
         SDL_WaitThread(m_DecoderThread, NULL);
         SDL_AtomicSet(&m_DecoderThreadShouldQuit, 0);
         m_DecoderThread = nullptr;
     }
 
+    // The wake thread must be stopped after the decoder thread
+    // because the decoder thread may still be arming it.
+    if (m_DecoderWakeThread != nullptr) {
+        {
+            std::lock_guard lg { m_DecoderWakeLock };
+            m_DecoderWakeThreadShouldQuit = true;
+            m_DecoderWakeArmed = false;
+        }
+        m_DecoderWakeCond.notify_one();
+        SDL_WaitThread(m_DecoderWakeThread, NULL);
+        m_DecoderWakeThreadShouldQuit = false;
+        m_DecoderWakeThread = nullptr;
+    }
+
     m_FramesIn = m_FramesOut = 0;
     m_FrameInfoQueue.clear();
 
@@ -288,16 +359,16 @@ void FFmpegVideoDecoder::reset()
     // need to delete in the renderer destructor.
     avcodec_free_context(&m_VideoDecoderCtx);
 
-    if (m_CurrentTestMode != TestMode::TestFrameOnly) {
+    if (m_CurrentTestMode != TestMode::TestFrameOnly && Session::get() != nullptr) {
         Session::get()->getOverlayManager().setOverlayRenderer(nullptr);
     }
 
     // If we have a separate frontend renderer, free that first
     if (m_FrontendRenderer != m_BackendRenderer) {
-        delete m_FrontendRenderer;
+        destroyRenderer(m_FrontendRenderer);
     }
 
-    delete m_BackendRenderer;
+    destroyRenderer(m_BackendRenderer);
 
     m_FrontendRenderer = m_BackendRenderer = nullptr;
 
@@ -320,7 +391,17 @@ bool FFmpegVideoDecoder::initializeRendererInternal(IFFmpegRenderer* renderer, P
         return false;
     }
 
-    if (!renderer->initialize(params)) {
+    bool initialized;
+    if (renderer->isConcurrentInitializationSupported()) {
+        initialized = renderer->initialize(params);
+    }
+    else {
+        // Test decoders may be initializing on other threads
+        std::lock_guard lg { StreamUtils::getVideoInitLock() };
+        initialized = renderer->initialize(params);
+    }
+
+    if (!initialized) {
         if (renderer->getInitFailureReason() == IFFmpegRenderer::InitFailureReason::NoSoftwareSupport) {
             m_FailedRenderers.insert(renderer->getRendererType());
 
@@ -335,6 +416,20 @@ bool FFmpegVideoDecoder::initializeRendererInternal(IFFmpegRenderer* renderer, P
     return true;
 }
 
+void FFmpegVideoDecoder::destroyRenderer(IFFmpegRenderer*& renderer)
+{
+    if (renderer != nullptr && !renderer->isConcurrentInitializationSupported()) {
+        // Renderers that must be initialized serially must also be destroyed serially
+        std::lock_guard lg { StreamUtils::getVideoInitLock() };
+        delete renderer;
+    }
+    else {
+        delete renderer;
+    }
+
+    renderer = nullptr;
+}
+
 bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool useAlternateFrontend)
 {
     bool glIsSlow;
@@ -359,6 +454,20 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
     Q_UNUSED(glIsSlow);
     Q_UNUSED(vulkanIsSlow);
 
+    // Without a window, frames are consumed by NullRenderer instead of being displayed
+    if (params->window == nullptr) {
+        if (useAlternateFrontend) {
+            return false;
+        }
+        else if (m_BackendRenderer->getRendererType() == IFFmpegRenderer::RendererType::Null) {
+            m_FrontendRenderer = m_BackendRenderer;
+            return true;
+        }
+
+        m_FrontendRenderer = new NullRenderer();
+        return initializeRendererInternal(m_FrontendRenderer, params);
+    }
+
     // For cases where we're already using Vulkan Video decoding, always use the Vulkan renderer too.
     // The alternate frontend logic is primarily for cases where a different renderer like EGL or DRM
     // may provide additional performance or HDR capabilities. Neither of these are true for Vulkan.
@@ -372,8 +481,7 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
                 if (initializeRendererInternal(m_FrontendRenderer, params) && (m_FrontendRenderer->getRendererAttributes() & RENDERER_ATTRIBUTE_HDR_SUPPORT)) {
                     return true;
                 }
-                delete m_FrontendRenderer;
-                m_FrontendRenderer = nullptr;
+                destroyRenderer(m_FrontendRenderer);
             }
 #endif
 
@@ -387,8 +495,7 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
                 if (initializeRendererInternal(m_FrontendRenderer, params) && (m_FrontendRenderer->getRendererAttributes() & RENDERER_ATTRIBUTE_HDR_SUPPORT)) {
                     return true;
                 }
-                delete m_FrontendRenderer;
-                m_FrontendRenderer = nullptr;
+                destroyRenderer(m_FrontendRenderer);
             }
 #endif
 
@@ -400,8 +507,7 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
                 if (initializeRendererInternal(m_FrontendRenderer, params) && (m_FrontendRenderer->getRendererAttributes() & RENDERER_ATTRIBUTE_HDR_SUPPORT)) {
                     return true;
                 }
-                delete m_FrontendRenderer;
-                m_FrontendRenderer = nullptr;
+                destroyRenderer(m_FrontendRenderer);
             }
 #endif
         }
@@ -413,8 +519,7 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
                 if (initializeRendererInternal(m_FrontendRenderer, params)) {
                     return true;
                 }
-                delete m_FrontendRenderer;
-                m_FrontendRenderer = nullptr;
+                destroyRenderer(m_FrontendRenderer);
             }
 #endif
         }
@@ -426,8 +531,7 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
             if (initializeRendererInternal(m_FrontendRenderer, params)) {
                 return true;
             }
-            delete m_FrontendRenderer;
-            m_FrontendRenderer = nullptr;
+            destroyRenderer(m_FrontendRenderer);
         }
 #endif
 
@@ -450,8 +554,7 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
             if (initializeRendererInternal(m_FrontendRenderer, params)) {
                 return true;
             }
-            delete m_FrontendRenderer;
-            m_FrontendRenderer = nullptr;
+            destroyRenderer(m_FrontendRenderer);
         }
 #endif
 
@@ -463,8 +566,7 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
             if (initializeRendererInternal(m_FrontendRenderer, params)) {
                 return true;
             }
-            delete m_FrontendRenderer;
-            m_FrontendRenderer = nullptr;
+            destroyRenderer(m_FrontendRenderer);
         }
 #endif
 
@@ -494,11 +596,18 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, enum AVP
     m_VideoFormat = params->videoFormat;
     m_CurrentTestMode = testMode;
 
+    // Only record frame timing and decode units for decoders that will actually stream
+    if (!m_TestOnly && Session::get() != nullptr) {
+        m_FrameTimingTrace = &Session::get()->getFrameTimingTrace();
+        m_DecodeUnitCapture = &Session::get()->getDecodeUnitCapture();
+    }
+
     // Don't bother initializing Pacer if we're not actually going to render
     if (testMode != TestMode::TestFrameOnly) {
-        m_Pacer = new Pacer(m_FrontendRenderer, &m_ActiveWndVideoStats);
+        m_Pacer = new Pacer(m_FrontendRenderer, &m_FramePool, m_FrameTimingTrace, &m_ActiveWndVideoStats);
         if (!m_Pacer->initialize(params->window, params->frameRate,
-                                 params->enableFramePacing || (params->enableVsync && (m_FrontendRenderer->getRendererAttributes() & RENDERER_ATTRIBUTE_FORCE_PACING)))) {
+                                 params->enableFramePacing || (params->enableVsync && (m_FrontendRenderer->getRendererAttributes() & RENDERER_ATTRIBUTE_FORCE_PACING)),
+                                 params->pacingPolicy)) {
             return false;
         }
     }
@@ -731,13 +840,45 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, enum AVP
         }
 
         // Tell overlay manager to use this frontend renderer
-        Session::get()->getOverlayManager().setOverlayRenderer(m_FrontendRenderer);
+        if (Session::get() != nullptr) {
+            Session::get()->getOverlayManager().setOverlayRenderer(m_FrontendRenderer);
+        }
 
         // Allow the renderer to perform final preparations for rendering
         m_FrontendRenderer->prepareToRender();
 
-        // Only create the decoder thread when instantiating the decoder for real. It will use APIs from
-        // moonlight-common-c that can only be legally called with an established connection.
+        // Hwaccels and slice-threaded software decoding finish their work inside
+        // avcodec_send_packet(), so FFmpeg can only produce more output once we
+        // give it more input. Standalone hardware decoders (V4L2, MMAL, etc.) and
+        // frame-threaded decoders complete frames asynchronously, so we must
+        // periodically poll them while they're holding a frame we submitted.
+        m_DecoderHasAsyncOutput = (getAVCodecCapabilities(m_VideoDecoderCtx->codec) & AV_CODEC_CAP_HARDWARE) ||
+                                  (m_VideoDecoderCtx->active_thread_type & FF_THREAD_FRAME);
+
+        if (m_LegacyDecoderPolling) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Using legacy decoder polling");
+        }
+        else if (m_DecoderHasAsyncOutput) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Decoder output poll interval: %d us",
+                        m_DecoderPollIntervalUs);
+
+            m_DecoderWakeThread = SDL_CreateThread(FFmpegVideoDecoder::decoderWakeThreadProcThunk, "FFDecoderWake", (void*)this);
+            if (m_DecoderWakeThread == nullptr) {
+                // We can still poll for output the old way
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Failed to create decoder wake thread: %s",
+                            SDL_GetError());
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Falling back to legacy decoder polling");
+                m_LegacyDecoderPolling = true;
+            }
+        }
+
+        // Only create the decoder thread when instantiating the decoder for real. With the live decode
+        // unit source, it will use APIs from moonlight-common-c that can only be legally called with an
+        // established connection.
         m_DecoderThread = SDL_CreateThread(FFmpegVideoDecoder::decoderThreadProcThunk, "FFDecoder", (void*)this);
         if (m_DecoderThread == nullptr) {
             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -773,6 +914,18 @@ void FFmpegVideoDecoder::addVideoStats(VIDEO_STATS& src, VIDEO_STATS& dst)
     dst.totalDecodeTimeUs += src.totalDecodeTimeUs;
     dst.totalPacerTimeUs += src.totalPacerTimeUs;
     dst.totalRenderTimeUs += src.totalRenderTimeUs;
+    dst.framePoolHighWaterMark = qMax(dst.framePoolHighWaterMark, src.framePoolHighWaterMark);
+    dst.framePoolMisses += src.framePoolMisses;
+    dst.pacingDecisions += src.pacingDecisions;
+    dst.totalPacingQueueTarget += src.totalPacingQueueTarget;
+    dst.eglImageCacheHits += src.eglImageCacheHits;
+    dst.eglImageCacheMisses += src.eglImageCacheMisses;
+    dst.totalReadbackTimeUs += src.totalReadbackTimeUs;
+    dst.readbackFrames += src.readbackFrames;
+    dst.networkLatency.add(src.networkLatency);
+    dst.decodeLatency.add(src.decodeLatency);
+    dst.pacerLatency.add(src.pacerLatency);
+    dst.renderLatency.add(src.renderLatency);
 
     if (dst.minHostProcessingLatency == 0) {
         dst.minHostProcessingLatency = src.minHostProcessingLatency;
@@ -784,7 +937,7 @@ void FFmpegVideoDecoder::addVideoStats(VIDEO_STATS& src, VIDEO_STATS& dst)
     dst.totalHostProcessingLatency += src.totalHostProcessingLatency;
     dst.framesWithHostProcessingLatency += src.framesWithHostProcessingLatency;
 
-    if (!LiGetEstimatedRttInfo(&dst.lastRtt, &dst.lastRttVariance)) {
+    if (!m_DecodeUnitSource->getEstimatedRttInfo(&dst.lastRtt, &dst.lastRttVariance)) {
         dst.lastRtt = 0;
         dst.lastRttVariance = 0;
     }
@@ -935,6 +1088,61 @@ void FFmpegVideoDecoder::stringifyVideoStats(VIDEO_STATS& stats, char* output, i
         offset += ret;
     }
 
+    if (stats.receivedFrames != 0) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Frame pool usage: %u/%d peak, %u misses\n",
+                       stats.framePoolHighWaterMark,
+                       m_FramePool.getCapacity(),
+                       stats.framePoolMisses);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    if (m_Pacer != nullptr && m_Pacer->getPacingPolicyName() != nullptr && stats.pacingDecisions != 0) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Frame pacing policy: %s (average queue target: %.2f frames)\n",
+                       m_Pacer->getPacingPolicyName(),
+                       (double)stats.totalPacingQueueTarget / stats.pacingDecisions);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    if (stats.eglImageCacheHits + stats.eglImageCacheMisses != 0) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "EGLImage cache hit rate: %.1f%%\n",
+                       (float)stats.eglImageCacheHits / (stats.eglImageCacheHits + stats.eglImageCacheMisses) * 100);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    if (stats.readbackFrames != 0) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Average hwframe readback time: %.2f ms\n",
+                       (double)(stats.totalReadbackTimeUs / 1000.0) / stats.readbackFrames);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
     if (stats.framesWithHostProcessingLatency > 0) {
         ret = snprintf(&output[offset],
                        length - offset,
@@ -980,13 +1188,40 @@ void FFmpegVideoDecoder::stringifyVideoStats(VIDEO_STATS& stats, char* output, i
         }
 
         offset += ret;
+
+        const struct {
+            const char* name;
+            const LatencyHistogram& histogram;
+        } latencyHistograms[] = {
+            { "Frame reassembly", stats.networkLatency },
+            { "Decoding", stats.decodeLatency },
+            { "Frame queue", stats.pacerLatency },
+            { "Rendering", stats.renderLatency },
+        };
+
+        for (const auto& latencyHistogram : latencyHistograms) {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "%s p50/p95/p99/max: %.2f/%.2f/%.2f/%.2f ms\n",
+                           latencyHistogram.name,
+                           latencyHistogram.histogram.getPercentileUs(50) / 1000.0,
+                           latencyHistogram.histogram.getPercentileUs(95) / 1000.0,
+                           latencyHistogram.histogram.getPercentileUs(99) / 1000.0,
+                           latencyHistogram.histogram.getMaxUs() / 1000.0);
+            if (ret < 0 || ret >= length - offset) {
+                SDL_assert(false);
+                return;
+            }
+
+            offset += ret;
+        }
     }
 }
 
 void FFmpegVideoDecoder::logVideoStats(VIDEO_STATS& stats, const char* title)
 {
     if (stats.renderedFps > 0 || stats.renderedFrames != 0) {
-        char videoStatsStr[512];
+        char videoStatsStr[2048];
         stringifyVideoStats(stats, videoStatsStr, sizeof(videoStatsStr));
 
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
@@ -1618,11 +1853,92 @@ bool FFmpegVideoDecoder::tryInitializeNonHwAccelDecoder(PDECODER_PARAMETERS para
     return false;
 }
 
+bool FFmpegVideoDecoder::initializeHeadless(PDECODER_PARAMETERS params)
+{
+    const AVCodec* decoder;
+    void* codecIterator;
+
+    // Without a window, only FFmpeg's generic hwaccels can be used since
+    // our hwaccel renderers all need a display to render to.
+    if (params->vds != StreamingPreferences::VDS_FORCE_SOFTWARE) {
+        codecIterator = NULL;
+        while ((decoder = av_codec_iterate(&codecIterator))) {
+            // Skip codecs that aren't decoders
+            if (!av_codec_is_decoder(decoder)) {
+                continue;
+            }
+
+            // Skip decoders that don't match our decoding parameters
+            if (!isDecoderMatchForParams(decoder, params)) {
+                continue;
+            }
+
+            // Skip non-hwaccel hardware decoders
+            if (getAVCodecCapabilities(decoder) & AV_CODEC_CAP_HARDWARE) {
+                continue;
+            }
+
+            for (int i = 0;; i++) {
+                const AVCodecHWConfig *config = avcodec_get_hw_config(decoder, i);
+                if (!config) {
+                    // No remaining hwaccel options
+                    break;
+                }
+
+                if (!(config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)) {
+                    continue;
+                }
+
+                if (tryInitializeRenderer(decoder, AV_PIX_FMT_NONE, params, config, nullptr,
+                                          [config]() -> IFFmpegRenderer* { return new GenericHwAccelRenderer(config->device_type); })) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    // Fall back to software decoding
+    if (params->vds != StreamingPreferences::VDS_FORCE_HARDWARE) {
+        codecIterator = NULL;
+        while ((decoder = av_codec_iterate(&codecIterator))) {
+            // Skip codecs that aren't decoders
+            if (!av_codec_is_decoder(decoder)) {
+                continue;
+            }
+
+            // Skip decoders that don't match our decoding parameters
+            if (!isDecoderMatchForParams(decoder, params)) {
+                continue;
+            }
+
+            // Skip hardware decoders
+            if (getAVCodecCapabilities(decoder) & AV_CODEC_CAP_HARDWARE) {
+                continue;
+            }
+
+            if (tryInitializeRenderer(decoder, AV_PIX_FMT_NONE, params, nullptr, nullptr,
+                                      []() -> IFFmpegRenderer* { return new NullRenderer(); })) {
+                return true;
+            }
+        }
+    }
+
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Unable to find working headless decoder for format: %x",
+                 params->videoFormat);
+    return false;
+}
+
 bool FFmpegVideoDecoder::initialize(PDECODER_PARAMETERS params)
 {
     // Increase log level until the first frame is decoded
     av_log_set_level(AV_LOG_DEBUG);
 
+    // Headless decoding (for benchmarking) can't use any renderer that needs a window
+    if (params->window == nullptr) {
+        return initializeHeadless(params);
+    }
+
     // First try decoders that the user has manually specified via environment variables.
     // These must output surfaces in one of the formats that one of our renderers supports,
     // which is currently:
@@ -1752,9 +2068,20 @@ bool FFmpegVideoDecoder::initialize(PDECODER_PARAMETERS params)
     return false;
 }
 
-void FFmpegVideoDecoder::writeBuffer(PLENTRY entry, int& offset)
+void FFmpegVideoDecoder::writeBuffer(PLENTRY entry, uint8_t* buffer, int& offset)
 {
     if (m_NeedsSpsFixup && entry->bufferType == BUFFER_TYPE_SPS) {
+        // The host sends the same SPS for every IDR frame, so we can usually
+        // reuse the result of the last fixup instead of parsing it again.
+        size_t spsHash = qHashBits(entry->data, entry->length);
+        if (spsHash == m_CachedSpsHash &&
+                m_CachedSpsOriginal.size() == entry->length &&
+                memcmp(m_CachedSpsOriginal.constData(), entry->data, entry->length) == 0) {
+            memcpy(&buffer[offset], m_CachedSpsFixup.constData(), m_CachedSpsFixup.size());
+            offset += m_CachedSpsFixup.size();
+            return;
+        }
+
         h264_stream_t* stream = h264_new();
         int nalStart, nalEnd;
 
@@ -1790,18 +2117,23 @@ void FFmpegVideoDecoder::writeBuffer(PLENTRY entry, int& offset)
 
         // Copy the modified NALU data. This clobbers byte 0 and starts NALU data at byte 1.
         // Since it prepended one extra byte, subtract one from the returned length.
-        offset += write_nal_unit(stream, (uint8_t*)&m_DecodeBuffer.data()[initialOffset + nalStart - 1],
+        offset += write_nal_unit(stream, &buffer[initialOffset + nalStart - 1],
                                  MAX_SPS_EXTRA_SIZE + entry->length - nalStart) - 1;
 
         // Copy the NALU prefix over from the original SPS
-        memcpy(&m_DecodeBuffer.data()[initialOffset], entry->data, nalStart);
+        memcpy(&buffer[initialOffset], entry->data, nalStart);
         offset += nalStart;
 
         h264_free(stream);
+
+        // Remember the fixed up SPS for the next IDR frame
+        m_CachedSpsHash = spsHash;
+        m_CachedSpsOriginal = QByteArray(entry->data, entry->length);
+        m_CachedSpsFixup = QByteArray((const char*)&buffer[initialOffset], offset - initialOffset);
     }
     else {
         // Write the buffer as-is
-        memcpy(&m_DecodeBuffer.data()[offset],
+        memcpy(&buffer[offset],
                entry->data,
                entry->length);
         offset += entry->length;
@@ -1814,6 +2146,59 @@ int FFmpegVideoDecoder::decoderThreadProcThunk(void *context)
     return 0;
 }
 
+int FFmpegVideoDecoder::decoderWakeThreadProcThunk(void *context)
+{
+    ((FFmpegVideoDecoder*)context)->decoderWakeThreadProc();
+    return 0;
+}
+
+void FFmpegVideoDecoder::decoderWakeThreadProc()
+{
+    // We need to wake the decoder thread promptly when the deadline expires
+    if (SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH) < 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Unable to set decoder wake thread to high priority: %s",
+                    SDL_GetError());
+    }
+
+    std::unique_lock lock { m_DecoderWakeLock };
+    while (!m_DecoderWakeThreadShouldQuit) {
+        if (!m_DecoderWakeArmed) {
+            m_DecoderWakeCond.wait(lock);
+            continue;
+        }
+
+        // The deadline may be disarmed or moved while we're waiting, so we
+        // must check it again after waking up.
+        m_DecoderWakeCond.wait_until(lock, m_DecoderWakeDeadline);
+        if (m_DecoderWakeArmed && std::chrono::steady_clock::now() >= m_DecoderWakeDeadline) {
+            m_DecoderWakeArmed = false;
+
+            // This is called with the lock held to ensure we never deliver a wake
+            // after disarmDecoderWake() returns. A stale wake is still possible if
+            // a new frame arrives at the same time, but the decoder thread treats
+            // spurious wakes from waitForNextDecodeUnit() as a no-op.
+            m_DecodeUnitSource->wake();
+        }
+    }
+}
+
+void FFmpegVideoDecoder::armDecoderWake(int timeoutUs)
+{
+    {
+        std::lock_guard lg { m_DecoderWakeLock };
+        m_DecoderWakeDeadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+        m_DecoderWakeArmed = true;
+    }
+    m_DecoderWakeCond.notify_one();
+}
+
+void FFmpegVideoDecoder::disarmDecoderWake()
+{
+    std::lock_guard lg { m_DecoderWakeLock };
+    m_DecoderWakeArmed = false;
+}
+
 void FFmpegVideoDecoder::decoderThreadProc()
 {
     while (!SDL_AtomicGet(&m_DecoderThreadShouldQuit)) {
@@ -1823,12 +2208,12 @@ void FFmpegVideoDecoder::decoderThreadProc()
 
             // Waiting for input. All output frames have been received.
             // Block until we receive a new frame from the host.
-            if (!LiWaitForNextVideoFrame(&handle, &du)) {
+            if (!m_DecodeUnitSource->waitForNextDecodeUnit(&handle, &du)) {
                 // This might be a signal from the main thread to exit
                 continue;
             }
 
-            LiCompleteVideoFrame(handle, submitDecodeUnit(du));
+            submitVideoFrame(handle, du);
         }
 
         if (m_FramesIn != m_FramesOut) {
@@ -1836,7 +2221,8 @@ void FFmpegVideoDecoder::decoderThreadProc()
 
             // We have output frames to receive. Let's poll until we get one,
             // and submit new input data if/when we get it.
-            AVFrame* frame = av_frame_alloc();
+            bool poolMiss;
+            AVFrame* frame = m_FramePool.acquireFrame(&poolMiss);
             if (!frame) {
                 // Failed to allocate a frame but we did submit,
                 // so we can return DR_OK
@@ -1845,6 +2231,12 @@ void FFmpegVideoDecoder::decoderThreadProc()
                 continue;
             }
 
+            if (poolMiss) {
+                m_ActiveWndVideoStats.framePoolMisses++;
+            }
+            m_ActiveWndVideoStats.framePoolHighWaterMark = qMax(m_ActiveWndVideoStats.framePoolHighWaterMark,
+                                                                (uint32_t)m_FramePool.getOutstandingFrames());
+
             int err;
             do {
                 err = avcodec_receive_frame(m_VideoDecoderCtx, frame);
@@ -1856,7 +2248,7 @@ void FFmpegVideoDecoder::decoderThreadProc()
                     // any metadata contained in the bitstream itself since that is guaranteed to be
                     // correctly synchronized to each frame, unlike our async HDR metadata message.
                     SS_HDR_METADATA hdrMetadata;
-                    if (LiGetHdrMetadata(&hdrMetadata)) {
+                    if (m_DecodeUnitSource->getHdrMetadata(&hdrMetadata)) {
                         if (av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA) == nullptr) {
                             auto mdm = av_mastering_display_metadata_create_side_data(frame);
 
@@ -1928,14 +2320,27 @@ void FFmpegVideoDecoder::decoderThreadProc()
                         // Count time in avcodec_send_packet() and avcodec_receive_frame()
                         // as time spent decoding. Also count time spent in the decode unit
                         // queue because that's directly caused by decoder latency.
-                        m_ActiveWndVideoStats.totalDecodeTimeUs += (LiGetMicroseconds() - du.enqueueTimeUs);
+                        uint64_t decodeTimeUs = LiGetMicroseconds() - du.enqueueTimeUs;
+                        m_ActiveWndVideoStats.totalDecodeTimeUs += decodeTimeUs;
+                        m_ActiveWndVideoStats.decodeLatency.addSample(decodeTimeUs);
 
                         // Store the presentation time (90 kHz timebase)
                         frame->pts = (int64_t)du.rtpTimestamp;
+
+                        // Store the frame number for frame timing tracing
+                        frame->opaque = (void*)(uintptr_t)du.frameNumber;
+                        if (m_FrameTimingTrace != nullptr) {
+                            m_FrameTimingTrace->recordStage(du.frameNumber,
+                                                            FrameTimingTrace::StageDecodeOut,
+                                                            (uint64_t)frame->pkt_dts);
+                        }
                     }
 
                     m_ActiveWndVideoStats.decodedFrames++;
 
+                    // Let the renderer get started on the frame while it's queued
+                    m_FrontendRenderer->notifyFrameDecoded(frame);
+
                     // Queue the frame for rendering (or render now if pacer is disabled)
                     m_Pacer->submitFrame(frame);
                 }
@@ -1945,14 +2350,35 @@ void FFmpegVideoDecoder::decoderThreadProc()
 
                     // No output data, so let's try to submit more input data,
                     // while we're waiting for this to frame to come back.
-                    if (LiPollNextVideoFrame(&handle, &du)) {
+                    if (m_DecodeUnitSource->pollNextDecodeUnit(&handle, &du)) {
                         // FIXME: Handle EAGAIN on avcodec_send_packet() properly?
-                        LiCompleteVideoFrame(handle, submitDecodeUnit(du));
+                        submitVideoFrame(handle, du);
                     }
-                    else {
+                    else if (m_LegacyDecoderPolling) {
                         // No output data or input data. Let's wait a little bit.
                         SDL_Delay(2);
                     }
+                    else if (m_DecoderHasAsyncOutput) {
+                        // No output data or input data. Block until a new frame arrives
+                        // from the host or the poll interval expires, whichever is first.
+                        // FFmpeg has no way to notify us when output is ready, so the
+                        // wake thread bounds how long we'll go without polling it.
+                        armDecoderWake(m_DecoderPollIntervalUs);
+                        bool gotFrame = m_DecodeUnitSource->waitForNextDecodeUnit(&handle, &du);
+                        disarmDecoderWake();
+
+                        if (gotFrame) {
+                            submitVideoFrame(handle, du);
+                        }
+                    }
+                    else {
+                        // The decoder isn't working on anything in the background, so
+                        // only new input can produce output. Block until the host
+                        // submits another frame (or we're told to exit).
+                        if (m_DecodeUnitSource->waitForNextDecodeUnit(&handle, &du)) {
+                            submitVideoFrame(handle, du);
+                        }
+                    }
                 }
                 else {
                     char errorstring[512];
@@ -1979,18 +2405,29 @@ void FFmpegVideoDecoder::decoderThreadProc()
 
                     // Just in case the error resulted in the loss of the frame,
                     // request an IDR frame to reset our decoder state.
-                    LiRequestIdrFrame();
+                    m_DecodeUnitSource->requestIdrFrame();
                 }
             } while (err == AVERROR(EAGAIN) && !SDL_AtomicGet(&m_DecoderThreadShouldQuit));
 
             if (err != 0) {
-                // Free the frame if we failed to submit it
-                av_frame_free(&frame);
+                // Return the frame if we failed to submit it
+                m_FramePool.releaseFrame(&frame);
             }
         }
     }
 }
 
+void FFmpegVideoDecoder::submitVideoFrame(VIDEO_FRAME_HANDLE handle, PDECODE_UNIT du)
+{
+    // This must happen before submission, since the frame data
+    // is released as soon as the decode unit is completed.
+    if (m_DecodeUnitCapture != nullptr) {
+        m_DecodeUnitCapture->record(du);
+    }
+
+    m_DecodeUnitSource->completeDecodeUnit(handle, submitDecodeUnit(du));
+}
+
 int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
 {
     PLENTRY entry = du->bufferList;
@@ -2018,15 +2455,37 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
 
     // Flip stats windows roughly every second
     if (LiGetMicroseconds() > m_ActiveWndVideoStats.measurementStartUs + 1000000) {
+        // Collect any counters kept by the renderers for this window
+        m_BackendRenderer->addRendererStats(&m_ActiveWndVideoStats);
+        if (m_FrontendRenderer != m_BackendRenderer) {
+            m_FrontendRenderer->addRendererStats(&m_ActiveWndVideoStats);
+        }
+
+        // Share our receive to present latency with the audio stats
+        if (Session::get() != nullptr &&
+                m_ActiveWndVideoStats.receivedFrames != 0 &&
+                m_ActiveWndVideoStats.decodedFrames != 0 &&
+                m_ActiveWndVideoStats.renderedFrames != 0) {
+            Session::get()->setVideoPresentationLatency((uint32_t)(
+                        m_ActiveWndVideoStats.totalReassemblyTimeUs / m_ActiveWndVideoStats.receivedFrames +
+                        m_ActiveWndVideoStats.totalDecodeTimeUs / m_ActiveWndVideoStats.decodedFrames +
+                        (m_ActiveWndVideoStats.totalPacerTimeUs + m_ActiveWndVideoStats.totalRenderTimeUs) / m_ActiveWndVideoStats.renderedFrames));
+        }
+
         // Update overlay stats if it's enabled
-        if (Session::get()->getOverlayManager().isOverlayEnabled(Overlay::OverlayDebug)) {
+        if (Session::get() != nullptr && Session::get()->getOverlayManager().isOverlayEnabled(Overlay::OverlayDebug)) {
             VIDEO_STATS lastTwoWndStats = {};
             addVideoStats(m_LastWndVideoStats, lastTwoWndStats);
             addVideoStats(m_ActiveWndVideoStats, lastTwoWndStats);
 
-            stringifyVideoStats(lastTwoWndStats,
-                                Session::get()->getOverlayManager().getOverlayText(Overlay::OverlayDebug),
-                                Session::get()->getOverlayManager().getOverlayMaxTextLength());
+            char* overlayText = Session::get()->getOverlayManager().getOverlayText(Overlay::OverlayDebug);
+            int overlayMaxTextLength = Session::get()->getOverlayManager().getOverlayMaxTextLength();
+            stringifyVideoStats(lastTwoWndStats, overlayText, overlayMaxTextLength);
+
+            // Audio stats are collected on the audio thread
+            int overlayTextLength = (int)strlen(overlayText);
+            Session::get()->getAudioOverlayText(overlayText + overlayTextLength,
+                                                overlayMaxTextLength - overlayTextLength);
             Session::get()->getOverlayManager().setOverlayTextUpdated(Overlay::OverlayDebug);
         }
 
@@ -2054,22 +2513,52 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
     m_ActiveWndVideoStats.receivedFrames++;
     m_ActiveWndVideoStats.totalFrames++;
 
+    if (m_FrameTimingTrace != nullptr) {
+        m_FrameTimingTrace->beginFrame(du->frameNumber, du->receiveTimeUs, du->enqueueTimeUs);
+    }
+
     int requiredBufferSize = du->fullLength;
     if (du->frameType == FRAME_TYPE_IDR) {
         // Add some extra space in case we need to do an SPS fixup
         requiredBufferSize += MAX_SPS_EXTRA_SIZE;
     }
 
-    // Ensure the decoder buffer is large enough
-    m_DecodeBuffer.reserve(requiredBufferSize + AV_INPUT_BUFFER_PADDING_SIZE);
+    // Ensure the decoder buffer pool is large enough. Buffers still referenced
+    // by FFmpeg from the old pool remain valid until they are released.
+    if (m_DecodeBufferPool == nullptr || m_DecodeBufferPoolSize < requiredBufferSize + AV_INPUT_BUFFER_PADDING_SIZE) {
+        av_buffer_pool_uninit(&m_DecodeBufferPool);
+        m_DecodeBufferPoolSize = SDL_max(INITIAL_DECODE_BUFFER_SIZE, (requiredBufferSize + AV_INPUT_BUFFER_PADDING_SIZE) * 2);
+        m_DecodeBufferPool = av_buffer_pool_init(m_DecodeBufferPoolSize, nullptr);
+        if (m_DecodeBufferPool == nullptr) {
+            m_DecodeBufferPoolSize = 0;
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Failed to allocate decode buffer pool");
+            return DR_NEED_IDR;
+        }
+    }
+
+    // Decode units are always gathered into a padded pooled buffer. We can't
+    // hand the moonlight-common-c buffers to FFmpeg directly because they
+    // lack AV_INPUT_BUFFER_PADDING_SIZE and are freed when the decode unit is
+    // completed. Using a refcounted buffer at least avoids FFmpeg making a
+    // second copy of the packet data inside avcodec_send_packet().
+    m_Pkt->buf = av_buffer_pool_get(m_DecodeBufferPool);
+    if (m_Pkt->buf == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to allocate decode buffer");
+        return DR_NEED_IDR;
+    }
 
     int offset = 0;
     while (entry != nullptr) {
-        writeBuffer(entry, offset);
+        writeBuffer(entry, m_Pkt->buf->data, offset);
         entry = entry->next;
     }
 
-    m_Pkt->data = reinterpret_cast<uint8_t*>(m_DecodeBuffer.data());
+    // FFmpeg requires the padding to be zeroed
+    memset(&m_Pkt->buf->data[offset], 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    m_Pkt->data = m_Pkt->buf->data;
     m_Pkt->size = offset;
 
     if (du->frameType == FRAME_TYPE_IDR) {
@@ -2080,8 +2569,14 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
     }
 
     m_ActiveWndVideoStats.totalReassemblyTimeUs += (du->enqueueTimeUs - du->receiveTimeUs);
+    m_ActiveWndVideoStats.networkLatency.addSample(du->enqueueTimeUs - du->receiveTimeUs);
 
     err = avcodec_send_packet(m_VideoDecoderCtx, m_Pkt);
+
+    // Drop our reference to the packet data. FFmpeg holds its own reference
+    // if it still needs the data after avcodec_send_packet() returns.
+    av_packet_unref(m_Pkt);
+
     if (err < 0) {
         char errorstring[512];
         av_strerror(err, errorstring, sizeof(errorstring));
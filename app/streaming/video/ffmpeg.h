@@ -1,11 +1,17 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
 #include <QQueue>
 #include <set>
 
 #include "../bandwidth.h"
 #include "decoder.h"
+#include "decodeunitcapture.h"
+#include "decodeunitsource.h"
+#include "framepool.h"
 #include "ffmpeg-renderers/renderer.h"
 #include "ffmpeg-renderers/pacer/pacer.h"
 
@@ -31,6 +37,11 @@ public:
     virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO info) override;
 
     virtual IFFmpegRenderer* getBackendRenderer();
+    IFFmpegRenderer* getFrontendRenderer();
+
+    // Must be called before initialize(). The source must outlive the decoder.
+    // Decode units come from moonlight-common-c unless another source is set.
+    void setDecodeUnitSource(IDecodeUnitSource* source);
 
 private:
     enum class TestMode {
@@ -58,6 +69,8 @@ private:
 
     bool createFrontendRenderer(PDECODER_PARAMETERS params, bool useAlternateFrontend);
 
+    bool initializeHeadless(PDECODER_PARAMETERS params);
+
     static
     bool isDecoderMatchForParams(const AVCodec *decoder, PDECODER_PARAMETERS params);
 
@@ -90,11 +103,15 @@ private:
 
     bool initializeRendererInternal(IFFmpegRenderer* renderer, PDECODER_PARAMETERS params);
 
+    void destroyRenderer(IFFmpegRenderer*& renderer);
+
     static bool isSeparateTestDecoderRequired(const AVCodec* decoder);
 
     void reset();
 
-    void writeBuffer(PLENTRY entry, int& offset);
+    void writeBuffer(PLENTRY entry, uint8_t* buffer, int& offset);
+
+    void submitVideoFrame(VIDEO_FRAME_HANDLE handle, PDECODE_UNIT du);
 
     static
     enum AVPixelFormat ffGetFormat(AVCodecContext* context,
@@ -104,15 +121,27 @@ private:
 
     static int decoderThreadProcThunk(void* context);
 
+    void decoderWakeThreadProc();
+
+    static int decoderWakeThreadProcThunk(void* context);
+
+    void armDecoderWake(int timeoutUs);
+
+    void disarmDecoderWake();
+
     AVPacket* m_Pkt;
     AVCodecContext* m_VideoDecoderCtx;
     enum AVPixelFormat m_RequiredPixelFormat;
-    QByteArray m_DecodeBuffer;
+    AVBufferPool* m_DecodeBufferPool;
+    int m_DecodeBufferPoolSize;
     const AVCodecHWConfig* m_HwDecodeCfg;
     IFFmpegRenderer* m_BackendRenderer;
     IFFmpegRenderer* m_FrontendRenderer;
     int m_ConsecutiveFailedDecodes;
     Pacer* m_Pacer;
+    FramePool m_FramePool;
+    FrameTimingTrace* m_FrameTimingTrace;
+    DecodeUnitCapture* m_DecodeUnitCapture;
     BandwidthTracker m_BwTracker;
     VIDEO_STATS m_ActiveWndVideoStats;
     VIDEO_STATS m_LastWndVideoStats;
@@ -128,10 +157,28 @@ private:
     int m_OriginalVideoHeight;
     int m_VideoFormat;
     bool m_NeedsSpsFixup;
+    size_t m_CachedSpsHash;
+    QByteArray m_CachedSpsOriginal;
+    QByteArray m_CachedSpsFixup;
     bool m_TestOnly;
     TestMode m_CurrentTestMode;
     SDL_Thread* m_DecoderThread;
     SDL_atomic_t m_DecoderThreadShouldQuit;
+    LiveDecodeUnitSource m_LiveDecodeUnitSource;
+    IDecodeUnitSource* m_DecodeUnitSource;
+
+    // Wakes the decoder thread out of waitForNextDecodeUnit() when
+    // we're waiting on output from an asynchronous decoder and no
+    // new input arrives
+    bool m_LegacyDecoderPolling;
+    int m_DecoderPollIntervalUs;
+    bool m_DecoderHasAsyncOutput;
+    SDL_Thread* m_DecoderWakeThread;
+    std::mutex m_DecoderWakeLock;
+    std::condition_variable m_DecoderWakeCond;
+    std::chrono::steady_clock::time_point m_DecoderWakeDeadline;
+    bool m_DecoderWakeArmed;
+    bool m_DecoderWakeThreadShouldQuit;
 
     // Data buffers in the queued DU are not valid
     QQueue<DECODE_UNIT> m_FrameInfoQueue;
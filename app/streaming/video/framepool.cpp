@@ -0,0 +1,85 @@
+#include "framepool.h"
+
+#include <SDL.h>
+
+FramePool::FramePool(int capacity)
+    : m_Capacity(capacity),
+      m_OutstandingFrames(0)
+{
+    SDL_assert(capacity > 0);
+
+    m_Slots = new std::atomic<AVFrame*>[capacity];
+    for (int i = 0; i < capacity; i++) {
+        // If this fails, we'll just allocate on demand later
+        m_Slots[i].store(av_frame_alloc(), std::memory_order_relaxed);
+    }
+}
+
+FramePool::~FramePool()
+{
+    // All frames should have been returned by now
+    SDL_assert(m_OutstandingFrames == 0);
+
+    for (int i = 0; i < m_Capacity; i++) {
+        AVFrame* frame = m_Slots[i].exchange(nullptr);
+        av_frame_free(&frame);
+    }
+
+    delete[] m_Slots;
+}
+
+AVFrame* FramePool::acquireFrame(bool* miss)
+{
+    AVFrame* frame = nullptr;
+
+    for (int i = 0; i < m_Capacity && frame == nullptr; i++) {
+        frame = m_Slots[i].exchange(nullptr, std::memory_order_acquire);
+    }
+
+    if (miss != nullptr) {
+        *miss = (frame == nullptr);
+    }
+
+    if (frame == nullptr) {
+        // The pool is exhausted, so fall back to the heap
+        frame = av_frame_alloc();
+        if (frame == nullptr) {
+            return nullptr;
+        }
+    }
+
+    m_OutstandingFrames++;
+    return frame;
+}
+
+void FramePool::releaseFrame(AVFrame** frame)
+{
+    if (*frame == nullptr) {
+        return;
+    }
+
+    // Drop our references to the frame data before pooling it
+    av_frame_unref(*frame);
+    m_OutstandingFrames--;
+
+    for (int i = 0; i < m_Capacity; i++) {
+        AVFrame* expected = nullptr;
+        if (m_Slots[i].compare_exchange_strong(expected, *frame, std::memory_order_release, std::memory_order_relaxed)) {
+            *frame = nullptr;
+            return;
+        }
+    }
+
+    // The pool is full (this frame was allocated after a miss)
+    av_frame_free(frame);
+}
+
+int FramePool::getOutstandingFrames()
+{
+    return m_OutstandingFrames;
+}
+
+int FramePool::getCapacity()
+{
+    return m_Capacity;
+}
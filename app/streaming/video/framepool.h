@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// A fixed-capacity pool of AVFrame structs shared by the decoder, Pacer,
+// and renderers to avoid allocating and freeing an AVFrame for every
+// decoded frame. Frames returned to the pool are unreferenced, so they
+// don't hold onto any decoder surfaces while they're idle.
+//
+// acquireFrame() and releaseFrame() are lock-free and may be called
+// concurrently from any thread.
+class FramePool
+{
+public:
+    explicit FramePool(int capacity);
+
+    ~FramePool();
+
+    // Returns an empty frame from the pool. If the pool is exhausted, a new
+    // frame is allocated and counted as a miss.
+    AVFrame* acquireFrame(bool* miss = nullptr);
+
+    // Unreferences the frame and returns it to the pool. If the pool is
+    // already full, the frame is freed. Sets *frame to nullptr like
+    // av_frame_free() does.
+    void releaseFrame(AVFrame** frame);
+
+    // Number of frames currently acquired and not yet released
+    int getOutstandingFrames();
+
+    int getCapacity();
+
+private:
+    std::atomic<AVFrame*>* m_Slots;
+    int m_Capacity;
+    std::atomic<int> m_OutstandingFrames;
+};
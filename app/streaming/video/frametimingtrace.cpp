@@ -0,0 +1,212 @@
+#include "frametimingtrace.h"
+#include "path.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+#include <SDL.h>
+
+#include <algorithm>
+
+// Enough for over 30 seconds of history at 120 FPS
+#define TRACE_RING_SIZE 4096
+
+#define TRACE_FORMAT_VERSION 1
+
+// Frame number 0 is never used by moonlight-common-c,
+// so we use it to mark a slot as empty or being written.
+#define INVALID_FRAME_NUMBER 0
+
+static const char* k_StageSpanNames[FrameTimingTrace::StageMax - 1] = {
+    "Reassembly",
+    "Decode",
+    "Pacing",
+    "Render queue",
+    "Render",
+};
+
+FrameTimingTrace::FrameTimingTrace()
+{
+    m_Slots = new Slot[TRACE_RING_SIZE];
+    for (int i = 0; i < TRACE_RING_SIZE; i++) {
+        m_Slots[i].frameNumber.store(INVALID_FRAME_NUMBER, std::memory_order_relaxed);
+        for (int j = 0; j < StageMax; j++) {
+            m_Slots[i].timestampsUs[j].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+FrameTimingTrace::~FrameTimingTrace()
+{
+    delete[] m_Slots;
+}
+
+void FrameTimingTrace::beginFrame(uint32_t frameNumber, uint64_t receiveTimeUs, uint64_t enqueueTimeUs)
+{
+    Slot& slot = m_Slots[frameNumber % TRACE_RING_SIZE];
+
+    // Invalidate the slot while we overwrite it, so readers and
+    // writers for the evicted frame will ignore it.
+    slot.frameNumber.store(INVALID_FRAME_NUMBER, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestampsUs[StageReceive].store(receiveTimeUs, std::memory_order_relaxed);
+    slot.timestampsUs[StageEnqueue].store(enqueueTimeUs, std::memory_order_relaxed);
+    for (int i = StageDecodeOut; i < StageMax; i++) {
+        slot.timestampsUs[i].store(0, std::memory_order_relaxed);
+    }
+
+    slot.frameNumber.store(frameNumber, std::memory_order_release);
+}
+
+void FrameTimingTrace::recordStage(uint32_t frameNumber, Stage stage, uint64_t timeUs)
+{
+    Slot& slot = m_Slots[frameNumber % TRACE_RING_SIZE];
+
+    if (slot.frameNumber.load(std::memory_order_acquire) == frameNumber) {
+        slot.timestampsUs[stage].store(timeUs, std::memory_order_relaxed);
+    }
+}
+
+int FrameTimingTrace::snapshot(FrameTimingTraceRecord* records)
+{
+    int count = 0;
+
+    for (int i = 0; i < TRACE_RING_SIZE; i++) {
+        Slot& slot = m_Slots[i];
+        FrameTimingTraceRecord& record = records[count];
+
+        record.frameNumber = slot.frameNumber.load(std::memory_order_acquire);
+        if (record.frameNumber == INVALID_FRAME_NUMBER) {
+            continue;
+        }
+
+        record.reserved = 0;
+        for (int j = 0; j < StageMax; j++) {
+            record.timestampsUs[j] = slot.timestampsUs[j].load(std::memory_order_relaxed);
+        }
+
+        // Discard the record if it was replaced while we were copying it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.frameNumber.load(std::memory_order_relaxed) != record.frameNumber) {
+            continue;
+        }
+
+        count++;
+    }
+
+    std::sort(records, records + count,
+              [](const FrameTimingTraceRecord& a, const FrameTimingTraceRecord& b) {
+                  return a.frameNumber < b.frameNumber;
+              });
+
+    return count;
+}
+
+QString FrameTimingTrace::dump(DumpFormat format)
+{
+    FrameTimingTraceRecord* records = new FrameTimingTraceRecord[TRACE_RING_SIZE];
+    int count = snapshot(records);
+
+    QString fileName = writeRecords(records, count, format);
+    delete[] records;
+    return fileName;
+}
+
+bool FrameTimingTrace::dumpAsync(DumpFormat format)
+{
+    auto dump = new AsyncDump();
+    dump->records = new FrameTimingTraceRecord[TRACE_RING_SIZE];
+    dump->count = snapshot(dump->records);
+    dump->format = format;
+
+    SDL_Thread* thread = SDL_CreateThread(FrameTimingTrace::asyncDumpThread, "FrameTraceWriter", dump);
+    if (thread == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to create frame timing trace thread: %s",
+                     SDL_GetError());
+        delete[] dump->records;
+        delete dump;
+        return false;
+    }
+
+    // The thread owns the snapshot now
+    SDL_DetachThread(thread);
+    return true;
+}
+
+int FrameTimingTrace::asyncDumpThread(void* context)
+{
+    auto dump = (AsyncDump*)context;
+
+    writeRecords(dump->records, dump->count, dump->format);
+
+    delete[] dump->records;
+    delete dump;
+    return 0;
+}
+
+QString FrameTimingTrace::writeRecords(const FrameTimingTraceRecord* records, int count, DumpFormat format)
+{
+    QString fileName = QString("Moonlight-FrameTrace-%1.%2")
+            .arg(QDateTime::currentMSecsSinceEpoch())
+            .arg(format == DumpFormat::Binary ? "bin" : "json");
+    QFile file(QDir(Path::getLogDir()).filePath(fileName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to open frame timing trace file: %s",
+                     qPrintable(file.errorString()));
+        return QString();
+    }
+
+    if (format == DumpFormat::Binary) {
+        FrameTimingTraceHeader header = {};
+        memcpy(header.magic, "MLFT", sizeof(header.magic));
+        header.version = TRACE_FORMAT_VERSION;
+        header.recordCount = count;
+        header.stageCount = StageMax;
+
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)records, sizeof(*records) * count);
+    }
+    else {
+        QTextStream stream(&file);
+
+        // Each stage gets its own track, spanning from the previous stage's timestamp
+        stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (int i = 0; i < StageMax - 1; i++) {
+            stream << (first ? "" : ",")
+                   << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << i
+                   << ",\"args\":{\"name\":\"" << k_StageSpanNames[i] << "\"}}";
+            first = false;
+        }
+        for (int i = 0; i < count; i++) {
+            const FrameTimingTraceRecord& record = records[i];
+            for (int j = 0; j < StageMax - 1; j++) {
+                uint64_t start = record.timestampsUs[j];
+                uint64_t end = record.timestampsUs[j + 1];
+
+                // Skip stages the frame never reached (dropped frames)
+                if (start == 0 || end < start) {
+                    continue;
+                }
+
+                stream << ",{\"ph\":\"X\",\"pid\":1,\"tid\":" << j
+                       << ",\"name\":\"" << k_StageSpanNames[j] << "\""
+                       << ",\"ts\":" << start
+                       << ",\"dur\":" << (end - start)
+                       << ",\"args\":{\"frame\":" << record.frameNumber << "}}";
+            }
+        }
+        stream << "]}\n";
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Wrote %d frame timing records to %s",
+                count,
+                qPrintable(file.fileName()));
+    return file.fileName();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+
+// Records pipeline timestamps for each of the most recent video frames so
+// individual latency spikes can be examined after the fact, rather than
+// being averaged away in VIDEO_STATS.
+//
+// Frames are stored in a fixed-size ring indexed by frame number. Writers
+// on the decoder and render threads never block, and a dump may be taken
+// at any time while streaming is in progress.
+class FrameTimingTrace
+{
+public:
+    enum Stage {
+        StageReceive,       // First packet received (DECODE_UNIT::receiveTimeUs)
+        StageEnqueue,       // Frame reassembled (DECODE_UNIT::enqueueTimeUs)
+        StageDecodeOut,     // Frame returned from avcodec_receive_frame()
+        StagePacerDequeue,  // Frame released by Pacer to the render queue
+        StageRenderStart,   // Renderer began rendering the frame
+        StageRenderEnd,     // Renderer finished rendering the frame
+        StageMax
+    };
+
+    enum class DumpFormat {
+        // Little-endian file with a FrameTimingTraceHeader followed by
+        // FrameTimingTraceRecord entries in frame number order
+        Binary,
+
+        // Chrome trace event format (load in chrome://tracing or Perfetto)
+        ChromeTrace,
+    };
+
+    struct FrameTimingTraceHeader {
+        char magic[4];              // "MLFT"
+        uint32_t version;
+        uint32_t recordCount;
+        uint32_t stageCount;
+    };
+
+    struct FrameTimingTraceRecord {
+        uint32_t frameNumber;
+        uint32_t reserved;
+        uint64_t timestampsUs[StageMax];  // 0 if the frame never reached this stage
+    };
+
+    FrameTimingTrace();
+
+    ~FrameTimingTrace();
+
+    // Starts a new record for this frame, replacing the oldest one
+    void beginFrame(uint32_t frameNumber, uint64_t receiveTimeUs, uint64_t enqueueTimeUs);
+
+    // Records a timestamp for a frame previously passed to beginFrame().
+    // This is ignored if the frame has already been evicted from the ring.
+    void recordStage(uint32_t frameNumber, Stage stage, uint64_t timeUs);
+
+    // Writes the current contents of the ring to a new file in the log
+    // directory and returns its path, or an empty string on failure.
+    QString dump(DumpFormat format);
+
+    // Copies the current contents of the ring and writes them to a new file
+    // in the log directory on a worker thread, so the caller never waits on
+    // disk I/O. Returns false if the worker thread couldn't be started.
+    bool dumpAsync(DumpFormat format);
+
+private:
+    struct AsyncDump {
+        FrameTimingTraceRecord* records;
+        int count;
+        DumpFormat format;
+    };
+
+    static int asyncDumpThread(void* context);
+
+    static QString writeRecords(const FrameTimingTraceRecord* records, int count, DumpFormat format);
+
+    struct Slot {
+        std::atomic<uint32_t> frameNumber;
+        std::atomic<uint64_t> timestampsUs[StageMax];
+    };
+
+    int snapshot(FrameTimingTraceRecord* records);
+
+    Slot* m_Slots;
+};
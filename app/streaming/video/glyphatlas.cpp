@@ -0,0 +1,115 @@
+#include "glyphatlas.h"
+
+using namespace Overlay;
+
+GlyphAtlas::GlyphAtlas() :
+    m_Atlas(nullptr),
+    m_LineHeight(0)
+{
+    SDL_zero(m_GlyphRects);
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+    if (m_Atlas != nullptr) {
+        SDL_FreeSurface(m_Atlas);
+    }
+}
+
+bool GlyphAtlas::initialize(TTF_Font* font, SDL_Color color)
+{
+    const int glyphCount = k_LastGlyph - k_FirstGlyph + 1;
+    SDL_Surface* glyphs[glyphCount] = {};
+    int atlasWidth = 0;
+    int atlasHeight = 0;
+    bool ret = false;
+
+    SDL_assert(m_Atlas == nullptr);
+
+    // Render each glyph the same way TTF_RenderText_Blended() would
+    // render it within a string, so composed lines match the old output.
+    for (int i = 0; i < glyphCount; i++) {
+        char text[2] = { (char)(k_FirstGlyph + i), 0 };
+
+        glyphs[i] = TTF_RenderText_Blended(font, text, color);
+        if (glyphs[i] == nullptr) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "TTF_RenderText_Blended() failed: %s",
+                        TTF_GetError());
+            goto Exit;
+        }
+
+        m_GlyphRects[i].x = atlasWidth;
+        m_GlyphRects[i].y = 0;
+        m_GlyphRects[i].w = glyphs[i]->w;
+        m_GlyphRects[i].h = glyphs[i]->h;
+
+        atlasWidth += glyphs[i]->w;
+        atlasHeight = SDL_max(atlasHeight, glyphs[i]->h);
+    }
+
+    m_Atlas = SDL_CreateRGBSurfaceWithFormat(0, atlasWidth, atlasHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (m_Atlas == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "SDL_CreateRGBSurfaceWithFormat() failed: %s",
+                     SDL_GetError());
+        goto Exit;
+    }
+
+    for (int i = 0; i < glyphCount; i++) {
+        SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(glyphs[i], nullptr, m_Atlas, &m_GlyphRects[i]);
+    }
+
+    SDL_SetSurfaceBlendMode(m_Atlas, SDL_BLENDMODE_NONE);
+    m_LineHeight = TTF_FontLineSkip(font);
+    ret = true;
+
+Exit:
+    for (int i = 0; i < glyphCount; i++) {
+        if (glyphs[i] != nullptr) {
+            SDL_FreeSurface(glyphs[i]);
+        }
+    }
+
+    return ret;
+}
+
+bool GlyphAtlas::canRender(const char* text)
+{
+    for (const char* c = text; *c != 0; c++) {
+        if (*c != '\n' && (*c < k_FirstGlyph || *c > k_LastGlyph)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int GlyphAtlas::getLineHeight()
+{
+    return m_LineHeight;
+}
+
+int GlyphAtlas::measureLine(const char* line, int length)
+{
+    int width = 0;
+
+    for (int i = 0; i < length; i++) {
+        SDL_assert(line[i] >= k_FirstGlyph && line[i] <= k_LastGlyph);
+        width += m_GlyphRects[line[i] - k_FirstGlyph].w;
+    }
+
+    return width;
+}
+
+void GlyphAtlas::drawLine(SDL_Surface* dest, int x, int y, const char* line, int length)
+{
+    for (int i = 0; i < length; i++) {
+        SDL_Rect* src = &m_GlyphRects[line[i] - k_FirstGlyph];
+        SDL_Rect dst = { x, y, src->w, src->h };
+
+        SDL_BlitSurface(m_Atlas, src, dest, &dst);
+        x += src->w;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "SDL_compat.h"
+#include <SDL_ttf.h>
+
+namespace Overlay {
+
+// Pre-rendered printable ASCII glyphs for one font, size, and color.
+// Overlay text is composed by copying glyphs out of the atlas, which is
+// far cheaper than asking FreeType to rasterize the whole text block.
+class GlyphAtlas
+{
+public:
+    GlyphAtlas();
+    ~GlyphAtlas();
+
+    bool initialize(TTF_Font* font, SDL_Color color);
+
+    // Returns false if the text has characters outside the atlas
+    static bool canRender(const char* text);
+
+    int getLineHeight();
+
+    // Width in pixels of the first length characters of line
+    int measureLine(const char* line, int length);
+
+    // Copies glyphs for the first length characters of line into dest
+    // with the top-left corner at (x, y). Glyph cells replace what was
+    // there before rather than blending with it.
+    void drawLine(SDL_Surface* dest, int x, int y, const char* line, int length);
+
+private:
+    static const char k_FirstGlyph = ' ';
+    static const char k_LastGlyph = '~';
+
+    SDL_Surface* m_Atlas;
+    SDL_Rect m_GlyphRects[k_LastGlyph - k_FirstGlyph + 1];
+    int m_LineHeight;
+};
+
+}
@@ -0,0 +1,74 @@
+#include "latencyhistogram.h"
+
+#include <SDL.h>
+
+static_assert(LATENCY_HISTOGRAM_LINEAR_BUCKETS == 1 << 5,
+              "Linear range must cover all values below 2^5");
+
+static int getBucketIndex(uint32_t valueUs)
+{
+    if (valueUs < LATENCY_HISTOGRAM_LINEAR_BUCKETS) {
+        return (int)valueUs;
+    }
+
+    int msb = SDL_MostSignificantBitIndex32(valueUs);
+    int subBucket = (valueUs >> (msb - LATENCY_HISTOGRAM_SUB_BUCKET_BITS)) & ((1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS) - 1);
+
+    return LATENCY_HISTOGRAM_LINEAR_BUCKETS + ((msb - 5) << LATENCY_HISTOGRAM_SUB_BUCKET_BITS) + subBucket;
+}
+
+static uint32_t getBucketUpperBound(int index)
+{
+    if (index < LATENCY_HISTOGRAM_LINEAR_BUCKETS) {
+        return (uint32_t)index;
+    }
+
+    index -= LATENCY_HISTOGRAM_LINEAR_BUCKETS;
+
+    int msb = (index >> LATENCY_HISTOGRAM_SUB_BUCKET_BITS) + 5;
+    uint32_t subBucket = index & ((1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS) - 1);
+    uint32_t subBucketSize = 1U << (msb - LATENCY_HISTOGRAM_SUB_BUCKET_BITS);
+
+    return (1U << msb) + (subBucket + 1) * subBucketSize - 1;
+}
+
+void LatencyHistogram::addSample(uint64_t valueUs)
+{
+    uint32_t clampedValueUs = (uint32_t)SDL_min(valueUs, (uint64_t)((1U << LATENCY_HISTOGRAM_MAX_BITS) - 1));
+
+    m_Buckets[getBucketIndex(clampedValueUs)]++;
+    m_SampleCount++;
+    m_MaxUs = SDL_max(m_MaxUs, clampedValueUs);
+}
+
+void LatencyHistogram::add(const LatencyHistogram& other)
+{
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        m_Buckets[i] += other.m_Buckets[i];
+    }
+
+    m_SampleCount += other.m_SampleCount;
+    m_MaxUs = SDL_max(m_MaxUs, other.m_MaxUs);
+}
+
+uint32_t LatencyHistogram::getPercentileUs(double percentile) const
+{
+    if (m_SampleCount == 0) {
+        return 0;
+    }
+
+    // Find the bucket containing the sample at this rank
+    uint64_t targetRank = (uint64_t)SDL_ceil(percentile / 100.0 * m_SampleCount);
+    targetRank = SDL_max(targetRank, (uint64_t)1);
+
+    uint64_t rank = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        rank += m_Buckets[i];
+        if (rank >= targetRank) {
+            // Don't report a value higher than we've actually seen
+            return SDL_min(getBucketUpperBound(i), m_MaxUs);
+        }
+    }
+
+    return m_MaxUs;
+}
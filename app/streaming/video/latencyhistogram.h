@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+// Values below this are counted exactly (in microseconds)
+#define LATENCY_HISTOGRAM_LINEAR_BUCKETS 32
+
+// Each power of 2 above the linear range is split into 16 sub-buckets,
+// giving a worst-case error of about 6% for any reported percentile.
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS 4
+
+// Values are clamped to 2^25 - 1 microseconds (about 33 seconds)
+#define LATENCY_HISTOGRAM_MAX_BITS 25
+
+#define LATENCY_HISTOGRAM_BUCKETS (LATENCY_HISTOGRAM_LINEAR_BUCKETS + \
+    (LATENCY_HISTOGRAM_MAX_BITS - 5) * (1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS))
+
+// A log-linear latency histogram in the style of HdrHistogram. It is a plain
+// struct with no constructor so it can live inside VIDEO_STATS and be
+// cleared with SDL_zero() and copied with SDL_memcpy() along with it.
+//
+// Each histogram is expected to have a single writer thread, so recording
+// a sample requires no locking or atomic operations.
+class LatencyHistogram
+{
+public:
+    void addSample(uint64_t valueUs);
+
+    void add(const LatencyHistogram& other);
+
+    // Returns the value (in microseconds) at or below which
+    // the given percentile (0-100) of samples fall.
+    uint32_t getPercentileUs(double percentile) const;
+
+    uint32_t getMaxUs() const
+    {
+        return m_MaxUs;
+    }
+
+    uint32_t getSampleCount() const
+    {
+        return m_SampleCount;
+    }
+
+private:
+    uint32_t m_Buckets[LATENCY_HISTOGRAM_BUCKETS];
+    uint32_t m_SampleCount;
+    uint32_t m_MaxUs;
+};
@@ -0,0 +1,179 @@
+#include "offlinedecodeunitsource.h"
+
+#include <SDL.h>
+
+OfflineDecodeUnitSource::OfflineDecodeUnitSource()
+    : m_VideoFormat(0),
+      m_Width(0),
+      m_Height(0),
+      m_FrameRate(0),
+      m_Started(false),
+      m_Paced(false),
+      m_WakePending(false),
+      m_NextFrame(0),
+      m_IdrFrameRequests(0)
+{
+}
+
+void OfflineDecodeUnitSource::finishLoading()
+{
+    m_FrameIndexes.clear();
+    for (size_t i = 0; i < m_Frames.size(); i++) {
+        Frame& frame = m_Frames[i];
+
+        // The frames won't move anymore, so we can point into them now
+        for (size_t j = 0; j < frame.entries.size(); j++) {
+            frame.entries[j].next = j + 1 < frame.entries.size() ? &frame.entries[j + 1] : nullptr;
+        }
+        frame.du.bufferList = !frame.entries.empty() ? &frame.entries[0] : nullptr;
+
+        m_FrameIndexes[frame.du.frameNumber] = i;
+    }
+
+    m_SubmitTimesUs.assign(m_Frames.size(), 0);
+}
+
+int OfflineDecodeUnitSource::getVideoFormat() const
+{
+    return m_VideoFormat;
+}
+
+int OfflineDecodeUnitSource::getWidth() const
+{
+    return m_Width;
+}
+
+int OfflineDecodeUnitSource::getHeight() const
+{
+    return m_Height;
+}
+
+int OfflineDecodeUnitSource::getFrameRate() const
+{
+    return m_FrameRate;
+}
+
+int OfflineDecodeUnitSource::getFrameCount() const
+{
+    return (int)m_Frames.size();
+}
+
+void OfflineDecodeUnitSource::start(bool paced)
+{
+    {
+        std::lock_guard lg { m_Lock };
+        m_Paced = paced;
+        m_StartTime = std::chrono::steady_clock::now();
+        m_Started = true;
+    }
+    m_Cond.notify_all();
+}
+
+bool OfflineDecodeUnitSource::isFinished()
+{
+    std::lock_guard lg { m_Lock };
+    return m_NextFrame >= m_Frames.size();
+}
+
+uint64_t OfflineDecodeUnitSource::getSubmitTimeUs(int frameNumber)
+{
+    // This is only written before the frame is handed out, so no lock is needed
+    auto it = m_FrameIndexes.find(frameNumber);
+    return it != m_FrameIndexes.end() ? m_SubmitTimesUs[it->second] : 0;
+}
+
+uint32_t OfflineDecodeUnitSource::getIdrFrameRequests()
+{
+    return m_IdrFrameRequests;
+}
+
+bool OfflineDecodeUnitSource::isNextFrameReady(std::chrono::steady_clock::time_point* readyTime)
+{
+    if (!m_Started || m_NextFrame >= m_Frames.size()) {
+        *readyTime = std::chrono::steady_clock::time_point::max();
+        return false;
+    }
+    else if (!m_Paced) {
+        return true;
+    }
+
+    *readyTime = m_StartTime + std::chrono::microseconds(m_Frames[m_NextFrame].scheduledTimeUs);
+    return std::chrono::steady_clock::now() >= *readyTime;
+}
+
+void OfflineDecodeUnitSource::dequeueFrame(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du)
+{
+    Frame& frame = m_Frames[m_NextFrame];
+    uint64_t nowUs = LiGetMicroseconds();
+
+    frame.du.enqueueTimeUs = nowUs;
+    frame.du.receiveTimeUs = nowUs - SDL_min(frame.reassemblyTimeUs, nowUs);
+
+    m_SubmitTimesUs[m_NextFrame] = nowUs;
+    m_NextFrame++;
+
+    *handle = &frame;
+    *du = &frame.du;
+}
+
+bool OfflineDecodeUnitSource::waitForNextDecodeUnit(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du)
+{
+    std::unique_lock lock { m_Lock };
+
+    for (;;) {
+        if (m_WakePending) {
+            m_WakePending = false;
+            return false;
+        }
+
+        std::chrono::steady_clock::time_point readyTime;
+        if (isNextFrameReady(&readyTime)) {
+            break;
+        }
+        else if (readyTime == std::chrono::steady_clock::time_point::max()) {
+            // Not started or no more frames, so just wait to be woken
+            m_Cond.wait(lock);
+        }
+        else {
+            m_Cond.wait_until(lock, readyTime);
+        }
+    }
+
+    dequeueFrame(handle, du);
+    return true;
+}
+
+bool OfflineDecodeUnitSource::pollNextDecodeUnit(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du)
+{
+    std::lock_guard lg { m_Lock };
+
+    std::chrono::steady_clock::time_point readyTime;
+    if (!isNextFrameReady(&readyTime)) {
+        return false;
+    }
+
+    dequeueFrame(handle, du);
+    return true;
+}
+
+void OfflineDecodeUnitSource::completeDecodeUnit(VIDEO_FRAME_HANDLE, int drStatus)
+{
+    // We can't produce an IDR frame on demand, but we can count the requests
+    if (drStatus == DR_NEED_IDR) {
+        m_IdrFrameRequests++;
+    }
+}
+
+void OfflineDecodeUnitSource::wake()
+{
+    {
+        std::lock_guard lg { m_Lock };
+        m_WakePending = true;
+    }
+    m_Cond.notify_all();
+}
+
+void OfflineDecodeUnitSource::requestIdrFrame()
+{
+    m_IdrFrameRequests++;
+}
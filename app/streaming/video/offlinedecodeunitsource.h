@@ -0,0 +1,79 @@
+#pragma once
+
+#include "decodeunitsource.h"
+
+#include <QByteArray>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Base for decode unit sources that load all of their frames into memory
+// up front, so reading them doesn't take time away from the decoder. Frames
+// are handed out on a schedule, or as fast as the decoder will take them.
+class OfflineDecodeUnitSource : public IDecodeUnitSource
+{
+public:
+    OfflineDecodeUnitSource();
+
+    int getVideoFormat() const;
+    int getWidth() const;
+    int getHeight() const;
+    int getFrameRate() const;
+    int getFrameCount() const;
+
+    // Starts handing out decode units. If paced, each frame is held until
+    // its scheduled time. Otherwise they're sent as fast as possible.
+    void start(bool paced);
+
+    // Returns true once every frame has been handed to the decoder
+    bool isFinished();
+
+    // Returns the LiGetMicroseconds() time the frame was handed to the decoder
+    uint64_t getSubmitTimeUs(int frameNumber);
+
+    uint32_t getIdrFrameRequests();
+
+    virtual bool waitForNextDecodeUnit(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du) override;
+    virtual bool pollNextDecodeUnit(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du) override;
+    virtual void completeDecodeUnit(VIDEO_FRAME_HANDLE handle, int drStatus) override;
+    virtual void wake() override;
+    virtual void requestIdrFrame() override;
+
+protected:
+    struct Frame {
+        QByteArray data;
+        std::vector<LENTRY> entries; // Point into data
+        DECODE_UNIT du;              // Times are filled in when the frame is handed out
+        uint64_t reassemblyTimeUs;   // Reproduced as the time between receive and enqueue
+        uint64_t scheduledTimeUs;    // Relative to start() when paced
+    };
+
+    // Called by subclasses once m_Frames won't be resized anymore
+    void finishLoading();
+
+    int m_VideoFormat;
+    int m_Width;
+    int m_Height;
+    int m_FrameRate;
+    std::vector<Frame> m_Frames;
+
+private:
+    bool isNextFrameReady(std::chrono::steady_clock::time_point* readyTime);
+    void dequeueFrame(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du);
+
+    std::unordered_map<int, size_t> m_FrameIndexes;
+    std::vector<uint64_t> m_SubmitTimesUs;
+
+    std::mutex m_Lock;
+    std::condition_variable m_Cond;
+    bool m_Started;
+    bool m_Paced;
+    bool m_WakePending;
+    size_t m_NextFrame;
+    std::chrono::steady_clock::time_point m_StartTime;
+    std::atomic<uint32_t> m_IdrFrameRequests;
+};
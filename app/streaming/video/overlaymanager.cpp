@@ -3,11 +3,65 @@
 
 using namespace Overlay;
 
+// Same wrap width that we pass to TTF_RenderText_Blended_Wrapped()
+#define OVERLAY_WRAP_WIDTH 1024
+
+#define MAX_OVERLAY_LINES 128
+
+namespace {
+
+struct OverlayLine {
+    const char* text;
+    int length;
+    int width;
+};
+
+// Splits text into lines at line breaks or when a line would be wider
+// than OVERLAY_WRAP_WIDTH. Returns the number of lines.
+int splitOverlayLines(GlyphAtlas* atlas, const char* text, OverlayLine* lines)
+{
+    int lineCount = 0;
+    const char* c = text;
+
+    while (*c != 0 && lineCount < MAX_OVERLAY_LINES) {
+        OverlayLine* line = &lines[lineCount++];
+
+        line->text = c;
+        line->length = 0;
+        line->width = 0;
+
+        while (*c != 0 && *c != '\n') {
+            int glyphWidth = atlas->measureLine(c, 1);
+            if (line->length > 0 && line->width + glyphWidth > OVERLAY_WRAP_WIDTH) {
+                break;
+            }
+
+            line->width += glyphWidth;
+            line->length++;
+            c++;
+        }
+
+        if (*c == '\n') {
+            c++;
+        }
+    }
+
+    return lineCount;
+}
+
+}
+
 OverlayManager::OverlayManager() :
     m_Renderer(nullptr),
-    m_FontData(Path::readDataFile("ModeSeven.ttf"))
+    m_FontData(Path::readDataFile("ModeSeven.ttf")),
+    m_RasterizerThread(nullptr),
+    m_RasterizerSem(SDL_CreateSemaphore(0)),
+    m_PendingLock(0),
+    m_SurfaceLock(0),
+    m_RendererLock(SDL_CreateMutex())
 {
     memset(m_Overlays, 0, sizeof(m_Overlays));
+    SDL_AtomicSet(&m_RasterizerStopping, 0);
 
     m_Overlays[OverlayType::OverlayDebug].color = {0xD0, 0xD0, 0x00, 0xFF};
     m_Overlays[OverlayType::OverlayDebug].fontSize = 20;
@@ -33,10 +87,19 @@ OverlayManager::OverlayManager() :
 
 OverlayManager::~OverlayManager()
 {
+    stopRasterizerThread();
+
+    SDL_DestroySemaphore(m_RasterizerSem);
+    SDL_DestroyMutex(m_RendererLock);
+
     for (int i = 0; i < OverlayType::OverlayMax; i++) {
         if (m_Overlays[i].surface != nullptr) {
             SDL_FreeSurface(m_Overlays[i].surface);
         }
+        if (m_Overlays[i].canvas != nullptr) {
+            SDL_FreeSurface(m_Overlays[i].canvas);
+        }
+        delete m_Overlays[i].atlas;
         if (m_Overlays[i].font != nullptr) {
             TTF_CloseFont(m_Overlays[i].font);
         }
@@ -80,10 +143,22 @@ int OverlayManager::getOverlayFontSize(OverlayType type)
 }
 
 SDL_Surface* OverlayManager::getUpdatedOverlaySurface(OverlayType type)
+{
+    SDL_Rect dirtyRect;
+    return getUpdatedOverlaySurface(type, &dirtyRect);
+}
+
+SDL_Surface* OverlayManager::getUpdatedOverlaySurface(OverlayType type, SDL_Rect* dirtyRect)
 {
     // If a new surface is available, return it. If not, return nullptr.
     // Caller must free the surface on success.
-    return (SDL_Surface*)SDL_AtomicSetPtr((void**)&m_Overlays[type].surface, nullptr);
+    SDL_AtomicLock(&m_SurfaceLock);
+    SDL_Surface* surface = m_Overlays[type].surface;
+    *dirtyRect = m_Overlays[type].surfaceDirtyRect;
+    m_Overlays[type].surface = nullptr;
+    SDL_AtomicUnlock(&m_SurfaceLock);
+
+    return surface;
 }
 
 void OverlayManager::setOverlayTextUpdated(OverlayType type)
@@ -118,7 +193,46 @@ SDL_Color OverlayManager::getOverlayColor(OverlayType type)
 
 void OverlayManager::setOverlayRenderer(IOverlayRenderer* renderer)
 {
+    // The rasterizer thread calls into the renderer, so it must
+    // be stopped before the old renderer can be destroyed.
+    stopRasterizerThread();
+
+    SDL_LockMutex(m_RendererLock);
     m_Renderer = renderer;
+    SDL_UnlockMutex(m_RendererLock);
+
+    if (renderer != nullptr) {
+        startRasterizerThread();
+    }
+}
+
+void OverlayManager::startRasterizerThread()
+{
+    SDL_assert(m_RasterizerThread == nullptr);
+
+    // Rasterizing text with FreeType is slow enough to stall decoding or
+    // rendering, so overlay surfaces are produced on a thread of their own.
+    SDL_AtomicSet(&m_RasterizerStopping, 0);
+    m_RasterizerThread = SDL_CreateThread(OverlayManager::rasterizerThread, "OverlayRasterizer", this);
+    if (m_RasterizerThread == nullptr) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Unable to create overlay rasterizer thread: %s",
+                    SDL_GetError());
+        return;
+    }
+
+    // Pick up any updates that arrived while the thread was stopped
+    SDL_SemPost(m_RasterizerSem);
+}
+
+void OverlayManager::stopRasterizerThread()
+{
+    if (m_RasterizerThread != nullptr) {
+        SDL_AtomicSet(&m_RasterizerStopping, 1);
+        SDL_SemPost(m_RasterizerSem);
+        SDL_WaitThread(m_RasterizerThread, nullptr);
+        m_RasterizerThread = nullptr;
+    }
 }
 
 void OverlayManager::notifyOverlayUpdated(OverlayType type)
@@ -127,6 +241,46 @@ void OverlayManager::notifyOverlayUpdated(OverlayType type)
         return;
     }
 
+    // Hand a snapshot of the overlay to the rasterizer thread. The caller
+    // may start writing the next text as soon as we return.
+    SDL_AtomicLock(&m_PendingLock);
+    m_Overlays[type].pendingEnabled = m_Overlays[type].enabled;
+    memcpy(m_Overlays[type].pendingText, m_Overlays[type].text, sizeof(m_Overlays[type].text));
+    SDL_AtomicUnlock(&m_PendingLock);
+
+    // Without a rasterizer thread, compose the overlay on the caller's thread
+    if (m_RasterizerThread == nullptr) {
+        rasterizeOverlay(type);
+        return;
+    }
+
+    // Multiple updates before the rasterizer wakes up are coalesced
+    if (SDL_AtomicSet(&m_Overlays[type].pendingUpdate, 1) == 0) {
+        SDL_SemPost(m_RasterizerSem);
+    }
+}
+
+int OverlayManager::rasterizerThread(void* context)
+{
+    OverlayManager* me = reinterpret_cast<OverlayManager*>(context);
+
+    // Nobody waits on us, so stay out of the way of the
+    // decoding and rendering threads.
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    while (SDL_SemWait(me->m_RasterizerSem) == 0 && !SDL_AtomicGet(&me->m_RasterizerStopping)) {
+        for (int i = 0; i < OverlayType::OverlayMax; i++) {
+            if (SDL_AtomicSet(&me->m_Overlays[i].pendingUpdate, 0) != 0) {
+                me->rasterizeOverlay((OverlayType)i);
+            }
+        }
+    }
+
+    return 0;
+}
+
+void OverlayManager::rasterizeOverlay(OverlayType type)
+{
     // Construct the required font to render the overlay
     if (m_Overlays[type].font == nullptr) {
         if (m_FontData.isEmpty()) {
@@ -149,22 +303,153 @@ void OverlayManager::notifyOverlayUpdated(OverlayType type)
         }
     }
 
+    SDL_AtomicLock(&m_PendingLock);
+    bool enabled = m_Overlays[type].pendingEnabled;
+    memcpy(m_Overlays[type].rasterText, m_Overlays[type].pendingText, sizeof(m_Overlays[type].rasterText));
+    SDL_AtomicUnlock(&m_PendingLock);
+
+    SDL_Surface* newSurface = nullptr;
+    SDL_Rect dirtyRect = {};
+    if (enabled) {
+        newSurface = composeOverlaySurface(type, &dirtyRect);
+    }
+    else if (m_Overlays[type].canvas != nullptr) {
+        // The renderer may never see the last surface we composed,
+        // so start from scratch when the overlay is enabled again.
+        SDL_FreeSurface(m_Overlays[type].canvas);
+        m_Overlays[type].canvas = nullptr;
+        m_Overlays[type].canvasText[0] = 0;
+    }
+
     // Exchange the old surface with the new one
-    SDL_Surface* oldSurface = (SDL_Surface*)SDL_AtomicSetPtr(
-        (void**)&m_Overlays[type].surface,
-        m_Overlays[type].enabled ?
-            // The _Wrapped variant is required for line breaks to work
-            TTF_RenderText_Blended_Wrapped(m_Overlays[type].font,
-                                           m_Overlays[type].text,
-                                           m_Overlays[type].color,
-                                           1024)
-            : nullptr);
-
-    // Notify the renderer
-    m_Renderer->notifyOverlayUpdated(type);
+    SDL_AtomicLock(&m_SurfaceLock);
+    SDL_Surface* oldSurface = m_Overlays[type].surface;
+    if (oldSurface != nullptr && newSurface != nullptr) {
+        // The renderer never picked up the old surface, so its changes are still pending
+        SDL_Rect surfaceRect = { 0, 0, newSurface->w, newSurface->h };
+        SDL_UnionRect(&dirtyRect, &m_Overlays[type].surfaceDirtyRect, &dirtyRect);
+        SDL_IntersectRect(&dirtyRect, &surfaceRect, &dirtyRect);
+    }
+    m_Overlays[type].surface = newSurface;
+    m_Overlays[type].surfaceDirtyRect = dirtyRect;
+    SDL_AtomicUnlock(&m_SurfaceLock);
+
+    // Notify the renderer. This happens outside the lock, since the renderer
+    // may block on its own threads. It can't be destroyed underneath us,
+    // because setOverlayRenderer() joins this thread before replacing it.
+    SDL_LockMutex(m_RendererLock);
+    IOverlayRenderer* renderer = m_Renderer;
+    SDL_UnlockMutex(m_RendererLock);
+    if (renderer != nullptr) {
+        renderer->notifyOverlayUpdated(type);
+    }
 
     // Free the old surface
     if (oldSurface != nullptr) {
         SDL_FreeSurface(oldSurface);
     }
 }
+
+SDL_Surface* OverlayManager::composeOverlaySurface(OverlayType type, SDL_Rect* dirtyRect)
+{
+    const char* text = m_Overlays[type].rasterText;
+    SDL_Surface* surface;
+
+    if (m_Overlays[type].atlas == nullptr && !m_Overlays[type].atlasFailed) {
+        m_Overlays[type].atlas = new GlyphAtlas();
+        if (!m_Overlays[type].atlas->initialize(m_Overlays[type].font, m_Overlays[type].color)) {
+            delete m_Overlays[type].atlas;
+            m_Overlays[type].atlas = nullptr;
+            m_Overlays[type].atlasFailed = true;
+        }
+    }
+
+    // Fall back to FreeType for anything the atlas doesn't cover
+    if (m_Overlays[type].atlas == nullptr || !GlyphAtlas::canRender(text)) {
+        // Our canvas no longer matches the last text we rendered
+        m_Overlays[type].canvasText[0] = 0;
+        if (m_Overlays[type].canvas != nullptr) {
+            SDL_FreeSurface(m_Overlays[type].canvas);
+            m_Overlays[type].canvas = nullptr;
+        }
+
+        // The _Wrapped variant is required for line breaks to work
+        surface = TTF_RenderText_Blended_Wrapped(m_Overlays[type].font,
+                                                 text,
+                                                 m_Overlays[type].color,
+                                                 OVERLAY_WRAP_WIDTH);
+        if (surface != nullptr) {
+            *dirtyRect = { 0, 0, surface->w, surface->h };
+        }
+        return surface;
+    }
+
+    GlyphAtlas* atlas = m_Overlays[type].atlas;
+    int lineHeight = atlas->getLineHeight();
+
+    OverlayLine lines[MAX_OVERLAY_LINES];
+    int lineCount = splitOverlayLines(atlas, text, lines);
+
+    OverlayLine oldLines[MAX_OVERLAY_LINES];
+    int oldLineCount = splitOverlayLines(atlas, m_Overlays[type].canvasText, oldLines);
+
+    int width = 1;
+    for (int i = 0; i < lineCount; i++) {
+        width = SDL_max(width, lines[i].width);
+    }
+    int height = SDL_max(lineCount, 1) * lineHeight;
+
+    // Keep drawing into the same canvas unless the text no longer fits.
+    // The canvas only grows in width, so numbers changing width from
+    // one update to the next don't force a full redraw.
+    bool redrawAll = false;
+    SDL_Surface* canvas = m_Overlays[type].canvas;
+    if (canvas == nullptr || canvas->h != height || canvas->w < width) {
+        if (canvas != nullptr) {
+            width = SDL_max(width, canvas->w);
+            SDL_FreeSurface(canvas);
+        }
+
+        canvas = m_Overlays[type].canvas =
+                SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (canvas == nullptr) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "SDL_CreateRGBSurfaceWithFormat() failed: %s",
+                         SDL_GetError());
+            m_Overlays[type].canvasText[0] = 0;
+            return nullptr;
+        }
+
+        SDL_FillRect(canvas, nullptr, 0);
+        redrawAll = true;
+    }
+
+    // Only draw the lines that changed since the last update
+    *dirtyRect = {};
+    if (redrawAll) {
+        *dirtyRect = { 0, 0, canvas->w, canvas->h };
+    }
+    for (int i = 0; i < lineCount; i++) {
+        if (!redrawAll && i < oldLineCount &&
+                lines[i].length == oldLines[i].length &&
+                memcmp(lines[i].text, oldLines[i].text, lines[i].length) == 0) {
+            continue;
+        }
+
+        SDL_Rect lineRect = { 0, i * lineHeight, canvas->w, lineHeight };
+        SDL_FillRect(canvas, &lineRect, 0);
+        atlas->drawLine(canvas, 0, i * lineHeight, lines[i].text, lines[i].length);
+        SDL_UnionRect(dirtyRect, &lineRect, dirtyRect);
+    }
+
+    memcpy(m_Overlays[type].canvasText, text, sizeof(m_Overlays[type].canvasText));
+
+    // The renderer takes ownership of the surface we return, so hand
+    // it a copy and keep the canvas for the next update.
+    surface = SDL_DuplicateSurface(canvas);
+    if (surface == nullptr) {
+        // The next update must redraw everything the renderer missed
+        m_Overlays[type].canvasText[0] = 0;
+    }
+    return surface;
+}
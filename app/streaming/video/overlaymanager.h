@@ -5,6 +5,8 @@
 #include "SDL_compat.h"
 #include <SDL_ttf.h>
 
+#include "glyphatlas.h"
+
 namespace Overlay {
 
 enum OverlayType {
@@ -38,22 +40,63 @@ public:
     int getOverlayFontSize(OverlayType type);
     SDL_Surface* getUpdatedOverlaySurface(OverlayType type);
 
+    // Also returns the part of the surface that changed since the last surface
+    // returned for this overlay. It's only meaningful if the renderer still has
+    // that last surface uploaded and it's the same size as the new one.
+    SDL_Surface* getUpdatedOverlaySurface(OverlayType type, SDL_Rect* dirtyRect);
+
     void setOverlayRenderer(IOverlayRenderer* renderer);
 
 private:
     void notifyOverlayUpdated(OverlayType type);
 
+    void startRasterizerThread();
+
+    void stopRasterizerThread();
+
+    static int rasterizerThread(void* context);
+
+    void rasterizeOverlay(OverlayType type);
+
+    SDL_Surface* composeOverlaySurface(OverlayType type, SDL_Rect* dirtyRect);
+
     struct {
         bool enabled;
         int fontSize;
         SDL_Color color;
-        char text[1024];
+        char text[2048];
+
+        // Snapshot of the overlay state for the rasterizer thread,
+        // protected by m_PendingLock
+        bool pendingEnabled;
+        char pendingText[2048];
+        SDL_atomic_t pendingUpdate;
 
+        // Only touched by the rasterizer thread (or by notifyOverlayUpdated()
+        // if the rasterizer thread couldn't be started)
         TTF_Font* font;
+        char rasterText[2048];
+        GlyphAtlas* atlas;
+        bool atlasFailed;
+        SDL_Surface* canvas;
+        char canvasText[2048];
+
+        // Protected by m_SurfaceLock
         SDL_Surface* surface;
+        SDL_Rect surfaceDirtyRect;
     } m_Overlays[OverlayMax];
     IOverlayRenderer* m_Renderer;
     QByteArray m_FontData;
+
+    SDL_Thread* m_RasterizerThread;
+    SDL_sem* m_RasterizerSem;
+    SDL_atomic_t m_RasterizerStopping;
+    SDL_SpinLock m_PendingLock;
+    SDL_SpinLock m_SurfaceLock;
+
+    // Protects m_Renderer. The rasterizer thread is only running
+    // while a renderer is set, so it can call the renderer unlocked.
+    SDL_mutex* m_RendererLock;
 };
 
 }